@@ -0,0 +1,59 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/**
+ * @struct ArenaBlock
+ * @brief A pooled buffer the arena hands out memory from.
+ */
+typedef struct ArenaBlock {
+	struct ArenaBlock* next;	// Block filled before this one (NULL-able)
+	size_t capacity;					// Size of the whole block, header included
+	size_t used;							// Bytes handed out so far, header included
+} ArenaBlock;
+
+/**
+ * @struct Arena
+ * @brief A bump allocator for memory that lives as long as a request.
+ *
+ * Allocations only move a pointer forward in the current block; a new block
+ * is taken from the buffer pool once it is full. Nothing is freed on its own:
+ * ResetArena() returns every block at once when the request is done.
+ */
+typedef struct {
+	ArenaBlock* head;	 // Block allocations are served from (NULL-able)
+} Arena;
+
+/**
+ * @brief Allocates memory from an arena.
+ *
+ * @param arena The arena to allocate from.
+ * @param size The number of bytes needed.
+ * @return Memory aligned for any type, valid until the arena is reset, or
+ * NULL on error.
+ */
+void* ArenaAllocate(Arena* arena, size_t size);
+
+/**
+ * @brief Copies a string into an arena, like strndup().
+ *
+ * @param arena The arena to allocate from.
+ * @param data The bytes to copy. They do not need to be NUL-terminated.
+ * @param length The number of bytes to copy.
+ * @return The NUL-terminated copy, or NULL on error.
+ */
+char* ArenaStrndup(Arena* arena, const char* data, size_t length);
+
+/**
+ * @brief Releases everything allocated from an arena in one step.
+ *
+ * The blocks go back to the buffer pool, so an idle arena holds no memory.
+ *
+ * @param arena The arena to reset.
+ */
+void ResetArena(Arena* arena);
+
+#endif	// ARENA_H
+
+// include/arena.h
@@ -0,0 +1,56 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+
+/**
+ * @brief Allocates a buffer from the size-class pool.
+ *
+ * Sizes are rounded up to a power of two, from BUFFER_SIZE up to
+ * MAX_REQUEST_SIZE. Every thread keeps a small cache of free buffers per
+ * class, refilled in batches from a shared depot, so most allocations take
+ * neither a lock nor a trip through malloc(). Larger sizes are passed on to
+ * malloc().
+ *
+ * @param size The number of bytes needed.
+ * @param capacity Receives the usable size of the buffer, at least size.
+ * @return The buffer, or NULL on error.
+ */
+void* AllocatePooledBuffer(size_t size, size_t* capacity);
+
+/**
+ * @brief Grows a pooled buffer, keeping its first bytes.
+ *
+ * @param buffer The buffer to grow (NULL-able).
+ * @param length The number of leading bytes to keep.
+ * @param capacity The capacity of buffer, updated to the new one on success.
+ * @param size The number of bytes needed.
+ * @return The grown buffer, or NULL on error, in which case buffer is left
+ * untouched.
+ */
+void* ResizePooledBuffer(void* buffer,
+												 size_t length,
+												 size_t* capacity,
+												 size_t size);
+
+/**
+ * @brief Returns a buffer to the pool.
+ *
+ * Buffers may be freed by any thread, not only the one that allocated them.
+ *
+ * @param buffer The buffer to free (NULL-able).
+ * @param capacity The capacity reported when the buffer was allocated.
+ */
+void FreePooledBuffer(void* buffer, size_t capacity);
+
+/**
+ * @brief Frees the buffers cached by the calling thread and by the depot.
+ *
+ * Caches of other threads are handed to the depot when those threads exit,
+ * so this must only be called once all of them have been joined.
+ */
+void CleanupBufferPool();
+
+#endif	// BUFFER_POOL_H
+
+// include/buffer_pool.h
@@ -36,6 +36,79 @@ extern const size_t MAX_PENDING_CONNECTIONS;
  */
 extern const size_t BUFFER_SIZE;
 
+/**
+ * @brief The maximum size of a single request, including headers and body.
+ *
+ * Connection buffers start at BUFFER_SIZE and grow up to this size. Larger
+ * requests are answered with 413 Payload Too Large.
+ *
+ * @note Must be initialized in the implementation file before use.
+ */
+extern const size_t MAX_REQUEST_SIZE;
+
+/**
+ * @brief The maximum number of client connections held open at the same time.
+ *
+ * This constant bounds the number of connections tracked by the reactor. New
+ * connections beyond this limit are closed immediately after being accepted.
+ *
+ * @note Must be initialized in the implementation file before use.
+ */
+extern const size_t MAX_CONNECTIONS;
+
+/**
+ * @brief Seconds an idle persistent connection is kept open.
+ *
+ * A connection that has not sent any data for this long is closed by its
+ * event loop.
+ *
+ * @note Must be initialized in the implementation file before use.
+ */
+extern const size_t KEEP_ALIVE_TIMEOUT;
+
+/**
+ * @brief The maximum number of requests served on one persistent connection.
+ *
+ * The response to the last allowed request carries "Connection: close".
+ *
+ * @note Must be initialized in the implementation file before use.
+ */
+extern const size_t MAX_KEEP_ALIVE_REQUESTS;
+
+/**
+ * @brief The maximum number of pipelined requests answered in one batch.
+ *
+ * Responses of a batch are flushed with a single write. Requests beyond this
+ * limit stay buffered and are handled in the next batch.
+ *
+ * @note Must be initialized in the implementation file before use.
+ */
+extern const size_t MAX_PIPELINED_REQUESTS;
+
+/**
+ * @brief The maximum number of events returned by a single epoll_wait() call.
+ *
+ * @note Must be initialized in the implementation file before use.
+ */
+extern const size_t MAX_EVENTS;
+
+/**
+ * @brief Average queue wait, in microseconds, beyond which Workers are added.
+ *
+ * An elastic thread pool starts another Worker, up to its maximum, whenever
+ * connections waited longer than this for a Worker during the last check.
+ *
+ * @note Must be initialized in the implementation file before use.
+ */
+extern const size_t MAX_QUEUE_WAIT;
+
+/**
+ * @brief Milliseconds between two load checks of an elastic thread pool.
+ *
+ * @note Must be initialized in the implementation file before use.
+ */
+extern const size_t THREAD_POOL_CHECK_INTERVAL;
+
 /**
  * @brief Flag indicating whether the server should continue running.
  *
@@ -71,6 +144,38 @@ extern const size_t HTTP_BAD_REQUEST;
  */
 extern const size_t HTTP_NOT_FOUND;
 
+/**
+ * @brief HTTP status code indicating that the request is too large.
+ *
+ * This constant is used when a request exceeds MAX_REQUEST_SIZE. The
+ * connection is closed after the response has been sent.
+ */
+extern const size_t HTTP_PAYLOAD_TOO_LARGE;
+
+/**
+ * @brief HTTP status code indicating an error on the side of the server.
+ *
+ * This constant is used when a valid request cannot be handled because the
+ * server ran out of resources, such as memory for the request.
+ */
+extern const size_t HTTP_INTERNAL_ERROR;
+
+/**
+ * @brief HTTP status code indicating a feature the server does not implement.
+ *
+ * This constant is used when the body of a request has a transfer coding other
+ * than chunked. The connection is closed after the response has been sent.
+ */
+extern const size_t HTTP_NOT_IMPLEMENTED;
+
+/**
+ * @brief HTTP status code indicating an HTTP version the server does not speak.
+ *
+ * This constant is used when a request names a version other than HTTP/1.x.
+ * The connection is closed after the response has been sent.
+ */
+extern const size_t HTTP_VERSION_NOT_SUPPORTED;
+
 /**
  * @brief HTTP status code indicating a successful request.
  *
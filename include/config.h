@@ -0,0 +1,57 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "database.h"
+
+/**
+ * @enum IOBackend
+ * @brief The event loop used to accept clients and move bytes on their sockets.
+ */
+typedef enum {
+	IO_BACKEND_EPOLL,			// Edge-triggered epoll reactor (default)
+	IO_BACKEND_IO_URING,	// io_uring ring, falls back to epoll if unavailable
+} IOBackend;
+
+/**
+ * @struct ServerConfig
+ * @brief Runtime options of the server, set from the command line.
+ *
+ * Every field has a default that reproduces the behaviour of a server started
+ * without any arguments.
+ */
+typedef struct {
+	int num_acceptors;	// Number of SO_REUSEPORT listeners, each with a reactor
+	IOBackend backend;	// Event loop driving each listener
+	int num_threads;		// Minimum number of Workers, split across the listeners
+	int max_threads;		// Maximum number of Workers, split across the listeners
+	int cooldown;				// Idle seconds before a Worker above the minimum retires
+	int num_db_threads;	// Threads running database operations, 0 for the Workers
+	int pin_threads;		// Non-zero to pin Workers and event loops to CPUs
+
+	int write_batch_size;				// Most writes the database stage commits at once
+	int write_window;						// Microseconds it waits for more writes to commit
+	DatabaseSettings database;	// Tuning of every database connection
+} ServerConfig;
+
+/**
+ * @brief The options the server was started with.
+ *
+ * Filled in by ParseServerConfig() before any subsystem is initialized and
+ * treated as read-only afterwards.
+ */
+extern ServerConfig server_config;
+
+/**
+ * @brief Parses the command line into server_config.
+ *
+ * Unknown options and invalid values print a usage message and terminate the
+ * process.
+ *
+ * @param argc The argument count passed to main().
+ * @param argv The argument vector passed to main().
+ */
+void ParseServerConfig(int argc, char* argv[]);
+
+#endif	// CONFIG_H
+
+// include/config.h
@@ -0,0 +1,260 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+
+#include "arena.h"
+#include "database.h"
+
+struct Reactor;
+struct Ring;
+struct ThreadPool;
+
+/**
+ * @enum RequestState
+ * @brief Progress of the incremental reader on the current request.
+ *
+ * The reader resumes from the state it stopped in whenever more bytes arrive,
+ * so no part of a request is scanned twice.
+ */
+typedef enum {
+	REQUEST_HEADERS,			// Waiting for the end of the header block
+	REQUEST_BODY,					// Waiting for Content-Length bytes of body
+	REQUEST_CHUNK_SIZE,		// Waiting for a chunk-size line
+	REQUEST_CHUNK_DATA,		// Waiting for chunk data and its trailing CRLF
+	REQUEST_TRAILERS,			// Waiting for the end of the trailer section
+	REQUEST_COMPLETE,			// A whole request is buffered
+	REQUEST_INVALID,			// The request is malformed
+	REQUEST_TOO_LARGE,		// The request exceeds MAX_REQUEST_SIZE
+	REQUEST_UNSUPPORTED,	// The body has a transfer coding other than chunked
+} RequestState;
+
+/**
+ * @struct OutputSegment
+ * @brief A contiguous piece of the response bytes queued on a connection.
+ *
+ * Status lines and headers are generated into the output buffer of the
+ * connection, while bodies are referenced where the handlers produced them.
+ * Segments are sent in order with a single vectored write.
+ */
+typedef struct {
+	const char* data;	 // Bytes to send, NULL for the next bytes of output
+	size_t length;		 // Number of bytes in the segment
+	int is_owned;			 // Non-zero if data is heap memory freed after sending
+} OutputSegment;
+
+/**
+ * @struct Connection
+ * @brief Represents a single client connection owned by the server.
+ *
+ * This structure holds the client socket together with the bytes received on
+ * it so far and the state of the incremental reader. A connection is owned
+ * either by its event loop (while waiting for a complete request), by exactly
+ * one Worker thread (while the request is being handled) or by the database
+ * executor (while the database operation of the request runs), never by two
+ * of them at once. Persistent connections cycle through them for every
+ * request they carry.
+ */
+typedef struct Connection {
+	int fd;										 // Client socket file descriptor
+	char* buffer;							 // Receive buffer, NULL while idle (NUL-terminated)
+	size_t length;						 // Number of bytes currently stored in buffer
+	size_t capacity;					 // Allocated size of buffer, grows on demand
+	size_t offset;						 // Start of the first unhandled request in buffer
+	RequestState state;				 // Reader state of the request at offset
+	size_t scan;							 // Position in buffer where the reader resumes
+	size_t header_length;			 // Length of the header block, including CRLFCRLF
+	size_t body_length;				 // Length of the (decoded) body
+	size_t chunk_remaining;		 // Bytes left in the current chunk
+	size_t request_length;		 // Raw bytes taken by the complete request
+	int expects_continue;			 // Non-zero if "100 Continue" is still owed
+	char* output;							 // Generated status lines and headers (NULL-able)
+	size_t output_length;			 // Number of bytes in output
+	size_t output_capacity;		 // Allocated size of output
+	OutputSegment* segments;	 // Response bytes queued for sending (NULL-able)
+	size_t num_segments;			 // Number of queued segments
+	size_t segments_capacity;	 // Allocated number of segments
+	size_t pending_length;		 // Number of bytes in all segments not sent yet
+	size_t sent_length;				 // Bytes at the front of the segments already sent
+	struct iovec* iov;				 // Vector built from segments for sending
+	size_t iov_capacity;			 // Allocated number of entries in iov
+	Arena arena;							 // Memory of the batch, freed once it is sent
+	struct msghdr message;		 // Message of an in-flight io_uring SENDMSG
+	struct Reactor* reactor;	 // epoll reactor owning the socket (NULL-able)
+	struct Ring* ring;				 // io_uring backend owning the socket (NULL-able)
+	int keep_alive;						 // Non-zero to keep the socket open afterwards
+	int is_processing;				 // Non-zero while a Worker owns the connection
+	size_t num_requests;			 // Number of requests served on this connection
+	time_t last_active;				 // Monotonic time of the last activity, in seconds
+
+	struct ThreadPool* pool;			// Workers serving the connection (NULL-able)
+	int worker;										// Worker that served it last, or -1
+	DatabaseOperation operation;	// Database work of the request at offset
+	uint64_t queued_at;						// Monotonic time it was last queued, in ns
+	int accepts_chunked;					// Non-zero if the request at offset is HTTP/1.1
+
+	int is_idle;									 // Non-zero while on its reactor's idle list
+	struct Connection* idle_prev;	 // Connection idle for longer (NULL-able)
+	struct Connection* idle_next;	 // Connection idle for less long (NULL-able)
+} Connection;
+
+/**
+ * @brief Creates a connection for an accepted client socket.
+ *
+ * The receive buffer is only allocated once data arrives.
+ *
+ * @param fd The client socket file descriptor.
+ * @return A dynamically allocated Connection. Must be freed with
+ * FreeConnection(). NULL on error.
+ */
+Connection* CreateConnection(int fd);
+
+/**
+ * @brief Reads all currently available bytes from a non-blocking socket.
+ *
+ * This function keeps calling read() until the socket reports EAGAIN, the
+ * receive buffer has reached MAX_REQUEST_SIZE, or the peer closes the
+ * connection. The received bytes are appended to the connection buffer, which
+ * grows as needed.
+ *
+ * @param connection Pointer to the connection to read from.
+ * @return 1 if the connection is still open, 0 if the peer closed it, -1 on
+ * error.
+ */
+int ReadConnection(Connection* connection);
+
+/**
+ * @brief Appends received bytes to the connection buffer.
+ *
+ * The buffer grows as needed. Bytes that would take it beyond
+ * MAX_REQUEST_SIZE are discarded.
+ *
+ * @param connection Pointer to the connection to append to.
+ * @param data The received bytes.
+ * @param length The number of received bytes.
+ * @return 0 on success, -1 if the buffer could not be allocated.
+ */
+int AppendConnection(Connection* connection, const char* data, size_t length);
+
+/**
+ * @brief Advances the incremental reader over newly received bytes.
+ *
+ * The reader first waits for the end of the header block, then for exactly
+ * Content-Length bytes of body, or decodes a chunked body in place. Once a
+ * request is complete, its headers and decoded body are stored contiguously
+ * at offset, header_length + body_length bytes long. If the client asked for
+ * it, "100 Continue" is sent as soon as the headers are in and no response is
+ * pending.
+ *
+ * @param connection Pointer to the connection to inspect.
+ * @return 1 if the request at offset is complete, invalid or too large, and
+ * thus ready to be answered by a Worker; 0 if more bytes are needed.
+ */
+int IsRequestComplete(Connection* connection);
+
+/**
+ * @brief Drops the request at offset after it has been answered.
+ *
+ * The reader is reset to start on the next pipelined request.
+ *
+ * @param connection Pointer to the connection whose request was answered.
+ */
+void ConsumeRequest(Connection* connection);
+
+/**
+ * @brief Reserves space for generated response bytes.
+ *
+ * Responses to pipelined requests are collected in order, so that a whole
+ * batch is sent with a single vectored write.
+ *
+ * @param connection Pointer to the connection to append to.
+ * @param length The number of bytes the caller is about to write.
+ * @return Pointer to length + 1 writable bytes at the end of the output, or
+ * NULL on error. The bytes are queued by CommitOutput().
+ */
+char* ReserveOutput(Connection* connection, size_t length);
+
+/**
+ * @brief Queues bytes written into space returned by ReserveOutput().
+ *
+ * @param connection Pointer to the connection to append to.
+ * @param length The number of bytes that have been written.
+ * @return 0 on success, -1 on error.
+ */
+int CommitOutput(Connection* connection, size_t length);
+
+/**
+ * @brief Queues bytes that live outside the connection without copying them.
+ *
+ * @param connection Pointer to the connection to append to.
+ * @param data The bytes to send. They must stay valid until the connection is
+ * reset or freed.
+ * @param length The number of bytes to send.
+ * @param is_owned Non-zero to hand heap memory over to the connection, which
+ * frees it once it has been sent, or on error.
+ * @return 0 on success, -1 on error.
+ */
+int AppendOutput(Connection* connection,
+								 const char* data,
+								 size_t length,
+								 int is_owned);
+
+/**
+ * @brief Builds the vector of the queued response bytes not sent yet.
+ *
+ * @param connection Pointer to the connection to send from.
+ * @return The number of entries stored in connection->iov, 0 if nothing is
+ * left to send, or -1 on error.
+ */
+int BuildOutputVector(Connection* connection);
+
+/**
+ * @brief Records that the first bytes of the queued output have been sent.
+ *
+ * The segments stay queued, so that a socket that would block can carry on
+ * from where the last write stopped.
+ *
+ * @param connection Pointer to the connection that has been written to.
+ * @param length The number of bytes written, at most pending_length.
+ */
+void ConsumeOutput(Connection* connection, size_t length);
+
+/**
+ * @brief Drops the queued response bytes once they have been sent.
+ *
+ * Owned segments are freed, while the arena keeps everything else, so that a
+ * response can be sent in parts while it is still being built.
+ *
+ * @param connection Pointer to the connection whose output has been sent.
+ */
+void DiscardOutput(Connection* connection);
+
+/**
+ * @brief Prepares a persistent connection for its next batch of requests.
+ *
+ * This function drops the requests before offset together with the responses
+ * that have been sent for them, releasing their owned segments. Bytes of
+ * following requests are moved to the start of the buffer; if there are none,
+ * the receive buffer is freed so that idle connections hold no buffer memory.
+ *
+ * @param connection Pointer to the connection to reset.
+ */
+void ResetConnection(Connection* connection);
+
+/**
+ * @brief Frees the memory associated with a connection.
+ *
+ * This includes the receive buffer and any pending response. The client socket
+ * itself is not closed by this function.
+ *
+ * @param connection Pointer to the connection to be freed.
+ */
+void FreeConnection(Connection* connection);
+
+#endif	// CONNECTION_H
+
+// include/connection.h
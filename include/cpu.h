@@ -0,0 +1,54 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <pthread.h>
+
+/**
+ * @brief Returns the number of CPUs the process can actually use.
+ *
+ * This is the number of CPUs in the affinity mask of the process, further
+ * limited by the CPU quota of its cgroup (cpu.max on cgroup v2,
+ * cpu.cfs_quota_us on cgroup v1), so that containers are sized by what they
+ * are allowed to run rather than by the size of the host.
+ *
+ * @return The number of usable CPUs, at least 1.
+ */
+int GetUsableCPUCount();
+
+/**
+ * @brief Lists the CPUs in the affinity mask of the process.
+ *
+ * The CPUs are ordered by NUMA node, so that consecutive entries share a node
+ * wherever possible.
+ *
+ * @param cpus Array receiving the CPU numbers.
+ * @param max_cpus The number of entries cpus can hold.
+ * @return The number of CPUs stored, or -1 on error.
+ */
+int GetUsableCPUs(int* cpus, int max_cpus);
+
+/**
+ * @brief Restricts threads created with a thread attribute to a set of CPUs.
+ *
+ * Pages are placed on the NUMA node of the CPU that first touches them, so
+ * buffers allocated by a pinned thread stay local to it.
+ *
+ * @param attr The thread attribute to modify.
+ * @param cpus The CPUs the threads may run on.
+ * @param num_cpus The number of entries in cpus.
+ * @return 0 on success, -1 on error.
+ */
+int SetThreadAffinity(pthread_attr_t* attr, const int* cpus, int num_cpus);
+
+/**
+ * @brief Restricts the calling thread to a set of CPUs.
+ *
+ * @param cpus The CPUs the thread may run on.
+ * @param num_cpus The number of entries in cpus.
+ * @return 0 on success, -1 on error.
+ */
+int PinCurrentThread(const int* cpus, int num_cpus);
+
+#endif	// CPU_H
+
+// include/cpu.h
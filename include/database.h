@@ -1,6 +1,10 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
+#include <stddef.h>
+
+#include "arena.h"
+
 /**
  * @struct Record
  * @brief Represents a single key-value record in the database.
@@ -12,24 +16,79 @@ typedef struct {
 	char* value;	// Value associated with the key
 } Record;
 
+/**
+ * @enum DatabaseOperationType
+ * @brief The kind of work a DatabaseOperation asks for.
+ */
+typedef enum {
+	DATABASE_NONE,		// No operation is pending
+	DATABASE_GET,			// Look up the value of key
+	DATABASE_POST,		// Store value under key
+	DATABASE_DELETE,	// Delete key
+	DATABASE_BATCH,		// Run the operations in batch in one transaction
+} DatabaseOperationType;
+
+/**
+ * @struct DatabaseOperation
+ * @brief A typed request for the database stage, together with its result.
+ *
+ * Network threads fill in the operation while parsing a request, and the
+ * database executor runs it without having to look at the request again.
+ */
+typedef struct DatabaseOperation {
+	DatabaseOperationType type;				// What to do, DATABASE_NONE if idle
+	char* key;												// Key to operate on (owned)
+	char* value;											// Value to store, or found by a GET (owned)
+	int result;												// 1 if the operation succeeded, 0 otherwise
+	Arena* arena;											// Arena of key and value, NULL for malloc()
+	struct DatabaseOperation* batch;	// Operations of a DATABASE_BATCH (owned)
+	size_t batch_length;							// Number of entries in batch
+} DatabaseOperation;
+
+/**
+ * @struct DatabaseSettings
+ * @brief Tuning applied to every connection to the database file.
+ */
+typedef struct {
+	long long mmap_size;			 // Bytes of the file mapped into memory, 0 for none
+	int cache_size;						 // KiB of page cache per connection
+	int synchronous;					 // PRAGMA synchronous, from 0 (OFF) to 3 (EXTRA)
+	int checkpoint_pages;			 // WAL pages that trigger a checkpoint, 0 for never
+	size_t record_cache_size;	 // Bytes of records cached in memory, 0 for none
+} DatabaseSettings;
+
 /**
  * @brief Initializes the database system.
  *
  * This function sets up the internal database (e.g., in-memory hash table, flat
- * file, etc.). Should be called once at server startup.
+ * file, etc.). Should be called once at server startup, before any thread
+ * runs a database operation.
+ *
+ * The file is switched to write-ahead logging, so readers never wait for a
+ * writer. Every thread that runs an operation gets a connection of its own,
+ * opened on first use with settings and closed when the thread exits. The
+ * statements of DatabaseGet(), DatabasePost() and DatabaseDelete() are
+ * prepared once per connection, and only reset and rebound on every use.
+ *
+ * Values found by DatabaseGet() are kept in the record cache, which
+ * DatabasePost() and DatabaseDelete() update once their write has committed.
+ *
+ * @param settings The tuning of every connection. It is copied.
  */
-void InitDatabase();
+void InitDatabase(const DatabaseSettings* settings);
 
 /**
  * @brief Retrieves the value for a given key.
  *
  * If the key exists in the database, this returns a dynamically allocated
- * string containing the value. The caller must free the returned string.
+ * string containing the value. The caller must free the returned string,
+ * unless it was allocated from an arena.
  *
  * @param key The key to look up.
- * @return A malloc'd copy of the value, or NULL if not found.
+ * @param arena The arena to copy the value into, or NULL to use malloc().
+ * @return A copy of the value, or NULL if not found.
  */
-char* DatabaseGet(const char* key);
+char* DatabaseGet(const char* key, Arena* arena);
 
 /**
  * @brief Stores or updates a key-value pair in database.
@@ -50,10 +109,58 @@ int DatabasePost(const char* key, const char* value);
  */
 int DatabaseDelete(const char* key);
 
+/**
+ * @brief Runs a typed database operation and stores its result in it.
+ *
+ * For DATABASE_GET, the value found is stored in operation->value, or NULL if
+ * the key does not exist. A DATABASE_BATCH runs its operations in order, in a
+ * single transaction, and stores the result of each in it. Its reads bypass
+ * the record cache, so that they see one snapshot of the database, which
+ * includes the writes of the batch before them.
+ *
+ * @param operation The operation to run.
+ */
+void ExecuteDatabaseOperation(DatabaseOperation* operation);
+
+/**
+ * @brief Runs several operations in a single transaction.
+ *
+ * The writes of all operations are committed together, so they share the
+ * cost of one commit. Each operation gets the result it would have had on
+ * its own, except that every write fails if the commit does. The record
+ * cache only sees the writes once they have committed. Whether a commit has
+ * reached the disk depends on DatabaseSettings::synchronous: with FULL or
+ * EXTRA it has, with NORMAL a power failure may still undo it.
+ *
+ * @param operations The operations to run, in order.
+ * @param count The number of entries in operations.
+ */
+void ExecuteDatabaseBatch(DatabaseOperation* const* operations, size_t count);
+
+/**
+ * @brief Frees the strings of an operation and marks it as idle.
+ *
+ * Strings allocated from an arena are left to it.
+ *
+ * @param operation The operation to clear.
+ */
+void ClearDatabaseOperation(DatabaseOperation* operation);
+
+/**
+ * @brief Prints how many connections were opened, how often their statements
+ * were prepared and reused, and how well the record cache did.
+ *
+ * Counts the connections of threads that have exited, and the one of the
+ * calling thread, so it should be called once the other threads have stopped.
+ */
+void PrintDatabaseStats();
+
 /**
  * @brief Cleans up the database system.
  *
- * Frees any dynamically allocated memory and resets internal structures.
+ * Frees any dynamically allocated memory and resets internal structures. The
+ * connection of the calling thread is closed, which checkpoints the
+ * write-ahead log into the database file if it is the last one.
  */
 void CleanupDatabase();
 
@@ -0,0 +1,84 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "connection.h"
+
+/**
+ * @struct ExecutorThread
+ * @brief A thread of the database stage together with its counters.
+ *
+ * Only the thread itself writes its counters, so recording them costs no
+ * shared cache line.
+ */
+typedef struct {
+	pthread_t thread;				 // Thread running the operations
+	uint64_t num_executed;	 // Operations run so far
+	uint64_t wait_time;			 // Total time they waited in the queue, in ns
+	uint64_t busy_time;			 // Total time spent running them, in ns
+	size_t max_queue_depth;	 // Deepest queue seen when taking an operation
+} ExecutorThread;
+
+/**
+ * @brief Starts the database stage.
+ *
+ * Workers of the network stage parse requests into typed database operations
+ * and queue them here, so that a slow disk commit only ever stalls database
+ * threads. Once an operation has run, its connection is handed back to the
+ * Workers, which write the response.
+ *
+ * POST and DELETE operations go to a single writer thread instead, which
+ * commits the writes queued at the same time in one transaction, so they
+ * share the cost of a commit. A batch ends when it holds write_batch_size
+ * writes, or once no more are queued and write_window has passed since its
+ * first write was taken. Connections are only handed back once the batch has
+ * committed.
+ *
+ * @param num_threads The number of database threads, 0 to run operations on
+ * the Workers instead, where every write commits on its own.
+ * @param write_batch_size The most writes committed together.
+ * @param write_window Microseconds the writer waits for more writes, 0 to
+ * commit as soon as the queue is empty.
+ */
+void InitExecutor(int num_threads, int write_batch_size, int write_window);
+
+/**
+ * @brief Queues the pending database operation of a connection.
+ *
+ * Reads are queued to the database threads and writes to the writer.
+ *
+ * The caller gives up the connection; it is handed back to the Workers of
+ * connection->pool through SubmitConnection() once the operation has run.
+ *
+ * @param connection The connection whose operation is to be run.
+ * @return 0 on success, -1 if the operation must be run by the caller.
+ */
+int SubmitDatabaseOperation(Connection* connection);
+
+/**
+ * @brief Prints the queue depth and latency of the database stage, and how
+ * many writes its commits grouped.
+ */
+void PrintExecutorStats();
+
+/**
+ * @brief Stops the database threads.
+ *
+ * is_server_running must have been cleared before. Operations still queued
+ * are dropped together with their connections when those are closed.
+ */
+void StopExecutor();
+
+/**
+ * @brief Frees the queue of the database stage.
+ *
+ * Must only be called once no Worker can queue operations anymore.
+ */
+void CleanupExecutor();
+
+#endif	// EXECUTOR_H
+
+// include/executor.h
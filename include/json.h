@@ -0,0 +1,196 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+
+#include "parser.h"
+
+// Deepest nesting of objects and arrays the tokenizer accepts.
+#define MAX_JSON_DEPTH 32
+
+/**
+ * @enum JSONTokenType
+ * @brief Kinds of tokens NextJSONToken() returns.
+ */
+typedef enum {
+	JSON_OBJECT_START,	// '{'
+	JSON_OBJECT_END,		// '}'
+	JSON_ARRAY_START,		// '['
+	JSON_ARRAY_END,			// ']'
+	JSON_KEY,						// A member name, together with its colon
+	JSON_STRING,				// A string value
+	JSON_NUMBER,				// A number value
+	JSON_TRUE,					// true
+	JSON_FALSE,					// false
+	JSON_NULL,					// null
+	JSON_END,						// The document is complete
+	JSON_ERROR,					// The document is malformed
+} JSONTokenType;
+
+/**
+ * @struct JSONToken
+ * @brief A token of a JSON document, as a view into it.
+ */
+typedef struct {
+	JSONTokenType type;	 // Kind of the token
+	StringView text;		 // Raw bytes, between the quotes for keys and strings
+	int has_escapes;		 // Non-zero if text contains backslash escapes
+	size_t depth;				 // Containers the token is nested in, its own excluded
+} JSONToken;
+
+/**
+ * @enum JSONExpectation
+ * @brief What the grammar allows next, as tracked by the tokenizer.
+ */
+typedef enum {
+	JSON_EXPECT_VALUE,				 // A value, e.g. after a colon
+	JSON_EXPECT_VALUE_OR_END,	 // A value or ']', right after '['
+	JSON_EXPECT_KEY,					 // A key, after a comma in an object
+	JSON_EXPECT_KEY_OR_END,		 // A key or '}', right after '{'
+	JSON_EXPECT_COMMA_OR_END,	 // ',' or the end of the current container
+	JSON_EXPECT_DOCUMENT_END,	 // Nothing but whitespace
+	JSON_EXPECT_NOTHING,			 // JSON_END has been returned
+	JSON_EXPECT_FAILED,				 // JSON_ERROR has been returned
+} JSONExpectation;
+
+/**
+ * @struct JSONTokenizer
+ * @brief A streaming tokenizer over a JSON document.
+ *
+ * Tokens are returned one at a time, in document order, without building a
+ * tree or copying anything. The grammar is checked as the tokens go by, so a
+ * caller that stops at the first JSON_ERROR never sees an invalid document.
+ */
+typedef struct {
+	const char* data;													// The document
+	size_t length;														// Number of bytes in data
+	size_t position;													// Offset of the next unread byte
+	size_t depth;															// Number of open containers
+	unsigned char in_object[MAX_JSON_DEPTH];	// Non-zero for objects, per depth
+	JSONExpectation expect;										// What may come next
+} JSONTokenizer;
+
+/**
+ * @struct JSONWriter
+ * @brief Serializes JSON with escaping, either measuring or writing.
+ *
+ * A writer without output only counts the bytes it would write. Running the
+ * same calls twice, first to measure and then into a buffer of exactly that
+ * size, builds a document with a single allocation. The output keeps the
+ * pretty-printed layout the server has always sent: one member per line,
+ * indented with tabs, with CRLF line endings.
+ */
+typedef struct {
+	char* output;		// Where to write, NULL to only measure
+	size_t length;	// Number of bytes written, or measured, so far
+	size_t depth;		// Number of open containers
+	int is_first;		// Non-zero until the current container has an entry
+	int after_key;	// Non-zero if a key is waiting for its value
+} JSONWriter;
+
+/**
+ * @brief Starts tokenizing a JSON document.
+ *
+ * @param tokenizer The tokenizer to initialize.
+ * @param data The document. It does not need to be NUL-terminated and must
+ * outlive the tokenizer, as tokens point into it.
+ * @param length The number of bytes in data.
+ */
+void InitJSONTokenizer(JSONTokenizer* tokenizer,
+											 const char* data,
+											 size_t length);
+
+/**
+ * @brief Reads the next token of a JSON document.
+ *
+ * The plain bytes of strings are skipped with FindJSONSpecial(), a vector at
+ * a time.
+ *
+ * @param tokenizer The tokenizer to read from.
+ * @param token Receives the token.
+ * @return The type of the token. JSON_END and JSON_ERROR are returned for
+ * every call once reached.
+ */
+JSONTokenType NextJSONToken(JSONTokenizer* tokenizer, JSONToken* token);
+
+/**
+ * @brief Decodes the escapes of a key or string token.
+ *
+ * \\uXXXX escapes, including surrogate pairs, are decoded to UTF-8. The
+ * decoded text is never longer than the raw one.
+ *
+ * @param text The raw text of the token.
+ * @param output Receives the decoded bytes, at least text.length bytes long.
+ * It is not NUL-terminated.
+ * @param length Receives the number of decoded bytes.
+ * @return 0 on success, -1 on a malformed escape or a lone surrogate.
+ */
+int UnescapeJSONString(StringView text, char* output, size_t* length);
+
+/**
+ * @brief Compares a key or string token to a plain string.
+ *
+ * @param token The token to compare.
+ * @param text The NUL-terminated string to compare against.
+ * @return 1 if the decoded token equals text, 0 otherwise.
+ */
+int JSONStringEquals(const JSONToken* token, const char* text);
+
+/**
+ * @brief Starts writing a JSON document.
+ *
+ * @param writer The writer to initialize.
+ * @param output Where to write the document, or NULL to only measure it.
+ */
+void InitJSONWriter(JSONWriter* writer, char* output);
+
+/**
+ * @brief Opens an object, as a value.
+ *
+ * @param writer The writer to write to.
+ */
+void BeginJSONObject(JSONWriter* writer);
+
+/**
+ * @brief Closes the innermost object.
+ *
+ * @param writer The writer to write to.
+ */
+void EndJSONObject(JSONWriter* writer);
+
+/**
+ * @brief Opens an array, as a value.
+ *
+ * @param writer The writer to write to.
+ */
+void BeginJSONArray(JSONWriter* writer);
+
+/**
+ * @brief Closes the innermost array.
+ *
+ * @param writer The writer to write to.
+ */
+void EndJSONArray(JSONWriter* writer);
+
+/**
+ * @brief Writes the name of an object member, which the next value belongs
+ * to.
+ *
+ * @param writer The writer to write to.
+ * @param key The NUL-terminated member name. It is escaped as needed.
+ */
+void WriteJSONKey(JSONWriter* writer, const char* key);
+
+/**
+ * @brief Writes a string value, escaping it as needed.
+ *
+ * @param writer The writer to write to.
+ * @param data The bytes of the string. They do not need to be
+ * NUL-terminated.
+ * @param length The number of bytes in data.
+ */
+void WriteJSONString(JSONWriter* writer, const char* data, size_t length);
+
+#endif	// JSON_H
+
+// include/json.h
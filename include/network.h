@@ -1,32 +1,203 @@
 #ifndef NETWORK_H
 #define NETWORK_H
 
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
 #include "common.h"
+#include "connection.h"
 #include "parser.h"
 
+struct ThreadPool;
+
+/**
+ * @struct Reactor
+ * @brief An edge-triggered epoll event loop that owns client sockets.
+ *
+ * The reactor accepts new clients, keeps their sockets in non-blocking mode and
+ * reads from them as data arrives. Only once a complete request has been
+ * received is the connection handed to a Worker thread of the pool, so
+ * slow or idle clients never tie up a Worker.
+ *
+ * Connections the reactor owns are kept on an idle list ordered by their last
+ * activity, so that the once-a-second sweep only looks at the connections
+ * that have timed out.
+ */
+typedef struct Reactor {
+	int epoll_fd;							// epoll instance watching the listener and clients
+	int server_socket;				// Listening socket the reactor accepts from
+	struct ThreadPool* pool;	// Workers receiving connections with a request
+	time_t last_sweep;				// Monotonic time idle connections were last checked
+
+	struct Connection* idle_head;	 // Connection idle the longest (NULL-able)
+	struct Connection* idle_tail;	 // Connection active most recently (NULL-able)
+	pthread_mutex_t idle_lock;		 // Guards the idle list against Workers
+} Reactor;
+
+/**
+ * @brief Prints the first non-loopback IPv4 address of this machine.
+ */
+void PrintLocalIP();
+
 /**
  * @brief Initializes the server socket.
  *
  * This function creates a socket, binds it to the specified port, and prepares
- * it for listening to incoming client connections.
+ * it for listening to incoming client connections. With reuse_port set, several
+ * sockets may be bound to the same port and the kernel spreads incoming
+ * connections across them.
  *
  * @param port The port on which the server will listen.
  * @param max_connections The maximum number of pending connections.
+ * @param reuse_port Non-zero to set SO_REUSEPORT on the socket.
  * @return The server socket file descriptor (fd), -1 on error.
  */
-int CreateServerSocket(int port, int max_connections);
+int CreateServerSocket(int port, int max_connections, int reuse_port);
 
 /**
  * @brief Accepts a client connection.
  *
  * This function accepts an incoming client connection and returns the client
- * socket descriptor, allowing communication with the client.
+ * socket descriptor, allowing communication with the client. The returned
+ * socket is in non-blocking mode.
  *
  * @param server_socket The server socket file descriptor.
- * @return The client socket file descriptor, -1 on error.
+ * @return The client socket file descriptor, -1 on error or when no connection
+ * is pending (errno is EAGAIN in that case).
  */
 int AcceptClient(int server_socket);
 
+/**
+ * @brief Initializes the reactor for a listening socket.
+ *
+ * This function switches the server socket to non-blocking mode, creates the
+ * epoll instance and registers the server socket with it.
+ *
+ * @param reactor Pointer to the reactor structure to be initialized.
+ * @param server_socket The listening socket to accept clients from.
+ * @param pool Pointer to the thread pool that receives ready connections.
+ * @return 0 on success, -1 on error.
+ */
+int InitReactor(Reactor* reactor,
+								int server_socket,
+								struct ThreadPool* pool);
+
+/**
+ * @brief Runs the reactor event loop.
+ *
+ * This function blocks, accepting clients and reading their requests, until
+ * is_server_running is cleared. Connections that stay idle for longer than
+ * KEEP_ALIVE_TIMEOUT are closed.
+ *
+ * @param reactor Pointer to the reactor structure.
+ */
+void RunReactor(Reactor* reactor);
+
+/**
+ * @brief Allocates the table of tracked connections.
+ *
+ * The table is shared by all reactors and rings. Calling this function again
+ * once the table exists has no effect.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int InitConnectionTable();
+
+/**
+ * @brief Looks up the connection that owns a client socket.
+ *
+ * @param client_socket The client socket file descriptor.
+ * @return The connection, or NULL if the socket is not tracked.
+ */
+Connection* GetConnection(int client_socket);
+
+/**
+ * @brief Adds a connection to the table of tracked connections.
+ *
+ * @param connection Pointer to the connection to track.
+ * @return 0 on success, -1 if its socket is beyond MAX_CONNECTIONS.
+ */
+int RegisterConnection(Connection* connection);
+
+/**
+ * @brief Removes a connection from the table without closing or freeing it.
+ *
+ * This is used when the socket is about to be closed asynchronously, since the
+ * descriptor number may be reused as soon as the close completes.
+ *
+ * @param client_socket The client socket file descriptor.
+ */
+void UnregisterConnection(int client_socket);
+
+/**
+ * @brief Closes a client connection and frees its resources.
+ *
+ * @param client_socket The client socket file descriptor.
+ */
+void CloseConnection(int client_socket);
+
+/**
+ * @brief Sends the pending response of a connection and releases it.
+ *
+ * This function is called by a Worker once HandleTransaction() has produced a
+ * response. Connections served by the io_uring backend are handed back to
+ * their ring, which batches the sends and closes; all others are written
+ * directly, as far as the socket takes them without blocking. The event loop
+ * sends whatever is left once the socket becomes writable. Persistent
+ * connections then wait in their event loop for the next request, all others
+ * are closed.
+ *
+ * @param client_socket The client socket file descriptor.
+ * @return 1 if the next request is already buffered and should be handled by
+ * the caller right away, 0 otherwise.
+ */
+int ReleaseConnection(int client_socket);
+
+/**
+ * @brief Sends the response bytes queued on a connection so far.
+ *
+ * This function lets a Worker send the first part of a large response while
+ * it still builds the rest. It writes directly to the socket with either
+ * backend, but never waits for it: whatever the socket does not take stays
+ * queued and goes out with the rest of the response. Once everything queued
+ * has been sent, it is dropped.
+ *
+ * @param connection Pointer to the connection, owned by the calling Worker.
+ * @return 0 if everything queued has been sent, 1 if some of it is still
+ * queued, -1 on error.
+ */
+int FlushConnection(Connection* connection);
+
+/**
+ * @brief Returns the current monotonic time in seconds.
+ *
+ * @return Seconds since an unspecified starting point.
+ */
+time_t GetMonotonicTime();
+
+/**
+ * @brief Returns the current monotonic time in nanoseconds.
+ *
+ * @return Nanoseconds since an unspecified starting point.
+ */
+uint64_t GetMonotonicTimeNs();
+
+/**
+ * @brief Closes the epoll instance of a reactor.
+ *
+ * @param reactor Pointer to the reactor structure.
+ */
+void CleanupReactor(Reactor* reactor);
+
+/**
+ * @brief Closes every connection still tracked and frees the connection table.
+ *
+ * Must only be called once all reactors and Worker threads have stopped.
+ */
+void CloseAllConnections();
+
 /**
  * @brief Closes the server socket.
  *
@@ -1,18 +1,74 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <stddef.h>
+
+#include "arena.h"
+
+/**
+ * @struct StringView
+ * @brief A (pointer, length) slice of bytes owned by someone else.
+ *
+ * Views are not NUL-terminated and stay valid only as long as the memory they
+ * point into.
+ */
+typedef struct {
+	const char* data;	 // First byte of the slice (NULL-able if length is 0)
+	size_t length;		 // Number of bytes in the slice
+} StringView;
+
+// Number of headers a parsed request indexes; further ones are still found
+// by GetHTTPHeader(), by scanning the header block.
+#define MAX_HEADERS 32
+
+/**
+ * @enum HeaderID
+ * @brief Well-known headers, which the parser files into fixed slots.
+ */
+typedef enum {
+	HEADER_OTHER = -1,				 // Any header not listed below
+	HEADER_CONTENT_LENGTH,		 // Content-Length
+	HEADER_CONTENT_TYPE,			 // Content-Type
+	HEADER_CONNECTION,				 // Connection
+	HEADER_ACCEPT_ENCODING,		 // Accept-Encoding
+	HEADER_IF_NONE_MATCH,			 // If-None-Match
+	HEADER_HOST,							 // Host
+	HEADER_TRANSFER_ENCODING,	 // Transfer-Encoding
+	HEADER_EXPECT,						 // Expect
+	NUM_KNOWN_HEADERS,
+} HeaderID;
+
+/**
+ * @struct HTTPHeader
+ * @brief A single header line of a parsed request.
+ */
+typedef struct {
+	StringView name;	 // Header name as sent, without the colon
+	StringView value;	 // Value without surrounding whitespace
+	HeaderID id;			 // ID of a well-known name, or HEADER_OTHER
+} HTTPHeader;
+
 /**
  * @struct HTTPRequest
  * @brief Represents a parsed HTTP request.
  *
  * This structure breaks down the HTTP request into its method, path, headers,
- * and body.
+ * and body. Every field is a view into the buffer the request was parsed
+ * from, so parsing allocates nothing and the buffer must outlive the request.
+ * Besides the raw header block, the parser builds an index of the header
+ * lines, so looking up a header never rescans the block. Slots of
+ * known_headers whose header is absent have a NULL data pointer.
  */
 typedef struct {
-	char* method;		// HTTP method (e.g., "GET", "POST")
-	char* path;			// Request path (e.g., "/api/data")
-	char* headers;	// Full headers as a string
-	char* body;			// HTTP request body
+	StringView method;	 // HTTP method (e.g., "GET", "POST")
+	StringView path;		 // Request path (e.g., "/api/data")
+	StringView version;	 // HTTP version (e.g., "HTTP/1.1"), empty if absent
+	StringView headers;	 // Header lines, each ending in CRLF
+	StringView body;		 // HTTP request body
+
+	HTTPHeader header_index[MAX_HEADERS];					// First header lines
+	size_t num_headers;														// Header lines, indexed or not
+	StringView known_headers[NUM_KNOWN_HEADERS];	// First value per HeaderID
 } HTTPRequest;
 
 /**
@@ -21,49 +77,121 @@ typedef struct {
  *
  * This structure encapsulates the essential components of an HTTP response:
  * status code, headers, and body. It is dynamically created and should be freed
- * after being sent to avoid memory leaks.
+ * after being sent to avoid memory leaks. The body is either owned by the
+ * response or borrowed from storage that outlives it, such as a string
+ * literal or the arena of the request, so that it can be sent without being
+ * copied.
  */
 typedef struct {
-	int status_code;	// The HTTP status code (e.g., 200, 404, 405).
-	char* headers;		// The headers section of the response (NULL-able)
-	char* body;				// The body of the response (NULL-able).
+	int status_code;		 // The HTTP status code (e.g., 200, 404, 405).
+	char* headers;			 // The headers section of the response (NULL-able)
+	char* body;					 // The body of the response (NULL-able).
+	size_t body_length;	 // Number of bytes in body
+	int owns_body;			 // Non-zero if body is freed together with the response
+	Arena* arena;				 // Arena the response lives in, NULL for malloc()
+	int is_static;			 // Non-zero if shared by all requests and never freed
 } HTTPResponse;
 
 /**
- * @brief Parses the raw HTTP request string into a structured HTTPRequest
- * object.
+ * @brief Parses a raw HTTP request into views of its parts.
+ *
+ * The request is scanned once by a state machine that records where the
+ * method, path, version, header block and body start and end. Runs of bytes
+ * inside tokens and header lines are skipped with FindDelimiter(), a vector
+ * at a time. Nothing is copied or allocated.
+ *
+ * @param data The raw HTTP request, from its request line up to the end of its
+ * body. It does not need to be NUL-terminated.
+ * @param length The number of bytes in data.
+ * @param request Pointer to the structure receiving the views into data.
+ * @return 0 on success, -1 if the request line or the headers are malformed.
+ */
+int ParseHTTPRequest(const char* data, size_t length, HTTPRequest* request);
+
+/**
+ * @brief Maps a header name to the ID of a well-known header.
+ *
+ * The names of the well-known headers hash to distinct slots by their length
+ * and first letter, so a lookup costs one table access and one
+ * case-insensitive comparison.
+ *
+ * @param name The header name, without the colon.
+ * @param length The number of bytes in name.
+ * @return The ID of the header, or HEADER_OTHER if it is not well-known.
+ */
+HeaderID GetHeaderID(const char* name, size_t length);
+
+/**
+ * @brief Looks up a header of a parsed request.
+ *
+ * Header names are compared case-insensitively. Leading and trailing
+ * whitespace is stripped from the value. Well-known headers are found in
+ * constant time; any other header is searched for in the header index.
+ *
+ * @param request The parsed request.
+ * @param name The header name, without the colon.
+ * @param value Receives a view of the value of the first matching header.
+ * @return 1 if the header is present, 0 otherwise.
+ */
+int GetHTTPHeader(const HTTPRequest* request,
+									const char* name,
+									StringView* value);
+
+/**
+ * @brief Looks up a well-known header of a parsed request in constant time.
+ *
+ * @param request The parsed request.
+ * @param id The ID of the header.
+ * @param value Receives a view of the value of the first such header.
+ * @return 1 if the header is present, 0 otherwise.
+ */
+int GetKnownHTTPHeader(const HTTPRequest* request,
+											 HeaderID id,
+											 StringView* value);
+
+/**
+ * @brief Reads the minor version of an HTTP/1.x request.
  *
- * This function tokenizes the HTTP request and extracts the method, path,
- * headers, and body.
+ * A request without a version is treated as HTTP/1.0. Later HTTP/1.x
+ * versions are answered as HTTP/1.1, which they are compatible with.
  *
- * @param raw_request The raw HTTP request string.
- * @return A dynamically allocated HTTPRequest structure. Must be freed after
- * use. NULL on error
+ * @param request The parsed request.
+ * @return 0 for HTTP/1.0, 1 or more for HTTP/1.1 and later 1.x versions, or
+ * -1 for any other version, which the server does not support.
  */
-HTTPRequest* ParseHTTPRequest(const char* raw_request);
+int GetHTTPMinorVersion(const HTTPRequest* request);
 
 /**
- * @brief Frees the memory associated with an HTTPRequest structure.
+ * @brief Releases an HTTPRequest structure.
  *
- * This includes all dynamically allocated strings inside the structure.
+ * The views own no memory, so this only resets them.
  *
- * @param request A pointer to the HTTPRequest structure to be freed.
+ * @param request A pointer to the HTTPRequest structure to be released.
  */
 void FreeHTTPRequest(HTTPRequest* request);
 
 /**
- * @brief Constructs an HTTPResponse object.
+ * @brief Constructs an HTTPResponse object without copying its body.
  *
- * Helper to easily create an HTTP response with status, headers, and body.
+ * Helper to easily create an HTTP response with status and body. The body is
+ * sent as application/json; Content-Length is derived from body_length.
  *
+ * @param arena The arena of the request the response answers, or NULL to
+ * allocate it with malloc().
  * @param status_code HTTP status code.
- * @param headers HTTP headers string (NULL-able).
- * @param body HTTP body string (NULL-able).
- * @return A dynamically allocated HTTPResponse. Must be freed after use.
+ * @param body HTTP body (NULL-able). Must be heap memory if owns_body is
+ * non-zero, and outlive the response otherwise.
+ * @param body_length Number of bytes in body.
+ * @param owns_body Non-zero to hand body over to the response. It is freed
+ * with the response, or right away on error.
+ * @return The HTTPResponse, or NULL on error. Must be released with
+ * FreeHTTPResponse(), even if it lives in an arena.
  */
-HTTPResponse* CreateHTTPResponse(int status_code,
-																 const char* headers,
-																 const char* body);
+HTTPResponse* CreateHTTPResponse(Arena* arena,
+																 int status_code,
+																 const char* body,
+																 size_t body_length,
+																 int owns_body);
 
 /**
  * @brief Parses a raw HTTP response into an HTTPResponse structure.
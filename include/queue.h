@@ -1,63 +1,157 @@
 #ifndef QUEUE_H
 #define QUEUE_H
 
-#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Assumed size of a cache line, used to keep hot fields apart.
+ */
+#define QUEUE_CACHE_LINE_SIZE 64
+
+/**
+ * @struct QueueCell
+ * @brief A single slot of the queue.
+ *
+ * The sequence number tells producers and consumers whose turn it is to use
+ * the slot, so that no lock is needed to hand the socket over.
+ */
+typedef struct {
+	size_t sequence;		// Position the slot is ready for
+	int client_socket;	// Stored client socket descriptor
+} QueueCell;
 
 /**
  * @struct Queue
  * @brief Represents a queue for storing client socket descriptors.
  *
- * This structure maintains the client socket descriptors in a circular queue.
- * The queue is thread-safe and uses a mutex for synchronization.
+ * This structure maintains the client socket descriptors in a bounded
+ * lock-free circular queue that any number of threads may push to and pop
+ * from. The producer and consumer positions live on separate cache lines, so
+ * event loops and Workers do not invalidate each other's lines. Idle Workers
+ * sleep on a futex instead of spinning.
  */
 typedef struct {
-	int* queue;	 // Array to store client sockets
-	int size;		 // Maximum size of the queue
-	int front, rear, count;
-	pthread_mutex_t lock;	 // Mutex to ensure thread safety
-	pthread_cond_t cond;	 // Condition variable for threads to be notified
+	QueueCell* cells;	 // Array of slots, its size is a power of two
+	size_t mask;			 // Number of slots minus one
+	char padding0[QUEUE_CACHE_LINE_SIZE];
+	size_t enqueue_position;	// Next position to push to
+	char padding1[QUEUE_CACHE_LINE_SIZE];
+	size_t dequeue_position;	// Next position to pop from
+	char padding2[QUEUE_CACHE_LINE_SIZE];
+	unsigned int wake_sequence;	 // Futex word, bumped to wake sleeping Workers
+	int num_sleepers;						 // Number of Workers sleeping on the futex
+	char padding3[QUEUE_CACHE_LINE_SIZE];
 } Queue;
 
 /**
  * @brief Initializes a client queue.
  *
- * This function initializes a queue to hold client socket descriptors,
- * allocates memory for the queue array, and sets up mutex and condition
- * variable for thread synchronization.
+ * This function initializes a queue to hold client socket descriptors and
+ * allocates memory for its slots. The size is rounded up to a power of two.
  *
  * @param queue Pointer to the client queue structure.
+ * @param size The minimum number of sockets the queue can hold.
  */
 void InitQueue(Queue* queue, int size);
 
 /**
  * @brief Adds a client socket descriptor to the queue.
  *
- * This function adds a new client socket to the queue, and signals a Worker
- * thread to process the newly added connection. If the queue is full, the
- * connection is dropped.
+ * This function adds a new client socket to the queue without taking a lock,
+ * and wakes a sleeping Worker thread if there is one. If the queue is full,
+ * the connection is dropped.
  *
  * @param queue Pointer to the client queue structure.
  * @param client_socket The client socket descriptor to be added to the queue.
+ * @return 0 on success, -1 if the connection was dropped.
  */
-void Enqueue(Queue* queue, int client_socket);
+int Enqueue(Queue* queue, int client_socket);
 
 /**
  * @brief Retrieves a client socket descriptor from the queue.
  *
- * This function blocks and waits for a Worker thread to be notified when a
- * client connection is added to the queue. Once a client socket is available,
- * it returns the socket descriptor.
+ * This function blocks until a client connection is added to the queue. A
+ * Worker briefly spins on an empty queue before it sleeps on the futex. Once a
+ * client socket is available, it returns the socket descriptor.
  *
  * @param queue Pointer to the client queue structure.
- * @return The client socket descriptor.
+ * @return The client socket descriptor, or -1 once the server stops running.
  */
 int Dequeue(Queue* queue);
 
+/**
+ * @brief Retrieves a client socket descriptor without blocking.
+ *
+ * @param queue Pointer to the client queue structure.
+ * @return The client socket descriptor, or -1 if the queue is empty.
+ */
+int TryDequeue(Queue* queue);
+
+/**
+ * @brief Retrieves a client socket from the queue or, failing that, elsewhere.
+ *
+ * This function spins and sleeps like Dequeue(), except that whenever the
+ * queue is empty the steal callback is tried before the caller goes to sleep,
+ * and that it sleeps only once. Only the owner of the queue may wait on it
+ * this way; producers that want the sleeper to look elsewhere call
+ * WakeQueue().
+ *
+ * @param queue Pointer to the client queue structure.
+ * @param steal Callback returning a client socket from another source, or -1
+ * if there is none (NULL-able).
+ * @param arg Argument passed to steal.
+ * @return The client socket descriptor, or -1 if none turned up before the
+ * sleep timed out or was interrupted by WakeQueue().
+ */
+int DequeueOrSteal(Queue* queue, int (*steal)(void* arg), void* arg);
+
+/**
+ * @brief Retrieves a client socket descriptor, waiting a limited time for one.
+ *
+ * Unlike Dequeue(), this function does not spin: it sleeps on the futex right
+ * away and returns as soon as a client socket is added or the timeout passes.
+ * It may also return early if another thread is woken on the same queue.
+ *
+ * @param queue Pointer to the client queue structure.
+ * @param timeout Nanoseconds to wait at most, 0 to not wait at all.
+ * @return The client socket descriptor, or -1 if none arrived in time.
+ */
+int DequeueWithTimeout(Queue* queue, uint64_t timeout);
+
+/**
+ * @brief Returns the number of client sockets waiting in the queue.
+ *
+ * The result is a snapshot that may already be stale when it is returned.
+ *
+ * @param queue Pointer to the client queue structure.
+ * @return The approximate number of queued sockets.
+ */
+size_t QueueLength(Queue* queue);
+
+/**
+ * @brief Checks whether a thread is sleeping in Dequeue() on the queue.
+ *
+ * @param queue Pointer to the client queue structure.
+ * @return 1 if at least one thread is sleeping, 0 otherwise.
+ */
+int HasSleepers(Queue* queue);
+
+/**
+ * @brief Wakes every Worker thread blocked in Dequeue().
+ *
+ * This function is used during shutdown, after is_server_running has been
+ * cleared, so that waiting Workers notice the flag and return. It also sends
+ * an idle Worker looking for work in other queues.
+ *
+ * @param queue Pointer to the client queue structure.
+ */
+void WakeQueue(Queue* queue);
+
 /**
  * @brief Cleans up and frees resources allocated for the queue.
  *
- * This function frees the memory for the queue array and destroys the mutex
- * and condition variable.
+ * This function frees the memory for the queue slots.
  *
  * @param queue Pointer to the client queue structure.
  */
@@ -65,4 +159,4 @@ void CleanupQueue(Queue* queue);
 
 #endif	// QUEUE_H
 
-// include/queue.h
\ No newline at end of file
+// include/queue.h
@@ -0,0 +1,72 @@
+#ifndef RECORD_CACHE_H
+#define RECORD_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+/**
+ * @brief Sets up the cache of records in front of the database.
+ *
+ * The records are spread over shards by the hash of their key, and every
+ * shard has a lock of its own, so threads looking up different keys rarely
+ * wait for each other. Lookups only take the lock for reading. Each shard
+ * evicts with the CLOCK algorithm once its share of the capacity is used.
+ *
+ * @param capacity Bytes the cached records may take, keys, values and
+ * bookkeeping included. 0 disables the cache.
+ */
+void InitRecordCache(size_t capacity);
+
+/**
+ * @brief Looks up the value of a key.
+ *
+ * @param key The NUL-terminated key to look up.
+ * @param arena The arena to copy the value into, or NULL to use malloc().
+ * @param value Receives a copy of the value on a hit.
+ * @param generation Receives the state of the shard of key on a miss, to be
+ * passed to InsertRecord() once the value has been read from the database.
+ * @return 1 on a hit, 0 on a miss or if the copy failed.
+ */
+int LookupRecord(const char* key,
+								 Arena* arena,
+								 char** value,
+								 uint64_t* generation);
+
+/**
+ * @brief Adds a value read from the database after a miss.
+ *
+ * The value is dropped if the shard of key has been written to since the
+ * lookup, as it may have been read before that write committed.
+ *
+ * @param key The NUL-terminated key.
+ * @param value The NUL-terminated value read from the database.
+ * @param generation The generation returned by LookupRecord().
+ */
+void InsertRecord(const char* key, const char* value, uint64_t generation);
+
+/**
+ * @brief Brings the cache in line with a write to the database.
+ *
+ * Must be called after the write has committed, or failed.
+ *
+ * @param key The NUL-terminated key that was written.
+ * @param value The NUL-terminated value stored under key, or NULL if key was
+ * deleted or the write failed.
+ */
+void UpdateRecord(const char* key, const char* value);
+
+/**
+ * @brief Prints the hits, misses and evictions of the cache.
+ */
+void PrintRecordCacheStats();
+
+/**
+ * @brief Frees every cached record and the shards.
+ */
+void CleanupRecordCache();
+
+#endif	// RECORD_CACHE_H
+
+// include/record_cache.h
@@ -0,0 +1,128 @@
+#ifndef RESPONSE_H
+#define RESPONSE_H
+
+#include <stddef.h>
+
+#include "connection.h"
+
+/**
+ * @struct ResponseBlock
+ * @brief A piece of a response body, allocated from the connection arena.
+ */
+typedef struct ResponseBlock {
+	struct ResponseBlock* next;	 // Block filled after this one (NULL-able)
+	size_t length;							 // Number of bytes written into data
+	size_t capacity;						 // Size of data
+	char data[];								 // The body bytes
+} ResponseBlock;
+
+/**
+ * @struct ResponseBuilder
+ * @brief Builds a response body of any size without ever moving it.
+ *
+ * The body is written into a chain of blocks from the arena of the
+ * connection, each twice as large as the one before, so a growing body is
+ * never copied and needs few segments. Once finished, the blocks are queued
+ * on the connection without copying them.
+ *
+ * With a known length the header block carries Content-Length, which is only
+ * known once the body is complete, so all blocks are held back until then.
+ * A chunked response queues its header block right away, and every block as a
+ * chunk as soon as it is full. Once the queued chunks add up to a threshold,
+ * they are sent to the client while the rest of the body is still being
+ * written, and their blocks are written into again.
+ */
+typedef struct {
+	Connection* connection;	 // Connection the response is queued on
+	int status_code;				 // HTTP status code
+	int is_chunked;					 // Non-zero for Transfer-Encoding: chunked
+	int has_failed;					 // Non-zero once an allocation or a send failed
+	ResponseBlock* head;		 // First block not sent yet (NULL-able)
+	ResponseBlock* pending;	 // First block not queued yet (NULL-able)
+	ResponseBlock* tail;		 // Block being written into (NULL-able)
+	ResponseBlock* spare;		 // Sent blocks free to be reused (NULL-able)
+	size_t last_capacity;		 // Size of the latest block, doubled for the next
+	size_t body_length;			 // Number of body bytes written so far
+} ResponseBuilder;
+
+/**
+ * @brief Formats the status line and headers of a response, like snprintf().
+ *
+ * @param output The buffer to write into (NULL-able if size is 0).
+ * @param size The size of output, including room for the terminating NUL.
+ * @param status_code HTTP status code.
+ * @param headers Extra header lines, each ending with CRLF (NULL-able).
+ * @param is_chunked Non-zero for Transfer-Encoding: chunked, zero for
+ * Content-Length.
+ * @param body_length The length of the body, unless it is chunked.
+ * @param keep_alive Non-zero to keep the connection open afterwards.
+ * @return The length of the formatted headers, or a negative value on error.
+ */
+int FormatResponseHeaders(char* output,
+													size_t size,
+													int status_code,
+													const char* headers,
+													int is_chunked,
+													size_t body_length,
+													int keep_alive);
+
+/**
+ * @brief Starts building a JSON response on a connection.
+ *
+ * @param builder The builder to initialize.
+ * @param connection The connection the response is queued on. Its
+ * keep_alive decides the Connection header.
+ * @param status_code HTTP status code.
+ * @param is_chunked Non-zero if the final size is not known in advance. Must
+ * only be used in answer to HTTP/1.1 requests.
+ * @return 0 on success, -1 on error.
+ */
+int BeginResponse(ResponseBuilder* builder,
+									Connection* connection,
+									int status_code,
+									int is_chunked);
+
+/**
+ * @brief Reserves contiguous space at the end of the body.
+ *
+ * @param builder The builder to write into.
+ * @param length The number of bytes the caller is about to write.
+ * @return Pointer to length writable bytes, or NULL on error. The bytes are
+ * added to the body by CommitResponseBody().
+ */
+char* ReserveResponseBody(ResponseBuilder* builder, size_t length);
+
+/**
+ * @brief Adds bytes written into space returned by ReserveResponseBody().
+ *
+ * @param builder The builder to write into.
+ * @param length The number of bytes that have been written.
+ */
+void CommitResponseBody(ResponseBuilder* builder, size_t length);
+
+/**
+ * @brief Copies bytes to the end of the body.
+ *
+ * The bytes may be spread over several blocks, so they can be of any size.
+ *
+ * @param builder The builder to write into.
+ * @param data The bytes to add.
+ * @param length The number of bytes in data.
+ * @return 0 on success, -1 on error.
+ */
+int AppendResponseBody(ResponseBuilder* builder,
+											 const char* data,
+											 size_t length);
+
+/**
+ * @brief Queues the whole response on the connection, or the part of it
+ * that has not been sent yet.
+ *
+ * @param builder The builder to finish. It must not be used afterwards.
+ * @return 0 on success, -1 if any step of the response failed.
+ */
+int FinishResponse(ResponseBuilder* builder);
+
+#endif	// RESPONSE_H
+
+// include/response.h
@@ -0,0 +1,168 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stddef.h>
+
+#include "arena.h"
+#include "parser.h"
+
+// Number of query parameters a matched request can carry.
+#define MAX_QUERY_PARAMS 16
+
+/**
+ * @enum HTTPMethod
+ * @brief Request methods the router dispatches on.
+ */
+typedef enum {
+	METHOD_INVALID = -1,	// Any method not listed below
+	METHOD_GET,						// GET
+	METHOD_POST,					// POST
+	METHOD_DELETE,				// DELETE
+	NUM_METHODS,
+} HTTPMethod;
+
+/**
+ * @enum RouteResult
+ * @brief Outcome of matching a request against the route table.
+ */
+typedef enum {
+	ROUTE_FOUND,							 // A handler serves the method and path
+	ROUTE_NOT_FOUND,					 // No route has the path
+	ROUTE_METHOD_NOT_ALLOWED,	 // The path is routed, but not for the method
+	ROUTE_BAD_QUERY,					 // The query is malformed or too long
+	ROUTE_ERROR,							 // Decoding the request failed
+} RouteResult;
+
+/**
+ * @struct QueryParam
+ * @brief A percent-decoded key=value pair of the query string.
+ */
+typedef struct {
+	StringView key;		 // Decoded key
+	StringView value;	 // Decoded value, empty if the key has no '='
+} QueryParam;
+
+struct RouteMatch;
+
+/**
+ * @brief Serves the requests of a route.
+ *
+ * @param request The parsed request.
+ * @param match The matched route, with the query parameters of the request.
+ * @param context Data the caller of the router passes through.
+ * @return The response, or NULL if none is due yet or on error.
+ */
+typedef HTTPResponse* (*RouteHandler)(const HTTPRequest* request,
+																			const struct RouteMatch* match,
+																			void* context);
+
+/**
+ * @struct RouteMatch
+ * @brief The handler and the query parameters of a matched request.
+ *
+ * Keys and values are views into the request where they contain no escapes,
+ * and into the arena passed to MatchRoute() otherwise, so most matches copy
+ * nothing.
+ */
+typedef struct RouteMatch {
+	RouteHandler handler;									// Handler of the method and path
+	QueryParam params[MAX_QUERY_PARAMS];	// Query parameters, in order
+	size_t num_params;										// Number of entries in params
+} RouteMatch;
+
+/**
+ * @struct RouteNode
+ * @brief A node of the route trie, standing for a prefix of a routed path.
+ */
+typedef struct {
+	char byte;													 // Last byte of the prefix
+	int first_child;										 // Index of the first child, or -1
+	int next_sibling;										 // Index of the next sibling, or -1
+	RouteHandler handlers[NUM_METHODS];	 // Handlers if a path ends here
+} RouteNode;
+
+/**
+ * @struct Router
+ * @brief A route table, compiled into a trie over the paths.
+ *
+ * Each node holds the handlers of the path ending in it, indexed by method,
+ * so a match costs one step per byte of the path and one array access,
+ * however many routes there are.
+ */
+typedef struct {
+	RouteNode* nodes;	 // Trie nodes, the root first
+	size_t num_nodes;	 // Number of nodes in use
+	size_t capacity;	 // Allocated number of nodes
+} Router;
+
+/**
+ * @brief Maps a method name to its HTTPMethod.
+ *
+ * @param method The method, as sent in the request line.
+ * @return The method, or METHOD_INVALID if it is not supported.
+ */
+HTTPMethod GetHTTPMethod(StringView method);
+
+/**
+ * @brief Initializes an empty route table.
+ *
+ * @param router The route table to initialize.
+ * @return 0 on success, -1 on error.
+ */
+int InitRouter(Router* router);
+
+/**
+ * @brief Adds a route to the table.
+ *
+ * Routes are added at startup, before any request is matched.
+ *
+ * @param router The route table.
+ * @param method The method the route serves.
+ * @param path The decoded path the route serves, e.g. "/".
+ * @param handler The handler serving the route.
+ * @return 0 on success, -1 on error.
+ */
+int AddRoute(Router* router,
+						 HTTPMethod method,
+						 const char* path,
+						 RouteHandler handler);
+
+/**
+ * @brief Finds the handler of a request and parses its query string.
+ *
+ * The path is percent-decoded before it is matched. Query parameters are
+ * split on '&' and '=', and their keys and values are percent-decoded, with
+ * '+' standing for a space.
+ *
+ * @param router The route table.
+ * @param request The parsed request.
+ * @param arena The arena decoded bytes are allocated from, when there are any.
+ * @param match Receives the handler and the query parameters. Valid until the
+ * arena is reset.
+ * @return The outcome of the match.
+ */
+RouteResult MatchRoute(const Router* router,
+											 const HTTPRequest* request,
+											 Arena* arena,
+											 RouteMatch* match);
+
+/**
+ * @brief Looks up a query parameter of a matched request.
+ *
+ * @param match The matched route.
+ * @param key The decoded key, compared case-sensitively.
+ * @param value Receives a view of the value of the first matching parameter.
+ * @return 1 if the parameter is present, 0 otherwise.
+ */
+int GetQueryParam(const RouteMatch* match, const char* key, StringView* value);
+
+/**
+ * @brief Frees the nodes of a route table.
+ *
+ * @param router The route table to free.
+ */
+void CleanupRouter(Router* router);
+
+#endif	// ROUTER_H
+
+// include/router.h
@@ -0,0 +1,102 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+/**
+ * @enum ScanLevel
+ * @brief Instruction set used to scan for delimiters.
+ */
+typedef enum {
+	SCAN_SCALAR,	// One byte at a time, through a lookup table
+	SCAN_SSE2,		// 16 bytes at a time
+	SCAN_AVX2,		// 32 bytes at a time
+} ScanLevel;
+
+/**
+ * @struct ScanSet
+ * @brief A set of up to four delimiter bytes to scan for.
+ *
+ * Unused entries of bytes repeat the first delimiter, so the vector scanners
+ * always compare against four bytes without branching on the set size.
+ */
+typedef struct {
+	char bytes[4];								// Delimiters, padded with bytes[0]
+	unsigned char table[256];	// Non-zero for every delimiter byte
+} ScanSet;
+
+extern const ScanSet LINE_END_DELIMITERS;	 // CR, LF
+extern const ScanSet TOKEN_DELIMITERS;		 // Space, CR, LF
+extern const ScanSet HEADER_DELIMITERS;		 // Colon, LF
+extern const ScanSet QUERY_DELIMITERS;		 // '?', '=', '&'
+
+/**
+ * @brief Selects the fastest scanner the CPU supports.
+ *
+ * Until this is called, the scalar scanner is used. It must be called before
+ * any thread is started.
+ *
+ * @return The selected level.
+ */
+ScanLevel InitScanner();
+
+/**
+ * @brief Forces a specific scanner, e.g. to compare them.
+ *
+ * @param level The level to use.
+ * @return 0 on success, -1 if the CPU does not support level.
+ */
+int SetScanLevel(ScanLevel level);
+
+/**
+ * @brief Returns a printable name of a scan level.
+ *
+ * @param level The level to name.
+ * @return A string literal such as "avx2".
+ */
+const char* GetScanLevelName(ScanLevel level);
+
+/**
+ * @brief Finds the first delimiter of a set.
+ *
+ * @param data The bytes to scan. They do not need to be NUL-terminated.
+ * @param length The number of bytes in data.
+ * @param set The delimiters to look for.
+ * @return The offset of the first delimiter, or length if there is none.
+ */
+size_t FindDelimiter(const char* data, size_t length, const ScanSet* set);
+
+/**
+ * @brief Finds the first occurrence of a byte sequence, like memmem().
+ *
+ * Candidates are found by comparing the first and the last byte of sequence
+ * against a whole vector of positions at once, so only positions matching
+ * both are compared in full.
+ *
+ * @param data The bytes to scan. They do not need to be NUL-terminated.
+ * @param length The number of bytes in data.
+ * @param sequence The bytes to look for.
+ * @param sequence_length The number of bytes in sequence, at least 1.
+ * @return Pointer to the first occurrence in data, or NULL if there is none.
+ */
+const char* FindSequence(const char* data,
+												 size_t length,
+												 const char* sequence,
+												 size_t sequence_length);
+
+/**
+ * @brief Finds the first byte a JSON string cannot hold as it is.
+ *
+ * These are the quote, the backslash and the control characters below 0x20.
+ * The tokenizer uses this to skip the plain bytes of a string, and the writer
+ * to copy them without escaping.
+ *
+ * @param data The bytes to scan. They do not need to be NUL-terminated.
+ * @param length The number of bytes in data.
+ * @return The offset of the first such byte, or length if there is none.
+ */
+size_t FindJSONSpecial(const char* data, size_t length);
+
+#endif	// SCAN_H
+
+// include/scan.h
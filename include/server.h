@@ -9,8 +9,9 @@ void InitServer();
 /**
  * @brief Starts the server loop and handles incoming connections.
  *
- * This function blocks and continuously accepts new client connections,
- * passing them to the thread pool for processing.
+ * This function blocks in the reactor event loop, accepting new client
+ * connections and passing each one to the thread pool once a complete request
+ * has been received.
  */
 void RunServer();
 
@@ -3,18 +3,14 @@
 
 #include <signal.h>
 
-#include "queue.h"
-
 /**
  * @brief Initializes signal handling for graceful server shutdown.
  *
  * Sets up handlers for signals like SIGINT using sigaction().
  * The handler updates the is_server_running flag to indicate termination
- * request.
- *
- * @param queue Pointer to the Queue structure used for thread communication.
+ * request. Threads blocked on a queue are woken by the server during shutdown.
  */
-void InitSignalHandlers(Queue* queue);
+void InitSignalHandlers();
 
 /**
  * @brief Signal handler function for handling termination signals.
@@ -2,9 +2,53 @@
 #define THREAD_POOL_H
 
 #include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 
+#include "connection.h"
 #include "queue.h"
 
+struct ThreadPool;
+
+/**
+ * @struct Worker
+ * @brief A thread of the pool together with its local queue.
+ *
+ * The event loop pushes a connection to the local queue of the Worker that
+ * served it last, so its buffers and database pages stay warm in that core's
+ * cache. A Worker whose local queue is empty steals from the other Workers
+ * before it goes to sleep.
+ */
+typedef struct {
+	struct ThreadPool* pool;	// Pool the Worker belongs to
+	int index;								// Position of the Worker in the pool
+	Queue queue;							// Local queue of connections ready to be served
+	pthread_t thread;					// Thread running WorkerThread()
+	int is_retiring;					// Non-zero once the Worker has been asked to exit
+	int has_exited;						// Non-zero once a retired Worker has stopped
+	uint64_t num_served;			// Connections taken from a queue so far
+	uint64_t wait_time;				// Total time they waited in a queue, in ns
+	uint64_t busy_time;				// Total time spent serving them, in ns
+} Worker;
+
+/**
+ * @struct ThreadPoolStats
+ * @brief Decisions taken by the manager of an elastic thread pool, and the
+ * queue depth and latency of the network stage it runs.
+ */
+typedef struct {
+	size_t num_grown;				 // Workers started because connections waited
+	size_t num_shrunk;			 // Workers retired after the pool had been idle
+	size_t num_stalls;			 // Checks in which queued connections did not move
+	size_t num_capped;			 // Checks that wanted to grow beyond max_threads
+	int peak_threads;				 // Largest number of Workers running at once
+	size_t max_queue_depth;	 // Most connections seen queued across all Workers
+	uint64_t num_served;		 // Connections taken from the queues, set on cleanup
+	uint64_t wait_time;			 // Their average queue wait in ns, set on cleanup
+	uint64_t busy_time;			 // Their average service time in ns, set on cleanup
+} ThreadPoolStats;
+
 /**
  * @struct ThreadPool
  * @brief A structure representing a thread pool.
@@ -12,50 +56,95 @@
  * This structure contains the necessary elements to manage a pool of threads
  * and distribute tasks to them. It handles the creation and management of
  * threads that will process client connections or other tasks concurrently.
+ *
+ * The pool is elastic: Workers 0 to num_threads - 1 are running, and a manager
+ * thread starts the next one whenever connections wait too long for a Worker
+ * or stop making progress, and retires the last one once the remaining
+ * Workers have had spare capacity for a whole cooldown.
  */
-typedef struct {
-	pthread_t* threads;	 // Array of thread IDs representing the thread pool
-	int num_threads;		 // Number of threads in the pool
-	Queue* queue;	 // Pointer to the client queue, which holds client sockets
-	pthread_mutex_t lock;	 // Mutex to synchronize access to shared resources
-	pthread_cond_t
-			cond;	 // Condition variable to signal Worker threads to process tasks
+typedef struct ThreadPool {
+	Worker* workers;					 // Array of max_threads Workers
+	int num_threads;					 // Number of running Workers
+	int min_threads;					 // Workers kept running even when idle
+	int max_threads;					 // Upper bound of num_threads
+	time_t cooldown;					 // Idle seconds before the last Worker retires
+	unsigned int next_worker;	 // Round-robin cursor for new connections
+	const int* cpus;					 // CPUs to pin Workers to (NULL-able)
+	int num_cpus;							 // Number of entries in cpus
+	pthread_t manager;				 // Thread running the grow and shrink policy
+	ThreadPoolStats stats;		 // Decisions of the manager, written by it only
 } ThreadPool;
 
 /**
  * @brief Initializes the thread pool.
  *
- * This function initializes the thread pool by allocating memory for the thread
- * array, initializing the mutex and condition variable, and creating the
- * threads that will wait for tasks in the client queue.
+ * This function initializes the thread pool by allocating memory for the
+ * Workers and their local queues, and creating the threads that will wait for
+ * connections in them.
+ *
+ * The pool starts with min_threads Workers, and a manager thread adjusts
+ * their number between min_threads and max_threads with the load.
+ *
+ * If CPUs are given, the i-th thread is pinned to cpus[i % num_cpus] before
+ * it starts, so the buffers it allocates are placed on the NUMA node of that
+ * CPU.
  *
  * @param pool Pointer to the thread pool structure to be initialized.
- * @param num_threads The number of threads to create in the pool.
- * @param queue Pointer to the client queue which holds the tasks (client
- * sockets).
+ * @param min_threads The number of threads to create in the pool.
+ * @param max_threads The number of threads the pool may grow to.
+ * @param cooldown Seconds of spare capacity after which a Worker is retired.
+ * @param cpus The CPUs to pin the threads to (NULL-able).
+ * @param num_cpus The number of entries in cpus, 0 to leave threads unpinned.
  */
-void InitThreadPool(ThreadPool* pool, int num_threads, Queue* queue);
+void InitThreadPool(ThreadPool* pool,
+										int min_threads,
+										int max_threads,
+										time_t cooldown,
+										const int* cpus,
+										int num_cpus);
+
+/**
+ * @brief Hands a connection with a complete request to a Worker.
+ *
+ * The connection goes to the Worker that served it last, or round-robin if
+ * it is new. If that Worker is busy while another one sleeps, the sleeper is
+ * woken to steal it.
+ *
+ * @param pool Pointer to the thread pool.
+ * @param connection The connection to be served.
+ * @return 0 on success, -1 if the connection was dropped.
+ */
+int SubmitConnection(ThreadPool* pool, Connection* connection);
 
 /**
  * @brief Worker function executed by each thread in the thread pool.
  *
  * This function represents the task that each thread in the pool will execute.
- * It continuously waits for tasks in the client queue and processes them when
- * available (e.g., handling client connections).
+ * It continuously waits for connections in its local queue, or steals them
+ * from other Workers, and processes them when available, until the server
+ * stops or the manager retires the Worker.
  *
- * @param arg Pointer to the thread pool structure passed to the Worker.
+ * @param arg Pointer to the Worker structure of the thread.
  * @return NULL.
  */
 void* WorkerThread(void* arg);
 
+/**
+ * @brief Prints the decisions the manager of the pool has taken.
+ *
+ * @param pool Pointer to the thread pool.
+ * @param name Label identifying the pool in the output.
+ */
+void PrintThreadPoolStats(ThreadPool* pool, const char* name);
+
 /**
  * @brief Destroys the thread pool.
  *
- * This function cleans up resources used by the thread pool, including joining
- * all threads and freeing allocated memory.
+ * This function stops the manager, wakes all Workers, joins their threads and
+ * frees allocated memory. is_server_running must have been cleared before.
  *
  * @param pool Pointer to the thread pool structure to be destroyed.
  */
 void CleanupThreadPool(ThreadPool* pool);
 
-#endif	// THREAD_POOL_H
\ No newline at end of file
+#endif	// THREAD_POOL_H
@@ -1,22 +1,63 @@
 #ifndef TRANSACTION_HANDLER_H
 #define TRANSACTION_HANDLER_H
 
+#include "connection.h"
 #include "parser.h"
 
+/**
+ * @brief Serializes the fixed responses of the server.
+ *
+ * Errors and fixed success replies are formatted once, status line, headers
+ * and body, so that answering with them later costs no formatting or
+ * allocation. Must be called before any request is handled.
+ */
+void InitStaticResponses();
+
+/**
+ * @brief Builds the route table of the server.
+ *
+ * Must be called before any request is handled.
+ */
+void InitRoutes();
+
 /**
  * @brief Handles an incoming HTTP request and generates an appropriate
  * response.
  *
  * This function is responsible for processing an incoming HTTP request, which
- * may be a GET, POST, or DELETE request. It processes the request, interacts
- * with the database as necessary, and constructs an HTTP response to be sent
- * back to the client. If the method is not supported, a 405 Method Not Allowed
- * response is returned.
+ * may be a GET, POST, or DELETE request. The route table picks the handler by
+ * method and path; the handler interacts with the database as necessary, and
+ * an HTTP response is constructed to be sent back to the client. Unknown paths
+ * are answered with 404 Not Found, and methods a path does not support with
+ * 405 Method Not Allowed.
  *
- * @param client_socket The socket descriptor for the client connection. This is
- * used to read the incoming request and send the response back to the client.
+ * Pipelined requests that are already buffered are answered in the same call,
+ * up to MAX_PIPELINED_REQUESTS at a time. Their responses are appended in
+ * order, so that the whole batch is flushed with a single write.
+ *
+ * Requests that need the database are parsed into a typed operation, which is
+ * handed to the database stage together with the connection. Once it has run,
+ * the connection comes back to a Worker, and the next call resumes the batch
+ * by answering that request.
+ *
+ * @param connection The client connection. Its buffer holds the complete
+ * requests received by the event loop, starting at offset. The serialized
+ * responses are stored in its output buffer, to be sent by
+ * ReleaseConnection().
+ * @return 1 if the connection has been handed to the database stage and must
+ * not be touched by the caller anymore, 0 if the batch is ready to be sent.
+ */
+int HandleTransaction(Connection* connection);
+
+/**
+ * @brief Frees the route table of the server.
+ */
+void CleanupRoutes();
+
+/**
+ * @brief Frees the fixed responses serialized by InitStaticResponses().
  */
-void HandleTransaction(int client_socket);
+void CleanupStaticResponses();
 
 #endif	// TRANSACTION_HANDLER_H
 
@@ -0,0 +1,99 @@
+#ifndef URING_H
+#define URING_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "connection.h"
+
+struct ThreadPool;
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+/**
+ * @struct Ring
+ * @brief An io_uring event loop that owns client sockets.
+ *
+ * The ring keeps a multishot accept armed on the listening socket and receives
+ * into a ring of kernel-provided buffers, so accepting and reading cost no
+ * syscall of their own. Completed requests are handed to the Workers of the
+ * pool. Workers hand the connection back once a response is ready, and
+ * the ring submits the send and close of all pending responses together.
+ */
+typedef struct Ring {
+	int ring_fd;							// io_uring instance
+	int event_fd;							// Signalled when Workers hand back a response
+	int server_socket;				// Listening socket with a multishot accept armed
+	struct ThreadPool* pool;	// Workers receiving connections with a request
+
+	unsigned* sq_head;					// Submission queue head (kernel owned)
+	unsigned* sq_tail;					// Submission queue tail (shared)
+	unsigned* sq_array;					// Submission queue index array
+	unsigned sq_mask;						// Mask for submission queue indices
+	unsigned sq_entries;				// Number of submission queue entries
+	unsigned sq_local_tail;			// Tail including unpublished entries
+	unsigned sq_submitted;			// Entries already passed to the kernel
+	struct io_uring_sqe* sqes;	// Submission queue entries
+	unsigned* cq_head;					// Completion queue head (shared)
+	unsigned* cq_tail;					// Completion queue tail (kernel owned)
+	unsigned cq_mask;						// Mask for completion queue indices
+	struct io_uring_cqe* cqes;	// Completion queue entries
+	void* rings;								// Mapping of both queue rings
+	size_t rings_size;					// Size of the rings mapping
+	size_t sqes_size;						// Size of the sqes mapping
+
+	struct io_uring_buf_ring* buf_ring;	 // Provided receive buffers
+	char* buffers;											 // Memory backing buf_ring
+	uint64_t event_value;								 // Target of the eventfd read
+
+	pthread_mutex_t lock;	 // Protects ready and num_ready
+	int* ready;						 // Sockets whose response is ready to be sent
+	size_t num_ready;			 // Number of entries in ready
+} Ring;
+
+/**
+ * @brief Initializes an io_uring instance for a listening socket.
+ *
+ * This function fails when the running kernel lacks io_uring or any of the
+ * features the backend relies on (multishot accept, provided buffer rings and
+ * timed waits), so that the caller can fall back to the epoll reactor.
+ *
+ * @param ring Pointer to the ring structure to be initialized.
+ * @param server_socket The listening socket to accept clients from.
+ * @param pool Pointer to the thread pool that receives ready connections.
+ * @return 0 on success, -1 on error.
+ */
+int InitRing(Ring* ring, int server_socket, struct ThreadPool* pool);
+
+/**
+ * @brief Runs the io_uring event loop.
+ *
+ * This function blocks, accepting clients, receiving their requests and
+ * sending their responses, until is_server_running is cleared.
+ *
+ * @param ring Pointer to the ring structure.
+ */
+void RunRing(Ring* ring);
+
+/**
+ * @brief Hands a connection with a pending response back to its ring.
+ *
+ * This function is called from Worker threads. The ring sends the response
+ * and closes the connection on its next iteration.
+ *
+ * @param connection Pointer to the connection holding the response.
+ */
+void SubmitRingResponse(Connection* connection);
+
+/**
+ * @brief Tears down the io_uring instance and frees its buffers.
+ *
+ * @param ring Pointer to the ring structure.
+ */
+void CleanupRing(Ring* ring);
+
+#endif	// URING_H
+
+// include/uring.h
@@ -0,0 +1,77 @@
+#include "arena.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "buffer_pool.h"
+#include "common.h"
+
+// Alignment of every allocation, enough for any scalar or SSE type.
+static const size_t ARENA_ALIGNMENT = 16;
+
+static size_t AlignUp(size_t size) {
+	return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static ArenaBlock* AddBlock(Arena* arena, size_t size) {
+	size_t needed = AlignUp(sizeof(ArenaBlock)) + size;
+	if (needed < BUFFER_SIZE) {
+		needed = BUFFER_SIZE;
+	}
+
+	size_t capacity = 0;
+	ArenaBlock* block = (ArenaBlock*)AllocatePooledBuffer(needed, &capacity);
+	if (block == NULL) {
+		return NULL;
+	}
+
+	block->next = arena->head;
+	block->capacity = capacity;
+	block->used = AlignUp(sizeof(ArenaBlock));
+	arena->head = block;
+
+	return block;
+}
+
+void* ArenaAllocate(Arena* arena, size_t size) {
+	size = AlignUp(size);
+
+	ArenaBlock* block = arena->head;
+	if (block == NULL || block->capacity - block->used < size) {
+		block = AddBlock(arena, size);
+		if (block == NULL) {
+			return NULL;
+		}
+	}
+
+	void* memory = (char*)block + block->used;
+	block->used += size;
+
+	return memory;
+}
+
+char* ArenaStrndup(Arena* arena, const char* data, size_t length) {
+	char* copy = (char*)ArenaAllocate(arena, length + 1);
+	if (copy == NULL) {
+		return NULL;
+	}
+
+	memcpy(copy, data, length);
+	copy[length] = '\0';
+
+	return copy;
+}
+
+void ResetArena(Arena* arena) {
+	ArenaBlock* block = arena->head;
+
+	while (block != NULL) {
+		ArenaBlock* next = block->next;
+		FreePooledBuffer(block, block->capacity);
+		block = next;
+	}
+
+	arena->head = NULL;
+}
+
+// src/arena.c
\ No newline at end of file
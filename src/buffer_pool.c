@@ -0,0 +1,270 @@
+#include "buffer_pool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+// Upper bound on the number of size classes, BUFFER_SIZE << 15 is far beyond
+// any MAX_REQUEST_SIZE.
+#define MAX_SIZE_CLASSES 16
+
+// Upper bound on the number of buffers a thread caches per class.
+#define MAX_CACHED_BUFFERS 64
+
+static const size_t THREAD_CACHE_SIZE = 256 * 1024;
+static const size_t DEPOT_SIZE = 4 * 1024 * 1024;
+
+typedef struct {
+	void* buffers[MAX_CACHED_BUFFERS];	// Free buffers, used as a stack
+	size_t count;												// Number of entries in buffers
+} CachedClass;
+
+typedef struct {
+	CachedClass classes[MAX_SIZE_CLASSES];	// Free buffers per size class
+	int is_registered;											// Non-zero once flushed at exit
+} BufferCache;
+
+typedef struct {
+	void* head;		 // Free buffers, linked through their first bytes
+	size_t count;	 // Number of buffers in the list
+} DepotClass;
+
+static __thread BufferCache cache;
+
+static DepotClass depot[MAX_SIZE_CLASSES];
+static pthread_mutex_t depot_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+static int GetSizeClass(size_t size) {
+	size_t class_size = BUFFER_SIZE;
+
+	for (int size_class = 0; size_class < MAX_SIZE_CLASSES; size_class++) {
+		if (class_size > MAX_REQUEST_SIZE) {
+			break;
+		}
+		if (size <= class_size) {
+			return size_class;
+		}
+		class_size *= 2;
+	}
+
+	return -1;
+}
+
+static size_t GetClassSize(int size_class) {
+	return BUFFER_SIZE << size_class;
+}
+
+static size_t GetCacheLimit(int size_class) {
+	size_t limit = THREAD_CACHE_SIZE / GetClassSize(size_class);
+	if (limit < 1) {
+		limit = 1;
+	}
+	if (limit > MAX_CACHED_BUFFERS) {
+		limit = MAX_CACHED_BUFFERS;
+	}
+
+	return limit;
+}
+
+static size_t GetDepotLimit(int size_class) {
+	size_t limit = DEPOT_SIZE / GetClassSize(size_class);
+	return (limit < 1) ? 1 : limit;
+}
+
+// Moves count buffers from the end of a thread cache to the depot. Buffers
+// the depot has no room for are freed.
+static void DrainCache(BufferCache* buffer_cache,
+											 int size_class,
+											 size_t count) {
+	CachedClass* cached = &buffer_cache->classes[size_class];
+	DepotClass* shared = &depot[size_class];
+	size_t limit = GetDepotLimit(size_class);
+
+	if (pthread_mutex_lock(&depot_lock) != 0) {
+		perror("Error: In DrainCache(): pthread_mutex_lock() failed");
+		return;
+	}
+
+	while (count > 0 && shared->count < limit) {
+		void* buffer = cached->buffers[--cached->count];
+		*(void**)buffer = shared->head;
+		shared->head = buffer;
+		shared->count++;
+		count--;
+	}
+
+	if (pthread_mutex_unlock(&depot_lock) != 0) {
+		perror("Error: In DrainCache(): pthread_mutex_unlock() failed");
+	}
+
+	while (count > 0) {
+		free(cached->buffers[--cached->count]);
+		count--;
+	}
+}
+
+static void RefillCache(int size_class) {
+	CachedClass* cached = &cache.classes[size_class];
+	DepotClass* shared = &depot[size_class];
+	size_t count = GetCacheLimit(size_class) / 2 + 1;
+
+	if (pthread_mutex_lock(&depot_lock) != 0) {
+		perror("Error: In RefillCache(): pthread_mutex_lock() failed");
+		return;
+	}
+
+	while (count > 0 && shared->head != NULL) {
+		void* buffer = shared->head;
+		shared->head = *(void**)buffer;
+		shared->count--;
+		cached->buffers[cached->count++] = buffer;
+		count--;
+	}
+
+	if (pthread_mutex_unlock(&depot_lock) != 0) {
+		perror("Error: In RefillCache(): pthread_mutex_unlock() failed");
+	}
+}
+
+static void FlushCache(void* arg) {
+	BufferCache* buffer_cache = (BufferCache*)arg;
+
+	for (int size_class = 0; size_class < MAX_SIZE_CLASSES; size_class++) {
+		DrainCache(buffer_cache,
+							 size_class,
+							 buffer_cache->classes[size_class].count);
+	}
+}
+
+static void CreateCacheKey() {
+	if (pthread_key_create(&cache_key, FlushCache) != 0) {
+		perror("Error: In CreateCacheKey(): pthread_key_create() failed");
+	}
+}
+
+// Makes sure the cache of the calling thread is handed to the depot when the
+// thread exits.
+static void RegisterCache() {
+	if (cache.is_registered) {
+		return;
+	}
+
+	cache.is_registered = 1;
+
+	if (pthread_once(&cache_key_once, CreateCacheKey) != 0 ||
+			pthread_setspecific(cache_key, &cache) != 0) {
+		perror("Error: In RegisterCache(): pthread_setspecific() failed");
+	}
+}
+
+void* AllocatePooledBuffer(size_t size, size_t* capacity) {
+	int size_class = GetSizeClass(size);
+	if (size_class < 0) {
+		void* buffer = malloc(size);
+		if (buffer == NULL) {
+			perror("Error: In AllocatePooledBuffer(): malloc() failed");
+			return NULL;
+		}
+
+		*capacity = size;
+		return buffer;
+	}
+
+	RegisterCache();
+
+	CachedClass* cached = &cache.classes[size_class];
+	if (cached->count == 0) {
+		RefillCache(size_class);
+	}
+
+	void* buffer = NULL;
+	if (cached->count > 0) {
+		buffer = cached->buffers[--cached->count];
+	} else {
+		buffer = malloc(GetClassSize(size_class));
+		if (buffer == NULL) {
+			perror("Error: In AllocatePooledBuffer(): malloc() failed");
+			return NULL;
+		}
+	}
+
+	*capacity = GetClassSize(size_class);
+	return buffer;
+}
+
+void* ResizePooledBuffer(void* buffer,
+												 size_t length,
+												 size_t* capacity,
+												 size_t size) {
+	if (buffer != NULL && size <= *capacity) {
+		return buffer;
+	}
+
+	size_t resized_capacity = 0;
+	void* resized = AllocatePooledBuffer(size, &resized_capacity);
+	if (resized == NULL) {
+		return NULL;
+	}
+
+	if (buffer != NULL) {
+		memcpy(resized, buffer, length);
+		FreePooledBuffer(buffer, *capacity);
+	}
+
+	*capacity = resized_capacity;
+	return resized;
+}
+
+void FreePooledBuffer(void* buffer, size_t capacity) {
+	if (buffer == NULL) {
+		return;
+	}
+
+	int size_class = GetSizeClass(capacity);
+	if (size_class < 0 || GetClassSize(size_class) != capacity) {
+		free(buffer);
+		return;
+	}
+
+	RegisterCache();
+
+	// A full cache keeps half of its buffers, so that a thread alternating
+	// between allocating and freeing does not hit the depot every time.
+	CachedClass* cached = &cache.classes[size_class];
+	size_t limit = GetCacheLimit(size_class);
+	if (cached->count >= limit) {
+		DrainCache(&cache, size_class, cached->count - limit / 2);
+	}
+
+	cached->buffers[cached->count++] = buffer;
+}
+
+void CleanupBufferPool() {
+	FlushCache(&cache);
+
+	if (pthread_mutex_lock(&depot_lock) != 0) {
+		perror("Error: In CleanupBufferPool(): pthread_mutex_lock() failed");
+		return;
+	}
+
+	for (int size_class = 0; size_class < MAX_SIZE_CLASSES; size_class++) {
+		while (depot[size_class].head != NULL) {
+			void* buffer = depot[size_class].head;
+			depot[size_class].head = *(void**)buffer;
+			free(buffer);
+		}
+		depot[size_class].count = 0;
+	}
+
+	if (pthread_mutex_unlock(&depot_lock) != 0) {
+		perror("Error: In CleanupBufferPool(): pthread_mutex_unlock() failed");
+	}
+}
+
+// src/buffer_pool.c
\ No newline at end of file
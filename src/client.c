@@ -12,6 +12,7 @@
 #include <unistd.h>
 
 #include "common.h"
+#include "scan.h"
 #include "terminal.h"
 
 const int MAX_SERVER_IP_LENGTH = 32;
@@ -114,6 +115,7 @@ void InitClient() {
 	(void)memset(name, 0, MAX_NAME_LENGTH);
 
 	InitTerminalConfig();
+	(void)InitScanner();
 
 	struct sigaction sa;
 	sa.sa_flags = 0;
@@ -5,14 +5,26 @@
 #include <string.h>
 
 const size_t PORT = 8080;
-const size_t MAX_PENDING_CONNECTIONS = 10;
+const size_t MAX_PENDING_CONNECTIONS = 4096;
 const size_t BUFFER_SIZE = 4096;
+const size_t MAX_REQUEST_SIZE = 1024 * 1024;
+const size_t MAX_CONNECTIONS = 10000;
+const size_t MAX_EVENTS = 64;
+const size_t KEEP_ALIVE_TIMEOUT = 5;
+const size_t MAX_KEEP_ALIVE_REQUESTS = 100;
+const size_t MAX_PIPELINED_REQUESTS = 64;
+const size_t MAX_QUEUE_WAIT = 2000;
+const size_t THREAD_POOL_CHECK_INTERVAL = 100;
 
 volatile sig_atomic_t is_server_running = 0;
 
 const size_t HTTP_INVALID_METHOD = 405;
 const size_t HTTP_BAD_REQUEST = 400;
 const size_t HTTP_NOT_FOUND = 404;
+const size_t HTTP_PAYLOAD_TOO_LARGE = 413;
+const size_t HTTP_INTERNAL_ERROR = 500;
+const size_t HTTP_NOT_IMPLEMENTED = 501;
+const size_t HTTP_VERSION_NOT_SUPPORTED = 505;
 const size_t HTTP_OK = 200;
 
 // src/common.c
\ No newline at end of file
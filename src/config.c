@@ -0,0 +1,282 @@
+#include "config.h"
+
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cpu.h"
+
+ServerConfig server_config = {
+		.num_acceptors = 1,
+		.backend = IO_BACKEND_EPOLL,
+		.num_threads = 0,
+		.max_threads = 0,
+		.cooldown = 30,
+		.num_db_threads = -1,
+		.pin_threads = 0,
+		.write_batch_size = 64,
+		.write_window = 0,
+		.database =
+				{
+						.mmap_size = 256LL * 1024 * 1024,
+						.cache_size = 8 * 1024,
+						.synchronous = 2,
+						.checkpoint_pages = 1000,
+						.record_cache_size = 64 * 1024 * 1024,
+				},
+};
+
+// Limits of --batch-size and --batch-window (in microseconds).
+static const long long MAX_WRITE_BATCH_SIZE = 4096;
+static const long long MAX_WRITE_WINDOW = 1000000;
+
+// Values of PRAGMA synchronous, indexed by level.
+static const char* const SYNCHRONOUS_NAMES[] = {
+		"off", "normal", "full", "extra"};
+
+static void PrintUsage(const char* program) {
+	(void)printf(
+			"Usage: %s [options]\n"
+			"  -a, --acceptors N   Open N SO_REUSEPORT listeners, each with its own\n"
+			"                      reactor and worker group (0 = one per usable CPU)\n"
+			"  -b, --backend NAME  I/O backend: epoll (default) or io_uring\n"
+			"  -t, --threads N     Minimum number of Workers (0 = one per usable\n"
+			"                      CPU, the default)\n"
+			"  -T, --max-threads N Number of Workers the pool may grow to under\n"
+			"                      load (0 = twice the minimum, the default)\n"
+			"  -c, --cooldown S    Idle seconds before Workers above the minimum\n"
+			"                      retire (default 30)\n"
+			"  -d, --db-threads N  Threads running database operations (default one\n"
+			"                      per usable CPU, 0 = run them on the Workers)\n"
+			"  -B, --batch-size N  Most writes committed in one transaction, up to\n"
+			"                      4096 (default 64, 1 = commit every write alone)\n"
+			"  -W, --batch-window US\n"
+			"                      Microseconds to wait for more writes before\n"
+			"                      committing, up to 1000000 (default 0)\n"
+			"  -m, --db-mmap BYTES Bytes of the database file each connection reads\n"
+			"                      through mmap (default 268435456, 0 = none)\n"
+			"  -k, --db-cache KIB  KiB of page cache per database connection\n"
+			"                      (default 8192)\n"
+			"  -s, --db-sync MODE  Durability of commits: off, normal, full\n"
+			"                      (default) or extra. normal is faster but may\n"
+			"                      lose acknowledged writes on a power failure\n"
+			"  -w, --db-checkpoint N\n"
+			"                      Checkpoint the write-ahead log once it holds N\n"
+			"                      pages (default 1000, 0 = never)\n"
+			"  -r, --record-cache BYTES\n"
+			"                      Bytes of records cached in memory in front of\n"
+			"                      the database (default 67108864, 0 = none)\n"
+			"  -p, --pin           Pin Workers and event loops to CPUs, grouped by\n"
+			"                      NUMA node\n"
+			"  -h, --help          Show this message\n",
+			program);
+}
+
+static int ParseCount(const char* value, int* out) {
+	char* end = NULL;
+	long count = strtol(value, &end, 10);
+
+	if (end == value || *end != '\0' || count < 0 || count > 1024) {
+		return -1;
+	}
+
+	*out = (int)count;
+	return 0;
+}
+
+static int ParseSize(const char* value, long long limit, long long* out) {
+	char* end = NULL;
+	long long size = strtoll(value, &end, 10);
+
+	if (end == value || *end != '\0' || size < 0 || size > limit) {
+		return -1;
+	}
+
+	*out = size;
+	return 0;
+}
+
+static int ParseSynchronous(const char* value, int* out) {
+	int count = (int)(sizeof(SYNCHRONOUS_NAMES) / sizeof(SYNCHRONOUS_NAMES[0]));
+
+	for (int level = 0; level < count; level++) {
+		if (strcmp(value, SYNCHRONOUS_NAMES[level]) == 0) {
+			*out = level;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+void ParseServerConfig(int argc, char* argv[]) {
+	static const struct option options[] = {
+			{"acceptors", required_argument, NULL, 'a'},
+			{"backend", required_argument, NULL, 'b'},
+			{"threads", required_argument, NULL, 't'},
+			{"max-threads", required_argument, NULL, 'T'},
+			{"cooldown", required_argument, NULL, 'c'},
+			{"db-threads", required_argument, NULL, 'd'},
+			{"batch-size", required_argument, NULL, 'B'},
+			{"batch-window", required_argument, NULL, 'W'},
+			{"db-mmap", required_argument, NULL, 'm'},
+			{"db-cache", required_argument, NULL, 'k'},
+			{"db-sync", required_argument, NULL, 's'},
+			{"db-checkpoint", required_argument, NULL, 'w'},
+			{"record-cache", required_argument, NULL, 'r'},
+			{"pin", no_argument, NULL, 'p'},
+			{"help", no_argument, NULL, 'h'},
+			{NULL, 0, NULL, 0},
+	};
+
+	long long size = 0;
+	int option = 0;
+	while ((option = getopt_long(argc,
+															 argv,
+															 "a:b:t:T:c:d:B:W:m:k:s:w:r:ph",
+															 options,
+															 NULL)) != -1) {
+		switch (option) {
+			case 'a':
+				if (ParseCount(optarg, &server_config.num_acceptors) < 0) {
+					(void)printf("Invalid acceptor count: %s\n", optarg);
+					PrintUsage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'b':
+				if (strcmp(optarg, "epoll") == 0) {
+					server_config.backend = IO_BACKEND_EPOLL;
+				} else if (strcmp(optarg, "io_uring") == 0) {
+					server_config.backend = IO_BACKEND_IO_URING;
+				} else {
+					(void)printf("Invalid backend: %s\n", optarg);
+					PrintUsage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 't':
+				if (ParseCount(optarg, &server_config.num_threads) < 0) {
+					(void)printf("Invalid thread count: %s\n", optarg);
+					PrintUsage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'T':
+				if (ParseCount(optarg, &server_config.max_threads) < 0) {
+					(void)printf("Invalid thread count: %s\n", optarg);
+					PrintUsage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'c':
+				if (ParseCount(optarg, &server_config.cooldown) < 0) {
+					(void)printf("Invalid cooldown: %s\n", optarg);
+					PrintUsage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'd':
+				if (ParseCount(optarg, &server_config.num_db_threads) < 0) {
+					(void)printf("Invalid thread count: %s\n", optarg);
+					PrintUsage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'B':
+				if (ParseSize(optarg, MAX_WRITE_BATCH_SIZE, &size) < 0 || size == 0) {
+					(void)printf("Invalid batch size: %s\n", optarg);
+					PrintUsage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				server_config.write_batch_size = (int)size;
+				break;
+			case 'W':
+				if (ParseSize(optarg, MAX_WRITE_WINDOW, &size) < 0) {
+					(void)printf("Invalid batch window: %s\n", optarg);
+					PrintUsage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				server_config.write_window = (int)size;
+				break;
+			case 'm':
+				if (ParseSize(optarg, LLONG_MAX, &server_config.database.mmap_size) <
+						0) {
+					(void)printf("Invalid mmap size: %s\n", optarg);
+					PrintUsage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'k':
+				if (ParseSize(optarg, INT_MAX, &size) < 0) {
+					(void)printf("Invalid cache size: %s\n", optarg);
+					PrintUsage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				server_config.database.cache_size = (int)size;
+				break;
+			case 's':
+				if (ParseSynchronous(optarg, &server_config.database.synchronous) <
+						0) {
+					(void)printf("Invalid synchronous mode: %s\n", optarg);
+					PrintUsage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'w':
+				if (ParseSize(optarg, INT_MAX, &size) < 0) {
+					(void)printf("Invalid checkpoint threshold: %s\n", optarg);
+					PrintUsage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				server_config.database.checkpoint_pages = (int)size;
+				break;
+			case 'r':
+				if (ParseSize(optarg, LLONG_MAX, &size) < 0) {
+					(void)printf("Invalid record cache size: %s\n", optarg);
+					PrintUsage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				server_config.database.record_cache_size = (size_t)size;
+				break;
+			case 'p':
+				server_config.pin_threads = 1;
+				break;
+			case 'h':
+				PrintUsage(argv[0]);
+				exit(EXIT_SUCCESS);
+			default:
+				PrintUsage(argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	if (server_config.num_acceptors == 0) {
+		server_config.num_acceptors = GetUsableCPUCount();
+	}
+
+	if (server_config.num_threads == 0) {
+		server_config.num_threads = GetUsableCPUCount();
+	}
+
+	if (server_config.num_db_threads < 0) {
+		server_config.num_db_threads = GetUsableCPUCount();
+	}
+
+	if (server_config.max_threads == 0) {
+		server_config.max_threads = 2 * server_config.num_threads;
+	}
+
+	if (server_config.max_threads < server_config.num_threads) {
+		(void)printf("Maximum thread count %d is below the minimum %d\n",
+								 server_config.max_threads,
+								 server_config.num_threads);
+		PrintUsage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+}
+
+// src/config.c
@@ -0,0 +1,736 @@
+#include "connection.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "buffer_pool.h"
+#include "common.h"
+#include "scan.h"
+
+static const char CONTINUE_RESPONSE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+
+static void ResetRequest(Connection* connection) {
+	connection->state = REQUEST_HEADERS;
+	connection->scan = connection->offset;
+	connection->header_length = 0;
+	connection->body_length = 0;
+	connection->chunk_remaining = 0;
+	connection->request_length = 0;
+	connection->expects_continue = 0;
+}
+
+static int AllocateBuffer(Connection* connection) {
+	if (connection->buffer != NULL) {
+		return 0;
+	}
+
+	connection->buffer =
+			(char*)AllocatePooledBuffer(BUFFER_SIZE, &connection->capacity);
+	if (connection->buffer == NULL) {
+		return -1;
+	}
+
+	connection->buffer[0] = '\0';
+	connection->length = 0;
+	connection->offset = 0;
+	ResetRequest(connection);
+
+	return 0;
+}
+
+static int GrowBuffer(Connection* connection, size_t needed) {
+	if (needed <= connection->capacity) {
+		return 0;
+	}
+
+	if (needed > MAX_REQUEST_SIZE) {
+		return -1;
+	}
+
+	size_t capacity = connection->capacity;
+	while (capacity < needed) {
+		capacity *= 2;
+	}
+	if (capacity > MAX_REQUEST_SIZE) {
+		capacity = MAX_REQUEST_SIZE;
+	}
+
+	char* buffer = (char*)ResizePooledBuffer(
+			connection->buffer, connection->length, &connection->capacity, capacity);
+	if (buffer == NULL) {
+		return -1;
+	}
+
+	connection->buffer = buffer;
+
+	return 0;
+}
+
+Connection* CreateConnection(int fd) {
+	Connection* connection = (Connection*)calloc(1, sizeof(Connection));
+	if (connection == NULL) {
+		perror("Error: In CreateConnection(): calloc() failed");
+		return NULL;
+	}
+
+	connection->fd = fd;
+	connection->worker = -1;
+
+	return connection;
+}
+
+int ReadConnection(Connection* connection) {
+	if (AllocateBuffer(connection) < 0) {
+		return -1;
+	}
+
+	for (;;) {
+		if (connection->length + 1 >= connection->capacity &&
+				GrowBuffer(connection, connection->length + 2) < 0) {
+			break;
+		}
+
+		ssize_t read_size = read(connection->fd,
+														 connection->buffer + connection->length,
+														 connection->capacity - connection->length - 1);
+
+		if (read_size < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			perror("Error: In ReadConnection(): read() failed");
+			return -1;
+		}
+
+		if (read_size == 0) {
+			connection->buffer[connection->length] = '\0';
+			return 0;
+		}
+
+		connection->length += (size_t)read_size;
+	}
+
+	connection->buffer[connection->length] = '\0';
+	return 1;
+}
+
+int AppendConnection(Connection* connection, const char* data, size_t length) {
+	if (AllocateBuffer(connection) < 0) {
+		return -1;
+	}
+
+	size_t needed = connection->length + length + 1;
+	if (GrowBuffer(connection, needed) < 0) {
+		if (GrowBuffer(connection, MAX_REQUEST_SIZE) < 0) {
+			return -1;
+		}
+	}
+
+	size_t space = connection->capacity - connection->length - 1;
+	if (length > space) {
+		length = space;
+	}
+
+	memcpy(connection->buffer + connection->length, data, length);
+	connection->length += length;
+	connection->buffer[connection->length] = '\0';
+
+	return 0;
+}
+
+/**
+ * Looks up a header in the header block of the request at offset. Returns a
+ * pointer to its value with leading whitespace skipped, or NULL if absent.
+ */
+static const char* FindHeader(const Connection* connection,
+															const char* name,
+															size_t* value_length) {
+	const char* line = connection->buffer + connection->offset;
+	const char* end = line + connection->header_length;
+	size_t name_length = strlen(name);
+
+	// The first line is the request line, not a header.
+	while ((line = FindSequence(line, (size_t)(end - line), "\r\n", 2)) !=
+				 NULL) {
+		line += 2;
+		if ((size_t)(end - line) <= name_length ||
+				strncasecmp(line, name, name_length) != 0 ||
+				line[name_length] != ':') {
+			continue;
+		}
+
+		const char* value = line + name_length + 1;
+		while (*value == ' ' || *value == '\t') {
+			value++;
+		}
+
+		const char* value_end =
+				FindSequence(value, (size_t)(end - value), "\r\n", 2);
+		*value_length = (size_t)(value_end - value);
+		return value;
+	}
+
+	return NULL;
+}
+
+/*
+ * Splits the next element off a comma-separated header value and trims the
+ * whitespace around it. Empty elements are skipped. Returns 0 once the value
+ * is used up.
+ */
+static int NextToken(const char** value,
+										 const char* end,
+										 const char** token,
+										 size_t* token_length) {
+	const char* start = *value;
+
+	while (start < end) {
+		const char* comma = memchr(start, ',', (size_t)(end - start));
+		const char* stop = (comma != NULL) ? comma : end;
+		*value = (comma != NULL) ? comma + 1 : end;
+
+		while (start < stop && (*start == ' ' || *start == '\t')) {
+			start++;
+		}
+		while (stop > start && (stop[-1] == ' ' || stop[-1] == '\t')) {
+			stop--;
+		}
+
+		if (stop > start) {
+			*token = start;
+			*token_length = (size_t)(stop - start);
+			return 1;
+		}
+
+		start = *value;
+	}
+
+	return 0;
+}
+
+static int IsToken(const char* token, size_t token_length, const char* name) {
+	return token_length == strlen(name) &&
+				 strncasecmp(token, name, token_length) == 0;
+}
+
+static int HasToken(const char* value, size_t value_length, const char* name) {
+	const char* end = value + value_length;
+	const char* token = NULL;
+	size_t token_length = 0;
+
+	while (NextToken(&value, end, &token, &token_length)) {
+		if (IsToken(token, token_length, name)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Picks the reader state for a request with a Transfer-Encoding. Only a body
+ * that is just chunked can be framed, so any other coding is not implemented.
+ */
+static RequestState ReadTransferCoding(const char* value, size_t value_length) {
+	const char* end = value + value_length;
+	const char* token = NULL;
+	size_t token_length = 0;
+	size_t num_codings = 0;
+	int is_chunked = 0;
+
+	while (NextToken(&value, end, &token, &token_length)) {
+		num_codings++;
+		is_chunked = IsToken(token, token_length, "chunked");
+	}
+
+	if (num_codings == 0) {
+		return REQUEST_INVALID;
+	}
+
+	return (num_codings == 1 && is_chunked) ? REQUEST_CHUNK_SIZE
+																					: REQUEST_UNSUPPORTED;
+}
+
+static void ParseHeaders(Connection* connection) {
+	size_t value_length = 0;
+
+	const char* expect = FindHeader(connection, "Expect", &value_length);
+	connection->expects_continue =
+			expect != NULL && HasToken(expect, value_length, "100-continue");
+
+	const char* transfer_encoding =
+			FindHeader(connection, "Transfer-Encoding", &value_length);
+	if (transfer_encoding != NULL) {
+		connection->state = ReadTransferCoding(transfer_encoding, value_length);
+		return;
+	}
+
+	const char* content_length =
+			FindHeader(connection, "Content-Length", &value_length);
+	if (content_length == NULL) {
+		connection->state = REQUEST_BODY;
+		return;
+	}
+
+	// The value is one or more digits, with nothing but whitespace after them.
+	size_t body_length = 0;
+	size_t i = 0;
+	while (i < value_length && content_length[i] >= '0' &&
+				 content_length[i] <= '9') {
+		// Lengths beyond MAX_REQUEST_SIZE only need to stay beyond it.
+		if (body_length <= MAX_REQUEST_SIZE) {
+			body_length = body_length * 10 + (size_t)(content_length[i] - '0');
+		}
+		i++;
+	}
+
+	size_t num_digits = i;
+	while (i < value_length &&
+				 (content_length[i] == ' ' || content_length[i] == '\t')) {
+		i++;
+	}
+
+	if (num_digits == 0 || i < value_length) {
+		connection->state = REQUEST_INVALID;
+		return;
+	}
+
+	if (connection->header_length + body_length >= MAX_REQUEST_SIZE) {
+		connection->state = REQUEST_TOO_LARGE;
+		return;
+	}
+
+	connection->body_length = body_length;
+	connection->state = REQUEST_BODY;
+}
+
+static void ReadHeaders(Connection* connection) {
+	// The terminator may straddle the bytes scanned by the previous call.
+	size_t start = connection->scan;
+	if (start >= connection->offset + 3) {
+		start -= 3;
+	} else {
+		start = connection->offset;
+	}
+
+	const char* header_end = FindSequence(
+			connection->buffer + start, connection->length - start, "\r\n\r\n", 4);
+	if (header_end == NULL) {
+		connection->scan = connection->length;
+		return;
+	}
+
+	connection->header_length =
+			(size_t)(header_end - connection->buffer) + 4 - connection->offset;
+	connection->scan = connection->offset + connection->header_length;
+
+	ParseHeaders(connection);
+}
+
+static void ReadBody(Connection* connection) {
+	size_t available = connection->length - connection->scan;
+	if (available < connection->body_length) {
+		return;
+	}
+
+	connection->request_length =
+			connection->header_length + connection->body_length;
+	connection->state = REQUEST_COMPLETE;
+}
+
+static void ReadChunkSize(Connection* connection) {
+	const char* line = connection->buffer + connection->scan;
+	const char* line_end =
+			FindSequence(line, connection->length - connection->scan, "\r\n", 2);
+	if (line_end == NULL) {
+		return;
+	}
+
+	size_t chunk_size = 0;
+	const char* digit = line;
+	for (; digit < line_end; digit++) {
+		int value = 0;
+		if (*digit >= '0' && *digit <= '9') {
+			value = *digit - '0';
+		} else if (*digit >= 'a' && *digit <= 'f') {
+			value = *digit - 'a' + 10;
+		} else if (*digit >= 'A' && *digit <= 'F') {
+			value = *digit - 'A' + 10;
+		} else {
+			break;
+		}
+
+		chunk_size = chunk_size * 16 + (size_t)value;
+		if (chunk_size >= MAX_REQUEST_SIZE) {
+			connection->state = REQUEST_TOO_LARGE;
+			return;
+		}
+	}
+
+	// Chunk extensions after ';' are ignored.
+	if (digit == line || (digit < line_end && *digit != ';' && *digit != ' ')) {
+		connection->state = REQUEST_INVALID;
+		return;
+	}
+
+	if (connection->header_length + connection->body_length + chunk_size >=
+			MAX_REQUEST_SIZE) {
+		connection->state = REQUEST_TOO_LARGE;
+		return;
+	}
+
+	connection->scan = (size_t)(line_end - connection->buffer) + 2;
+	connection->chunk_remaining = chunk_size;
+	connection->state =
+			(chunk_size == 0) ? REQUEST_TRAILERS : REQUEST_CHUNK_DATA;
+}
+
+static void ReadChunkData(Connection* connection) {
+	size_t available = connection->length - connection->scan;
+	size_t count = connection->chunk_remaining;
+	if (count > available) {
+		count = available;
+	}
+
+	// Chunk data is decoded in place, directly behind the headers and the
+	// data of the previous chunks. The destination never overtakes scan.
+	char* body_end = connection->buffer + connection->offset +
+									 connection->header_length + connection->body_length;
+	memmove(body_end, connection->buffer + connection->scan, count);
+
+	connection->body_length += count;
+	connection->scan += count;
+	connection->chunk_remaining -= count;
+
+	if (connection->chunk_remaining > 0 ||
+			connection->length - connection->scan < 2) {
+		return;
+	}
+
+	if (memcmp(connection->buffer + connection->scan, "\r\n", 2) != 0) {
+		connection->state = REQUEST_INVALID;
+		return;
+	}
+
+	connection->scan += 2;
+	connection->state = REQUEST_CHUNK_SIZE;
+}
+
+static void ReadTrailers(Connection* connection) {
+	for (;;) {
+		const char* line = connection->buffer + connection->scan;
+		const char* line_end =
+				FindSequence(line, connection->length - connection->scan, "\r\n", 2);
+		if (line_end == NULL) {
+			return;
+		}
+
+		connection->scan = (size_t)(line_end - connection->buffer) + 2;
+
+		if (line_end == line) {
+			connection->request_length = connection->scan - connection->offset;
+			connection->state = REQUEST_COMPLETE;
+			return;
+		}
+	}
+}
+
+static void SendContinue(Connection* connection) {
+	if (!connection->expects_continue || connection->num_segments > 0) {
+		return;
+	}
+
+	connection->expects_continue = 0;
+
+	if (send(connection->fd,
+					 CONTINUE_RESPONSE,
+					 sizeof(CONTINUE_RESPONSE) - 1,
+					 MSG_NOSIGNAL | MSG_DONTWAIT) < 0) {
+		perror("Error: In SendContinue(): send() failed");
+	}
+}
+
+int IsRequestComplete(Connection* connection) {
+	if (connection->buffer == NULL) {
+		return 0;
+	}
+
+	for (;;) {
+		RequestState state = connection->state;
+		size_t scan = connection->scan;
+
+		switch (state) {
+			case REQUEST_HEADERS:
+				ReadHeaders(connection);
+				break;
+			case REQUEST_BODY:
+				ReadBody(connection);
+				break;
+			case REQUEST_CHUNK_SIZE:
+				ReadChunkSize(connection);
+				break;
+			case REQUEST_CHUNK_DATA:
+				ReadChunkData(connection);
+				break;
+			case REQUEST_TRAILERS:
+				ReadTrailers(connection);
+				break;
+			case REQUEST_COMPLETE:
+			case REQUEST_INVALID:
+			case REQUEST_TOO_LARGE:
+			case REQUEST_UNSUPPORTED:
+				connection->expects_continue = 0;
+				return 1;
+		}
+
+		if (connection->state == state && connection->scan == scan) {
+			break;
+		}
+	}
+
+	// A full buffer can not take the rest of the request. Buffers only hold
+	// bytes before offset while a Worker owns the connection, and those are
+	// dropped before more data is read.
+	if (connection->offset == 0 && connection->length + 1 >= MAX_REQUEST_SIZE) {
+		connection->state = REQUEST_TOO_LARGE;
+		return 1;
+	}
+
+	if (connection->state != REQUEST_HEADERS) {
+		SendContinue(connection);
+	}
+
+	return 0;
+}
+
+void ConsumeRequest(Connection* connection) {
+	connection->offset += connection->request_length;
+	if (connection->state != REQUEST_COMPLETE ||
+			connection->offset > connection->length) {
+		connection->offset = connection->length;
+	}
+
+	ResetRequest(connection);
+}
+
+char* ReserveOutput(Connection* connection, size_t length) {
+	size_t needed = connection->output_length + length + 1;
+
+	if (needed > connection->output_capacity) {
+		size_t capacity = connection->output_capacity;
+		if (capacity < BUFFER_SIZE) {
+			capacity = BUFFER_SIZE;
+		}
+		while (capacity < needed) {
+			capacity *= 2;
+		}
+
+		char* output = (char*)ResizePooledBuffer(connection->output,
+																						 connection->output_length,
+																						 &connection->output_capacity,
+																						 capacity);
+		if (output == NULL) {
+			return NULL;
+		}
+
+		connection->output = output;
+	}
+
+	return connection->output + connection->output_length;
+}
+
+static int AddSegment(Connection* connection,
+											const char* data,
+											size_t length,
+											int is_owned) {
+	if (connection->num_segments == connection->segments_capacity) {
+		size_t capacity = connection->segments_capacity * 2;
+		if (capacity == 0) {
+			capacity = 8;
+		}
+
+		// The old array stays in the arena until the batch has been sent.
+		OutputSegment* segments = (OutputSegment*)ArenaAllocate(
+				&connection->arena, capacity * sizeof(OutputSegment));
+		if (segments == NULL) {
+			(void)fprintf(stderr,
+										"Error: In AddSegment(): ArenaAllocate() failed\n");
+			return -1;
+		}
+
+		if (connection->num_segments > 0) {
+			memcpy(segments,
+						 connection->segments,
+						 connection->num_segments * sizeof(OutputSegment));
+		}
+
+		connection->segments = segments;
+		connection->segments_capacity = capacity;
+	}
+
+	OutputSegment* segment = &connection->segments[connection->num_segments++];
+	segment->data = data;
+	segment->length = length;
+	segment->is_owned = is_owned;
+
+	connection->pending_length += length;
+	return 0;
+}
+
+int CommitOutput(Connection* connection, size_t length) {
+	connection->output_length += length;
+
+	// Generated bytes following each other are sent as one segment.
+	if (connection->num_segments > 0) {
+		OutputSegment* last = &connection->segments[connection->num_segments - 1];
+		if (last->data == NULL) {
+			last->length += length;
+			connection->pending_length += length;
+			return 0;
+		}
+	}
+
+	return AddSegment(connection, NULL, length, 0);
+}
+
+int AppendOutput(Connection* connection,
+								 const char* data,
+								 size_t length,
+								 int is_owned) {
+	if (AddSegment(connection, data, length, is_owned) < 0) {
+		if (is_owned) {
+			free((char*)data);
+		}
+		return -1;
+	}
+
+	return 0;
+}
+
+int BuildOutputVector(Connection* connection) {
+	if (connection->pending_length == 0) {
+		return 0;
+	}
+
+	// A send that would block is resumed with a new vector, so the old one is
+	// reused while it is large enough.
+	if (connection->iov_capacity < connection->num_segments) {
+		struct iovec* iov = (struct iovec*)ArenaAllocate(
+				&connection->arena,
+				connection->segments_capacity * sizeof(struct iovec));
+		if (iov == NULL) {
+			(void)fprintf(stderr,
+										"Error: In BuildOutputVector(): ArenaAllocate() failed\n");
+			return -1;
+		}
+		connection->iov = iov;
+		connection->iov_capacity = connection->segments_capacity;
+	}
+
+	// Generated bytes are only placed once the output buffer stops moving.
+	char* generated = connection->output;
+	size_t skipped = connection->sent_length;
+	int count = 0;
+
+	for (size_t i = 0; i < connection->num_segments; i++) {
+		OutputSegment* segment = &connection->segments[i];
+
+		char* data = (char*)segment->data;
+		if (data == NULL) {
+			data = generated;
+			generated += segment->length;
+		}
+
+		if (skipped >= segment->length) {
+			skipped -= segment->length;
+			continue;
+		}
+
+		connection->iov[count].iov_base = data + skipped;
+		connection->iov[count].iov_len = segment->length - skipped;
+		skipped = 0;
+		count++;
+	}
+
+	return count;
+}
+
+void ConsumeOutput(Connection* connection, size_t length) {
+	connection->sent_length += length;
+	connection->pending_length -= length;
+}
+
+void DiscardOutput(Connection* connection) {
+	for (size_t i = 0; i < connection->num_segments; i++) {
+		if (connection->segments[i].is_owned) {
+			free((char*)connection->segments[i].data);
+		}
+	}
+
+	// The segment and vector arrays and the output buffer are kept for the next
+	// bytes.
+	connection->num_segments = 0;
+	connection->pending_length = 0;
+	connection->sent_length = 0;
+	connection->output_length = 0;
+}
+
+static void ReleaseOutput(Connection* connection) {
+	DiscardOutput(connection);
+
+	connection->segments = NULL;
+	connection->segments_capacity = 0;
+	connection->iov = NULL;
+	connection->iov_capacity = 0;
+
+	FreePooledBuffer(connection->output, connection->output_capacity);
+	connection->output = NULL;
+	connection->output_length = 0;
+	connection->output_capacity = 0;
+
+	// Everything the batch allocated has been sent or dropped by now.
+	ResetArena(&connection->arena);
+}
+
+void ResetConnection(Connection* connection) {
+	ReleaseOutput(connection);
+
+	if (connection->offset < connection->length) {
+		memmove(connection->buffer,
+						connection->buffer + connection->offset,
+						connection->length - connection->offset);
+		connection->length -= connection->offset;
+		connection->scan -= connection->offset;
+		connection->offset = 0;
+		connection->buffer[connection->length] = '\0';
+		return;
+	}
+
+	FreePooledBuffer(connection->buffer, connection->capacity);
+	connection->buffer = NULL;
+	connection->length = 0;
+	connection->capacity = 0;
+	connection->offset = 0;
+	ResetRequest(connection);
+}
+
+void FreeConnection(Connection* connection) {
+	if (connection == NULL) {
+		return;
+	}
+
+	ClearDatabaseOperation(&connection->operation);
+	FreePooledBuffer(connection->buffer, connection->capacity);
+	ReleaseOutput(connection);
+	free(connection);
+}
+
+// src/connection.c
@@ -0,0 +1,187 @@
+#include "cpu.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int ReadCgroupV2Quota(double* quota) {
+	char path[512] = "/";
+
+	FILE* file = fopen("/proc/self/cgroup", "r");
+	if (file != NULL) {
+		char line[512];
+		while (fgets(line, sizeof(line), file) != NULL) {
+			if (strncmp(line, "0::", 3) == 0) {
+				line[strcspn(line, "\n")] = '\0';
+				(void)snprintf(path, sizeof(path), "%s", line + 3);
+				break;
+			}
+		}
+		(void)fclose(file);
+	}
+
+	char file_name[600];
+	(void)snprintf(
+			file_name, sizeof(file_name), "/sys/fs/cgroup%s/cpu.max", path);
+
+	file = fopen(file_name, "r");
+	if (file == NULL) {
+		file = fopen("/sys/fs/cgroup/cpu.max", "r");
+	}
+	if (file == NULL) {
+		return -1;
+	}
+
+	char max[32] = "";
+	long period = 0;
+	int matched = fscanf(file, "%31s %ld", max, &period);
+	(void)fclose(file);
+
+	if (matched != 2 || strcmp(max, "max") == 0 || period <= 0) {
+		return -1;
+	}
+
+	*quota = strtod(max, NULL) / (double)period;
+	return 0;
+}
+
+static long ReadLong(const char* file_name) {
+	FILE* file = fopen(file_name, "r");
+	if (file == NULL) {
+		return -1;
+	}
+
+	long value = -1;
+	if (fscanf(file, "%ld", &value) != 1) {
+		value = -1;
+	}
+	(void)fclose(file);
+
+	return value;
+}
+
+static int ReadCgroupV1Quota(double* quota) {
+	long quota_us = ReadLong("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+	long period_us = ReadLong("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+
+	if (quota_us <= 0 || period_us <= 0) {
+		return -1;
+	}
+
+	*quota = (double)quota_us / (double)period_us;
+	return 0;
+}
+
+static int GetNumaNode(int cpu) {
+	for (int node = 0; node < 64; node++) {
+		char file_name[128];
+		(void)snprintf(file_name,
+									 sizeof(file_name),
+									 "/sys/devices/system/cpu/cpu%d/node%d",
+									 cpu,
+									 node);
+		if (access(file_name, F_OK) == 0) {
+			return node;
+		}
+	}
+
+	return 0;
+}
+
+int GetUsableCPUCount() {
+	int count = 0;
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		count = CPU_COUNT(&set);
+	} else {
+		long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		count = (num_cpus > 0) ? (int)num_cpus : 1;
+	}
+
+	double quota = 0;
+	if (ReadCgroupV2Quota(&quota) == 0 || ReadCgroupV1Quota(&quota) == 0) {
+		// A fractional quota still lets one more thread run part of the time.
+		int limit = (int)quota;
+		if ((double)limit < quota) {
+			limit++;
+		}
+		if (limit < count) {
+			count = limit;
+		}
+	}
+
+	return (count > 0) ? count : 1;
+}
+
+int GetUsableCPUs(int* cpus, int max_cpus) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+		perror("Error: In GetUsableCPUs(): sched_getaffinity() failed");
+		return -1;
+	}
+
+	int nodes[CPU_SETSIZE];
+	int count = 0;
+
+	for (int cpu = 0; cpu < CPU_SETSIZE && count < max_cpus; cpu++) {
+		if (!CPU_ISSET(cpu, &set)) {
+			continue;
+		}
+
+		// Insertion sort by node keeps CPUs of a node in ascending order.
+		int node = GetNumaNode(cpu);
+		int i = count;
+		while (i > 0 && nodes[i - 1] > node) {
+			nodes[i] = nodes[i - 1];
+			cpus[i] = cpus[i - 1];
+			i--;
+		}
+		nodes[i] = node;
+		cpus[i] = cpu;
+		count++;
+	}
+
+	return count;
+}
+
+static void FillCPUSet(cpu_set_t* set, const int* cpus, int num_cpus) {
+	CPU_ZERO(set);
+	for (int i = 0; i < num_cpus; i++) {
+		CPU_SET(cpus[i], set);
+	}
+}
+
+int SetThreadAffinity(pthread_attr_t* attr, const int* cpus, int num_cpus) {
+	cpu_set_t set;
+	FillCPUSet(&set, cpus, num_cpus);
+
+	if (pthread_attr_setaffinity_np(attr, sizeof(set), &set) != 0) {
+		(void)fprintf(
+				stderr,
+				"Error: In SetThreadAffinity(): pthread_attr_setaffinity_np() failed\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int PinCurrentThread(const int* cpus, int num_cpus) {
+	cpu_set_t set;
+	FillCPUSet(&set, cpus, num_cpus);
+
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+		(void)fprintf(
+				stderr,
+				"Error: In PinCurrentThread(): pthread_setaffinity_np() failed\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+// src/cpu.c
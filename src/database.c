@@ -1,196 +1,655 @@
 #include "database.h"
 
+#include <pthread.h>
 #include <sqlite3.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "common.h"
+#include "record_cache.h"
 
 const char* database_file = "database.db";
 
-static sqlite3* database = NULL;
+/**
+ * @enum StatementID
+ * @brief The statements the database layer runs, each prepared once.
+ */
+typedef enum {
+	STATEMENT_GET,
+	STATEMENT_POST,
+	STATEMENT_DELETE,
+	STATEMENT_BEGIN,
+	STATEMENT_BEGIN_READ,
+	STATEMENT_COMMIT,
+	STATEMENT_ROLLBACK,
+	NUM_STATEMENTS,
+} StatementID;
+
+static const char* const STATEMENT_SQL[NUM_STATEMENTS] = {
+		[STATEMENT_GET] = "SELECT name FROM database WHERE roll_num = ?;",
+		[STATEMENT_POST] =
+				"INSERT OR REPLACE INTO database (roll_num, name) VALUES (?, ?);",
+		[STATEMENT_DELETE] = "DELETE FROM database WHERE roll_num = ?;",
+		// The write lock is taken up front, so that a batch never fails halfway
+		// because another connection started writing first.
+		[STATEMENT_BEGIN] = "BEGIN IMMEDIATE;",
+		// Reads alone take no lock, and see the snapshot of their first read.
+		[STATEMENT_BEGIN_READ] = "BEGIN DEFERRED;",
+		[STATEMENT_COMMIT] = "COMMIT;",
+		[STATEMENT_ROLLBACK] = "ROLLBACK;",
+};
+
+// Milliseconds a connection retries for while another one holds the write
+// lock, before the statement fails with SQLITE_BUSY.
+static const int BUSY_TIMEOUT = 5000;
+
+/**
+ * @struct DatabaseConnection
+ * @brief A connection to the database file, used by a single thread.
+ *
+ * Statements stay prepared for the lifetime of the connection and are reset
+ * after every use. As no other thread ever touches the connection, it is
+ * opened without SQLite's own mutex and nothing in it is locked.
+ */
+typedef struct {
+	sqlite3* handle;													 // The open connection
+	sqlite3_stmt* statements[NUM_STATEMENTS];	 // Prepared statements, by ID
+	uint64_t num_prepared;										 // Number of statements prepared
+	uint64_t num_reused;											 // Number of times one was reused
+} DatabaseConnection;
+
+static DatabaseSettings database_settings;
+
+static __thread DatabaseConnection* local_connection = NULL;
+
+static pthread_key_t connection_key;
+static pthread_once_t connection_key_once = PTHREAD_ONCE_INIT;
+
+// Counters of the connections that have been closed.
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t num_connections = 0;
+static uint64_t num_prepared = 0;
+static uint64_t num_reused = 0;
+
+static int ExecuteSQL(sqlite3* handle, const char* sql) {
+	char* error = NULL;
+	if (sqlite3_exec(handle, sql, 0, 0, &error) != SQLITE_OK) {
+		(void)fprintf(
+				stderr, "Error: In ExecuteSQL(): sqlite3_exec() failed: %s\n", error);
+		sqlite3_free(error);
+		return -1;
+	}
+
+	return 0;
+}
+
+// Opens a connection for the calling thread only and applies the settings,
+// which SQLite keeps per connection.
+static sqlite3* OpenHandle() {
+	sqlite3* handle = NULL;
+	if (sqlite3_open_v2(database_file,
+											&handle,
+											SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+													SQLITE_OPEN_NOMUTEX,
+											NULL) != SQLITE_OK) {
+		(void)fprintf(stderr,
+									"Error: In OpenHandle(): sqlite3_open_v2() failed: %s\n",
+									sqlite3_errmsg(handle));
+		(void)sqlite3_close(handle);
+		return NULL;
+	}
+
+	char sql[256];
+	(void)snprintf(sql,
+								 sizeof(sql),
+								 "PRAGMA mmap_size = %lld;"
+								 "PRAGMA cache_size = -%d;"
+								 "PRAGMA synchronous = %d;"
+								 "PRAGMA wal_autocheckpoint = %d;",
+								 database_settings.mmap_size,
+								 database_settings.cache_size,
+								 database_settings.synchronous,
+								 database_settings.checkpoint_pages);
+
+	if (sqlite3_busy_timeout(handle, BUSY_TIMEOUT) != SQLITE_OK ||
+			ExecuteSQL(handle, sql) < 0) {
+		(void)fprintf(stderr,
+									"Error: In OpenHandle(): configuring the connection "
+									"failed\n");
+		(void)sqlite3_close(handle);
+		return NULL;
+	}
+
+	return handle;
+}
+
+static int PrepareStatement(DatabaseConnection* connection, StatementID id) {
+	if (sqlite3_prepare_v3(connection->handle,
+												 STATEMENT_SQL[id],
+												 -1,
+												 SQLITE_PREPARE_PERSISTENT,
+												 &connection->statements[id],
+												 NULL) != SQLITE_OK) {
+		(void)fprintf(stderr,
+									"Error: In PrepareStatement(): sqlite3_prepare_v3() failed: "
+									"%s\n",
+									sqlite3_errmsg(connection->handle));
+		connection->statements[id] = NULL;
+		return -1;
+	}
+
+	connection->num_prepared++;
+	return 0;
+}
+
+// Finalizes the statements of a connection, closes it and adds its counters
+// to the totals. Also the destructor of connection_key, so it runs when a
+// thread with a connection exits.
+static void CloseConnection(void* arg) {
+	DatabaseConnection* connection = (DatabaseConnection*)arg;
+
+	for (int id = 0; id < NUM_STATEMENTS; id++) {
+		if (sqlite3_finalize(connection->statements[id]) != SQLITE_OK) {
+			(void)fprintf(
+					stderr,
+					"Error: In CloseConnection(): sqlite3_finalize() failed: %s\n",
+					sqlite3_errmsg(connection->handle));
+		}
+	}
 
-void InitDatabase() {
-	if (sqlite3_open(database_file, &database) != SQLITE_OK) {
+	if (sqlite3_close(connection->handle) != SQLITE_OK) {
 		(void)fprintf(stderr,
-									"Error: In InitDatabase(): sqlite3_open() failed: %s\n",
-									sqlite3_errmsg(database));
+									"Error: In CloseConnection(): sqlite3_close() failed: %s\n",
+									sqlite3_errmsg(connection->handle));
+	}
+
+	if (pthread_mutex_lock(&stats_lock) != 0) {
+		perror("Error: In CloseConnection(): pthread_mutex_lock() failed");
+	} else {
+		num_connections++;
+		num_prepared += connection->num_prepared;
+		num_reused += connection->num_reused;
+
+		if (pthread_mutex_unlock(&stats_lock) != 0) {
+			perror("Error: In CloseConnection(): pthread_mutex_unlock() failed");
+		}
+	}
+
+	if (connection == local_connection) {
+		local_connection = NULL;
+	}
+	free(connection);
+}
+
+static void CreateConnectionKey() {
+	if (pthread_key_create(&connection_key, CloseConnection) != 0) {
+		perror("Error: In CreateConnectionKey(): pthread_key_create() failed");
+	}
+}
+
+// Returns the connection of the calling thread, opening it on first use.
+// A connection that failed to open is tried again on the next call.
+static DatabaseConnection* GetConnection() {
+	if (local_connection != NULL) {
+		return local_connection;
+	}
+
+	DatabaseConnection* connection =
+			(DatabaseConnection*)calloc(1, sizeof(DatabaseConnection));
+	if (connection == NULL) {
+		perror("Error: In GetConnection(): calloc() failed");
+		return NULL;
+	}
+
+	connection->handle = OpenHandle();
+	if (connection->handle == NULL) {
+		free(connection);
+		return NULL;
+	}
+
+	for (int id = 0; id < NUM_STATEMENTS; id++) {
+		if (PrepareStatement(connection, (StatementID)id) < 0) {
+			CloseConnection(connection);
+			return NULL;
+		}
+	}
+
+	if (pthread_once(&connection_key_once, CreateConnectionKey) != 0 ||
+			pthread_setspecific(connection_key, connection) != 0) {
+		perror("Error: In GetConnection(): pthread_setspecific() failed");
+		CloseConnection(connection);
+		return NULL;
+	}
+
+	local_connection = connection;
+	return connection;
+}
+
+// Returns a prepared statement of the connection of the calling thread.
+static sqlite3_stmt* AcquireStatement(StatementID id) {
+	DatabaseConnection* connection = GetConnection();
+	if (connection == NULL) {
+		return NULL;
+	}
+
+	connection->num_reused++;
+	return connection->statements[id];
+}
+
+// Resets a statement for its next use.
+static void ReleaseStatement(sqlite3_stmt* stmt) {
+	// The result of reset repeats the error of the last step, which has been
+	// reported already.
+	(void)sqlite3_reset(stmt);
+	(void)sqlite3_clear_bindings(stmt);
+}
+
+void InitDatabase(const DatabaseSettings* settings) {
+	database_settings = *settings;
+
+	sqlite3* handle = OpenHandle();
+	if (handle == NULL) {
+		(void)fprintf(stderr, "Error: In InitDatabase(): OpenHandle() failed\n");
 		exit(EXIT_FAILURE);
 	}
 
+	// The journal mode is stored in the database file, so every connection
+	// opened afterwards uses the write-ahead log as well.
 	const char* sql =
+			"PRAGMA journal_mode = WAL;"
 			"CREATE TABLE IF NOT EXISTS database (roll_num TEXT PRIMARY KEY, name "
 			"TEXT);";
 
-	char* error = NULL;
-	if (sqlite3_exec(database, sql, 0, 0, &error) != SQLITE_OK) {
-		(void)fprintf(
-				stderr, "Error: In InitDatabase(): sqlite3_exec() failed: %s\n", error);
-		sqlite3_free(error);
-		if (sqlite3_close(database) != SQLITE_OK) {
+	if (ExecuteSQL(handle, sql) < 0) {
+		if (sqlite3_close(handle) != SQLITE_OK) {
 			(void)fprintf(stderr,
 										"Error: In InitDatabase(): sqlite3_close() failed: %s\n",
-										sqlite3_errmsg(database));
+										sqlite3_errmsg(handle));
 		}
 		exit(EXIT_FAILURE);
 	}
+
+	if (sqlite3_close(handle) != SQLITE_OK) {
+		(void)fprintf(stderr,
+									"Error: In InitDatabase(): sqlite3_close() failed: %s\n",
+									sqlite3_errmsg(handle));
+	}
+
+	// Opening the connection of this thread checks the statements once before
+	// any request needs them.
+	if (GetConnection() == NULL) {
+		(void)fprintf(stderr,
+									"Error: In InitDatabase(): GetConnection() failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	InitRecordCache(settings->record_cache_size);
 }
 
-char* DatabaseGet(const char* key) {
+// Reads the value of a key from the database, bypassing the record cache.
+static char* ReadRecord(const char* key, Arena* arena) {
 	char* value = NULL;
-	const char* sql = "SELECT name FROM database WHERE roll_num = ?;";
-	sqlite3_stmt* stmt = NULL;
 
-	if (sqlite3_prepare_v2(database, sql, -1, &stmt, 0) != SQLITE_OK) {
-		(void)fprintf(stderr,
-									"Error: In DatabaseGet(): sqlite3_prepare_v2() failed: %s\n",
-									sqlite3_errmsg(database));
+	sqlite3_stmt* stmt = AcquireStatement(STATEMENT_GET);
+	if (stmt == NULL) {
 		return NULL;
 	}
 
 	if (sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC) != SQLITE_OK) {
 		(void)fprintf(stderr,
-									"Error: In DatabaseGet(): sqlite3_bind_text() failed: %s\n",
-									sqlite3_errmsg(database));
-
-		if (sqlite3_finalize(stmt) != SQLITE_OK) {
-			(void)fprintf(stderr,
-										"Error: In DatabaseGet(): sqlite3_finalize() failed: %s\n",
-										sqlite3_errmsg(database));
-		}
-
+									"Error: In ReadRecord(): sqlite3_bind_text() failed: %s\n",
+									sqlite3_errmsg(sqlite3_db_handle(stmt)));
+		ReleaseStatement(stmt);
 		return NULL;
 	}
 
 	if (sqlite3_step(stmt) != SQLITE_ROW) {
 		(void)fprintf(
 				stderr,
-				"Error: In DatabaseGet(): sqlite3_step() failed or no result: %s\n",
-				sqlite3_errmsg(database));
-
-		if (sqlite3_finalize(stmt) != SQLITE_OK) {
-			(void)fprintf(stderr,
-										"Error: In DatabaseGet(): sqlite3_finalize() failed: %s\n",
-										sqlite3_errmsg(database));
-		}
-
+				"Error: In ReadRecord(): sqlite3_step() failed or no result: %s\n",
+				sqlite3_errmsg(sqlite3_db_handle(stmt)));
+		ReleaseStatement(stmt);
 		return NULL;
 	}
 
 	const char* name = (const char*)sqlite3_column_text(stmt, 0);
 	if (name != NULL) {
-		value = strdup(name);
+		value = (arena != NULL) ? ArenaStrndup(arena, name, strlen(name))
+														: strdup(name);
 	} else {
 		(void)fprintf(stderr,
-									"Error: In DatabaseGet(): sqlite3_column_text() failed\n");
+									"Error: In ReadRecord(): sqlite3_column_text() failed\n");
 	}
 
-	if (sqlite3_finalize(stmt) != SQLITE_OK) {
-		(void)fprintf(stderr,
-									"Error: In DatabaseGet(): sqlite3_finalize() failed: %s\n",
-									sqlite3_errmsg(database));
+	ReleaseStatement(stmt);
+	return value;
+}
+
+char* DatabaseGet(const char* key, Arena* arena) {
+	char* value = NULL;
+
+	uint64_t generation = 0;
+	if (LookupRecord(key, arena, &value, &generation)) {
+		return value;
+	}
+
+	value = ReadRecord(key, arena);
+	if (value != NULL) {
+		InsertRecord(key, value, generation);
 	}
 
 	return value;
 }
 
-int DatabasePost(const char* key, const char* value) {
-	const char* sql =
-			"INSERT OR REPLACE INTO database (roll_num, name) VALUES (?, ?);";
-	sqlite3_stmt* stmt = NULL;
-
-	if (sqlite3_prepare_v2(database, sql, -1, &stmt, 0) != SQLITE_OK) {
-		(void)fprintf(stderr,
-									"Error: In DatabasePost(): sqlite3_prepare_v2() failed: %s\n",
-									sqlite3_errmsg(database));
-		return 0;
+// Runs the statement of a POST. Returns 1 if the value was stored, 0 if
+// running the statement failed, -1 if it could not be run at all.
+static int WritePost(const char* key, const char* value) {
+	sqlite3_stmt* stmt = AcquireStatement(STATEMENT_POST);
+	if (stmt == NULL) {
+		return -1;
 	}
 
 	if (sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC) != SQLITE_OK ||
 			sqlite3_bind_text(stmt, 2, value, -1, SQLITE_STATIC) != SQLITE_OK) {
 		(void)fprintf(stderr,
-									"Error: In DatabasePost(): sqlite3_bind_text() failed: %s\n",
-									sqlite3_errmsg(database));
-
-		if (sqlite3_finalize(stmt) != SQLITE_OK) {
-			(void)fprintf(stderr,
-										"Error: In DatabasePost(): sqlite3_finalize() failed: %s\n",
-										sqlite3_errmsg(database));
-		}
-
-		return 0;
+									"Error: In WritePost(): sqlite3_bind_text() failed: %s\n",
+									sqlite3_errmsg(sqlite3_db_handle(stmt)));
+		ReleaseStatement(stmt);
+		return -1;
 	}
 
+	int is_written = 1;
 	if (sqlite3_step(stmt) != SQLITE_DONE) {
 		(void)fprintf(
 				stderr,
-				"Error: In DatabasePost(): sqlite3_step() failed or no result: %s\n",
-				sqlite3_errmsg(database));
+				"Error: In WritePost(): sqlite3_step() failed or no result: %s\n",
+				sqlite3_errmsg(sqlite3_db_handle(stmt)));
+		is_written = 0;
 	}
 
-	if (sqlite3_finalize(stmt) != SQLITE_OK) {
+	ReleaseStatement(stmt);
+	return is_written;
+}
+
+// Runs the statement of a DELETE, with the results of WritePost().
+static int WriteDelete(const char* key) {
+	sqlite3_stmt* stmt = AcquireStatement(STATEMENT_DELETE);
+	if (stmt == NULL) {
+		return -1;
+	}
+
+	if (sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC) != SQLITE_OK) {
 		(void)fprintf(stderr,
-									"Error: In DatabasePost(): sqlite3_finalize() failed: %s\n",
-									sqlite3_errmsg(database));
+									"Error: In WriteDelete(): sqlite3_bind_text() failed: %s\n",
+									sqlite3_errmsg(sqlite3_db_handle(stmt)));
+		ReleaseStatement(stmt);
+		return -1;
 	}
 
-	return 1;
+	int is_written = 1;
+	if (sqlite3_step(stmt) != SQLITE_DONE) {
+		(void)fprintf(
+				stderr,
+				"Error: In WriteDelete(): sqlite3_step() failed or no result: %s\n",
+				sqlite3_errmsg(sqlite3_db_handle(stmt)));
+		is_written = 0;
+	}
+
+	ReleaseStatement(stmt);
+	return is_written;
 }
 
-int DatabaseDelete(const char* key) {
-	const char* sql = "DELETE FROM database WHERE roll_num = ?;";
-	sqlite3_stmt* stmt = NULL;
+// Runs BEGIN, COMMIT or ROLLBACK. Returns 0 on success, -1 on error.
+static int RunTransactionStatement(StatementID id) {
+	sqlite3_stmt* stmt = AcquireStatement(id);
+	if (stmt == NULL) {
+		return -1;
+	}
 
-	if (sqlite3_prepare_v2(database, sql, -1, &stmt, 0) != SQLITE_OK) {
+	int result = 0;
+	if (sqlite3_step(stmt) != SQLITE_DONE) {
 		(void)fprintf(
 				stderr,
-				"Error: In DatabaseDelete(): sqlite3_prepare_v2() failed: %s\n",
-				sqlite3_errmsg(database));
+				"Error: In RunTransactionStatement(): sqlite3_step() failed: %s\n",
+				sqlite3_errmsg(sqlite3_db_handle(stmt)));
+		result = -1;
+	}
+
+	ReleaseStatement(stmt);
+	return result;
+}
+
+int DatabasePost(const char* key, const char* value) {
+	int is_written = WritePost(key, value);
+	UpdateRecord(key, (is_written > 0) ? value : NULL);
+
+	return is_written >= 0;
+}
+
+int DatabaseDelete(const char* key) {
+	int is_written = WriteDelete(key);
+	UpdateRecord(key, NULL);
 
+	return is_written >= 0;
+}
+
+// Checks whether SQLite has rolled back the transaction of the calling thread
+// by itself, which a failed statement may do (SQLITE_FULL, SQLITE_IOERR,
+// SQLITE_BUSY...). Statements after that would commit on their own.
+static int IsTransactionLost(int in_transaction) {
+	if (!in_transaction) {
 		return 0;
 	}
 
-	if (sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC) != SQLITE_OK) {
-		(void)fprintf(
-				stderr,
-				"Error: In DatabaseDelete(): sqlite3_bind_text() failed: %s\n",
-				sqlite3_errmsg(database));
+	DatabaseConnection* connection = GetConnection();
+	return connection == NULL || sqlite3_get_autocommit(connection->handle);
+}
 
-		if (sqlite3_finalize(stmt) != SQLITE_OK) {
-			(void)fprintf(
-					stderr,
-					"Error: In DatabaseDelete(): sqlite3_finalize() failed: %s\n",
-					sqlite3_errmsg(database));
+// Commits the transaction of the calling thread, or rolls it back if that
+// fails. Returns 1 if its writes have committed, 0 otherwise. They are only
+// on disk with synchronous FULL or EXTRA.
+static int EndTransaction(int in_transaction) {
+	// Without a transaction, every write has committed on its own.
+	if (!in_transaction) {
+		return 1;
+	}
+
+	// A failed statement may have rolled the transaction back already.
+	DatabaseConnection* connection = GetConnection();
+	if (connection != NULL && !sqlite3_get_autocommit(connection->handle) &&
+			RunTransactionStatement(STATEMENT_COMMIT) == 0) {
+		return 1;
+	}
+
+	if (connection != NULL && !sqlite3_get_autocommit(connection->handle)) {
+		(void)RunTransactionStatement(STATEMENT_ROLLBACK);
+	}
+
+	return 0;
+}
+
+// Passes a write that has run in a transaction on to the record cache, once
+// the transaction has ended, and sets its final result.
+static void PublishWrite(DatabaseOperation* operation, int is_committed) {
+	int is_stored = is_committed && operation->result > 0 &&
+									operation->type == DATABASE_POST;
+	UpdateRecord(operation->key, is_stored ? operation->value : NULL);
+
+	operation->result = is_committed && operation->result >= 0;
+}
+
+// Runs the operations of a DATABASE_BATCH in one transaction. Its reads go
+// to the database, not the record cache, so that they all see the same
+// snapshot, including the writes of the batch before them.
+static void ExecuteTransaction(DatabaseOperation* operations, size_t count) {
+	int has_writes = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (operations[i].type == DATABASE_POST ||
+				operations[i].type == DATABASE_DELETE) {
+			has_writes = 1;
+		}
+	}
+
+	StatementID begin = has_writes ? STATEMENT_BEGIN : STATEMENT_BEGIN_READ;
+	int in_transaction = RunTransactionStatement(begin) == 0;
+
+	int is_lost = 0;
+	for (size_t i = 0; i < count; i++) {
+		DatabaseOperation* operation = &operations[i];
+
+		// The rest would run outside the transaction, so none of it runs.
+		if (is_lost) {
+			operation->result = (operation->type == DATABASE_GET) ? 0 : -1;
+			continue;
 		}
 
-		return 0;
+		switch (operation->type) {
+			case DATABASE_GET:
+				operation->value = ReadRecord(operation->key, operation->arena);
+				operation->result = operation->value != NULL;
+				break;
+			case DATABASE_POST:
+				operation->result = WritePost(operation->key, operation->value);
+				break;
+			case DATABASE_DELETE:
+				operation->result = WriteDelete(operation->key);
+				break;
+			default:
+				operation->result = 0;
+				break;
+		}
+
+		is_lost = operation->result <= 0 && IsTransactionLost(in_transaction);
 	}
 
-	if (sqlite3_step(stmt) != SQLITE_DONE) {
-		(void)fprintf(
-				stderr,
-				"Error: In DatabaseDelete(): sqlite3_step() failed or no result: %s\n",
-				sqlite3_errmsg(database));
+	int is_committed = EndTransaction(in_transaction);
+
+	for (size_t i = 0; i < count; i++) {
+		if (operations[i].type == DATABASE_POST ||
+				operations[i].type == DATABASE_DELETE) {
+			PublishWrite(&operations[i], is_committed);
+		}
 	}
+}
 
-	if (sqlite3_finalize(stmt) != SQLITE_OK) {
-		(void)fprintf(stderr,
-									"Error: In DatabaseDelete(): sqlite3_finalize() failed: %s\n",
-									sqlite3_errmsg(database));
+void ExecuteDatabaseOperation(DatabaseOperation* operation) {
+	switch (operation->type) {
+		case DATABASE_GET:
+			if (operation->arena == NULL) {
+				free(operation->value);
+			}
+			operation->value = DatabaseGet(operation->key, operation->arena);
+			operation->result = operation->value != NULL;
+			break;
+		case DATABASE_POST:
+			operation->result = DatabasePost(operation->key, operation->value);
+			break;
+		case DATABASE_DELETE:
+			operation->result = DatabaseDelete(operation->key);
+			break;
+		case DATABASE_BATCH:
+			ExecuteTransaction(operation->batch, operation->batch_length);
+			operation->result = 1;
+			break;
+		case DATABASE_NONE:
+			operation->result = 0;
+			break;
+	}
+}
+
+void ExecuteDatabaseBatch(DatabaseOperation* const* operations, size_t count) {
+	int in_transaction = RunTransactionStatement(STATEMENT_BEGIN) == 0;
+	int is_lost = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		DatabaseOperation* operation = operations[i];
+
+		// Writes after a lost transaction would commit on their own, while the
+		// ones before them were rolled back, so they are not run.
+		switch (operation->type) {
+			case DATABASE_POST:
+				operation->result =
+						is_lost ? -1 : WritePost(operation->key, operation->value);
+				break;
+			case DATABASE_DELETE:
+				operation->result = is_lost ? -1 : WriteDelete(operation->key);
+				break;
+			default:
+				ExecuteDatabaseOperation(operation);
+				continue;
+		}
+
+		is_lost = is_lost ||
+							(operation->result <= 0 && IsTransactionLost(in_transaction));
+	}
+
+	int is_committed = EndTransaction(in_transaction);
+
+	// Nothing reaches the record cache before it has committed.
+	for (size_t i = 0; i < count; i++) {
+		if (operations[i]->type == DATABASE_POST ||
+				operations[i]->type == DATABASE_DELETE) {
+			PublishWrite(operations[i], is_committed);
+		}
 	}
+}
 
-	return 1;
+void ClearDatabaseOperation(DatabaseOperation* operation) {
+	if (operation->arena == NULL) {
+		for (size_t i = 0; i < operation->batch_length; i++) {
+			ClearDatabaseOperation(&operation->batch[i]);
+		}
+		free(operation->batch);
+		free(operation->key);
+		free(operation->value);
+	}
+	memset(operation, 0, sizeof(DatabaseOperation));
+}
+
+void PrintDatabaseStats() {
+	if (pthread_mutex_lock(&stats_lock) != 0) {
+		perror("Error: In PrintDatabaseStats(): pthread_mutex_lock() failed");
+		return;
+	}
+
+	uint64_t connections = num_connections;
+	uint64_t prepared = num_prepared;
+	uint64_t reused = num_reused;
+
+	if (pthread_mutex_unlock(&stats_lock) != 0) {
+		perror("Error: In PrintDatabaseStats(): pthread_mutex_unlock() failed");
+	}
+
+	if (local_connection != NULL) {
+		connections++;
+		prepared += local_connection->num_prepared;
+		reused += local_connection->num_reused;
+	}
+
+	(void)printf(
+			"Database: %llu connections, %llu statements prepared, %llu reused\n",
+			(unsigned long long)connections,
+			(unsigned long long)prepared,
+			(unsigned long long)reused);
+
+	PrintRecordCacheStats();
 }
 
 void CleanupDatabase() {
-	if (sqlite3_close(database) != SQLITE_OK) {
-		(void)fprintf(stderr,
-									"Error: In CleanupDatabase(): sqlite3_close() failed: %s\n",
-									sqlite3_errmsg(database));
+	CleanupRecordCache();
+
+	DatabaseConnection* connection = local_connection;
+	if (connection == NULL) {
+		return;
+	}
+
+	if (pthread_setspecific(connection_key, NULL) != 0) {
+		perror("Error: In CleanupDatabase(): pthread_setspecific() failed");
 	}
 
-	database = NULL;
+	CloseConnection(connection);
 }
 
 // src/database.c
\ No newline at end of file
@@ -0,0 +1,291 @@
+#include "executor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "database.h"
+#include "network.h"
+#include "queue.h"
+#include "signal_handler.h"
+#include "thread_pool.h"
+
+static Queue queue;
+static ExecutorThread* threads = NULL;
+static int num_threads = 0;
+
+// Writes go through a queue of their own to a single writer, which commits
+// them in batches.
+static Queue write_queue;
+static ExecutorThread writer;
+static Connection** write_batch = NULL;
+static DatabaseOperation** write_operations = NULL;
+static size_t batch_size = 0;
+static uint64_t batch_window = 0;
+static uint64_t num_batches = 0;
+static size_t max_batch = 0;
+
+static void* RunExecutorThread(void* arg) {
+	DisableSignalsInThread();
+
+	ExecutorThread* executor = (ExecutorThread*)arg;
+
+	while (is_server_running) {
+		int client_socket = Dequeue(&queue);
+		if (client_socket < 0) {
+			continue;
+		}
+
+		uint64_t start = GetMonotonicTimeNs();
+		size_t queue_depth = QueueLength(&queue) + 1;
+
+		Connection* connection = GetConnection(client_socket);
+		uint64_t wait_time =
+				(start > connection->queued_at) ? start - connection->queued_at : 0;
+
+		ExecuteDatabaseOperation(&connection->operation);
+
+		uint64_t busy_time = GetMonotonicTimeNs() - start;
+
+		// The connection belongs to the network stage again from here on.
+		if (SubmitConnection(connection->pool, connection) != 0) {
+			(void)fprintf(
+					stderr,
+					"Error: In RunExecutorThread(): SubmitConnection() failed\n");
+		}
+
+		__atomic_store_n(
+				&executor->num_executed, executor->num_executed + 1, __ATOMIC_RELAXED);
+		__atomic_store_n(&executor->wait_time,
+										 executor->wait_time + wait_time,
+										 __ATOMIC_RELAXED);
+		__atomic_store_n(&executor->busy_time,
+										 executor->busy_time + busy_time,
+										 __ATOMIC_RELAXED);
+		if (queue_depth > executor->max_queue_depth) {
+			__atomic_store_n(
+					&executor->max_queue_depth, queue_depth, __ATOMIC_RELAXED);
+		}
+	}
+
+	return NULL;
+}
+
+// Adds writes queued since the first one to the batch, until it is full or
+// the window has passed. The writer sleeps on the queue in between, so an idle
+// window costs no CPU. Returns the new number of connections in the batch.
+static size_t CollectWrites(size_t count, uint64_t deadline) {
+	while (count < batch_size) {
+		int client_socket = TryDequeue(&write_queue);
+		if (client_socket < 0) {
+			uint64_t now = GetMonotonicTimeNs();
+			if (!is_server_running || now >= deadline) {
+				break;
+			}
+			client_socket = DequeueWithTimeout(&write_queue, deadline - now);
+		}
+
+		if (client_socket >= 0) {
+			write_batch[count++] = GetConnection(client_socket);
+		}
+	}
+
+	return count;
+}
+
+static void* RunWriterThread(void* arg) {
+	(void)arg;
+	DisableSignalsInThread();
+
+	while (is_server_running) {
+		int client_socket = Dequeue(&write_queue);
+		if (client_socket < 0) {
+			continue;
+		}
+
+		uint64_t start = GetMonotonicTimeNs();
+		size_t queue_depth = QueueLength(&write_queue) + 1;
+
+		write_batch[0] = GetConnection(client_socket);
+		size_t count = CollectWrites(1, start + batch_window);
+
+		uint64_t wait_time = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (start > write_batch[i]->queued_at) {
+				wait_time += start - write_batch[i]->queued_at;
+			}
+			write_operations[i] = &write_batch[i]->operation;
+		}
+
+		ExecuteDatabaseBatch(write_operations, count);
+
+		uint64_t busy_time = GetMonotonicTimeNs() - start;
+
+		// Every write of the batch has committed, so all of them are answered.
+		for (size_t i = 0; i < count; i++) {
+			if (SubmitConnection(write_batch[i]->pool, write_batch[i]) != 0) {
+				(void)fprintf(
+						stderr,
+						"Error: In RunWriterThread(): SubmitConnection() failed\n");
+			}
+		}
+
+		__atomic_store_n(
+				&writer.num_executed, writer.num_executed + count, __ATOMIC_RELAXED);
+		__atomic_store_n(
+				&writer.wait_time, writer.wait_time + wait_time, __ATOMIC_RELAXED);
+		__atomic_store_n(
+				&writer.busy_time, writer.busy_time + busy_time, __ATOMIC_RELAXED);
+		if (queue_depth > writer.max_queue_depth) {
+			__atomic_store_n(&writer.max_queue_depth, queue_depth, __ATOMIC_RELAXED);
+		}
+		__atomic_store_n(&num_batches, num_batches + 1, __ATOMIC_RELAXED);
+		if (count > max_batch) {
+			__atomic_store_n(&max_batch, count, __ATOMIC_RELAXED);
+		}
+	}
+
+	return NULL;
+}
+
+void InitExecutor(int num_thread, int write_batch_size, int write_window) {
+	if (num_thread <= 0) {
+		return;
+	}
+
+	batch_size = (write_batch_size > 0) ? (size_t)write_batch_size : 1;
+	batch_window = (uint64_t)write_window * 1000;
+
+	InitQueue(&write_queue, (int)MAX_CONNECTIONS);
+
+	write_batch = (Connection**)calloc(batch_size, sizeof(Connection*));
+	write_operations =
+			(DatabaseOperation**)calloc(batch_size, sizeof(DatabaseOperation*));
+	if (write_batch == NULL || write_operations == NULL) {
+		perror("Error: In InitExecutor(): calloc() failed");
+		exit(EXIT_FAILURE);
+	}
+
+	if (pthread_create(&writer.thread, NULL, RunWriterThread, NULL) != 0) {
+		perror("Error: In InitExecutor(): pthread_create() failed");
+		exit(EXIT_FAILURE);
+	}
+
+	// Every connection has at most one pending operation, so a queue of this
+	// size never fills up.
+	InitQueue(&queue, (int)MAX_CONNECTIONS);
+
+	threads = (ExecutorThread*)calloc(num_thread, sizeof(ExecutorThread));
+	if (threads == NULL) {
+		perror("Error: In InitExecutor(): calloc() failed");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int i = 0; i < num_thread; i++) {
+		if (pthread_create(
+						&threads[i].thread, NULL, RunExecutorThread, &threads[i]) != 0) {
+			perror("Error: In InitExecutor(): pthread_create() failed");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	num_threads = num_thread;
+}
+
+int SubmitDatabaseOperation(Connection* connection) {
+	if (num_threads == 0 || connection->pool == NULL) {
+		return -1;
+	}
+
+	connection->queued_at = GetMonotonicTimeNs();
+
+	DatabaseOperationType type = connection->operation.type;
+	if (type == DATABASE_POST || type == DATABASE_DELETE) {
+		return Enqueue(&write_queue, connection->fd);
+	}
+
+	return Enqueue(&queue, connection->fd);
+}
+
+void PrintExecutorStats() {
+	if (num_threads == 0) {
+		(void)printf("Database stage: run by the Workers\n");
+		return;
+	}
+
+	uint64_t num_executed = 0;
+	uint64_t wait_time = 0;
+	uint64_t busy_time = 0;
+	size_t max_queue_depth = 0;
+
+	for (int i = 0; i < num_threads; i++) {
+		num_executed += threads[i].num_executed;
+		wait_time += threads[i].wait_time;
+		busy_time += threads[i].busy_time;
+		if (threads[i].max_queue_depth > max_queue_depth) {
+			max_queue_depth = threads[i].max_queue_depth;
+		}
+	}
+
+	uint64_t divisor = (num_executed > 0) ? num_executed : 1;
+	(void)printf(
+			"Database stage: %d threads, %llu operations, queue depth max %zu, "
+			"wait avg %llu us, service avg %llu us\n",
+			num_threads,
+			(unsigned long long)num_executed,
+			max_queue_depth,
+			(unsigned long long)(wait_time / divisor / 1000),
+			(unsigned long long)(busy_time / divisor / 1000));
+
+	uint64_t write_divisor = (writer.num_executed > 0) ? writer.num_executed : 1;
+	uint64_t batch_divisor = (num_batches > 0) ? num_batches : 1;
+	(void)printf(
+			"Database writer: %llu writes in %llu commits, batch max %zu, queue "
+			"depth max %zu, wait avg %llu us, commit avg %llu us\n",
+			(unsigned long long)writer.num_executed,
+			(unsigned long long)num_batches,
+			max_batch,
+			writer.max_queue_depth,
+			(unsigned long long)(writer.wait_time / write_divisor / 1000),
+			(unsigned long long)(writer.busy_time / batch_divisor / 1000));
+}
+
+void StopExecutor() {
+	if (num_threads == 0) {
+		return;
+	}
+
+	WakeQueue(&queue);
+	WakeQueue(&write_queue);
+
+	for (int i = 0; i < num_threads; i++) {
+		if (pthread_join(threads[i].thread, NULL) != 0) {
+			perror("Error: In StopExecutor(): pthread_join() failed");
+		}
+	}
+
+	if (pthread_join(writer.thread, NULL) != 0) {
+		perror("Error: In StopExecutor(): pthread_join() failed");
+	}
+}
+
+void CleanupExecutor() {
+	if (threads == NULL) {
+		return;
+	}
+
+	CleanupQueue(&queue);
+	CleanupQueue(&write_queue);
+
+	free(write_batch);
+	free(write_operations);
+	write_batch = NULL;
+	write_operations = NULL;
+
+	free(threads);
+	threads = NULL;
+	num_threads = 0;
+}
+
+// src/executor.c
\ No newline at end of file
@@ -0,0 +1,647 @@
+#include "json.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "scan.h"
+
+static int IsJSONWhitespace(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int IsDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+static int HexValue(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+
+	return -1;
+}
+
+// Reads the four hex digits of a \u escape. Returns -1 if they are malformed.
+static long ReadHex4(const char* data) {
+	long value = 0;
+
+	for (int i = 0; i < 4; i++) {
+		int digit = HexValue(data[i]);
+		if (digit < 0) {
+			return -1;
+		}
+		value = value * 16 + digit;
+	}
+
+	return value;
+}
+
+void InitJSONTokenizer(JSONTokenizer* tokenizer,
+											 const char* data,
+											 size_t length) {
+	tokenizer->data = data;
+	tokenizer->length = length;
+	tokenizer->position = 0;
+	tokenizer->depth = 0;
+	tokenizer->expect = JSON_EXPECT_VALUE;
+}
+
+static JSONTokenType FailJSONToken(JSONTokenizer* tokenizer, JSONToken* token) {
+	tokenizer->expect = JSON_EXPECT_FAILED;
+	token->type = JSON_ERROR;
+	return JSON_ERROR;
+}
+
+// Skips a string whose opening quote is at position. Returns 0 on success,
+// -1 if it is unterminated or holds a raw control character or a malformed
+// escape.
+static int ReadJSONString(JSONTokenizer* tokenizer, JSONToken* token) {
+	const char* data = tokenizer->data;
+	size_t end = tokenizer->length;
+	size_t start = tokenizer->position + 1;
+	size_t i = start;
+
+	token->has_escapes = 0;
+
+	for (;;) {
+		i += FindJSONSpecial(data + i, end - i);
+		if (i == end) {
+			return -1;
+		}
+
+		if (data[i] == '"') {
+			break;
+		}
+
+		if (data[i] != '\\' || i + 1 == end) {
+			return -1;
+		}
+
+		token->has_escapes = 1;
+
+		switch (data[i + 1]) {
+			case '"':
+			case '\\':
+			case '/':
+			case 'b':
+			case 'f':
+			case 'n':
+			case 'r':
+			case 't':
+				i += 2;
+				break;
+			case 'u':
+				if (end - i < 6 || ReadHex4(data + i + 2) < 0) {
+					return -1;
+				}
+				i += 6;
+				break;
+			default:
+				return -1;
+		}
+	}
+
+	token->text.data = data + start;
+	token->text.length = i - start;
+	tokenizer->position = i + 1;
+
+	return 0;
+}
+
+// Skips a number starting at position, following the JSON grammar.
+static int ReadJSONNumber(JSONTokenizer* tokenizer, JSONToken* token) {
+	const char* data = tokenizer->data;
+	size_t end = tokenizer->length;
+	size_t start = tokenizer->position;
+	size_t i = start;
+
+	if (i < end && data[i] == '-') {
+		i++;
+	}
+
+	if (i < end && data[i] == '0') {
+		i++;
+	} else if (i < end && IsDigit(data[i])) {
+		while (i < end && IsDigit(data[i])) {
+			i++;
+		}
+	} else {
+		return -1;
+	}
+
+	if (i < end && data[i] == '.') {
+		i++;
+		if (i == end || !IsDigit(data[i])) {
+			return -1;
+		}
+		while (i < end && IsDigit(data[i])) {
+			i++;
+		}
+	}
+
+	if (i < end && (data[i] == 'e' || data[i] == 'E')) {
+		i++;
+		if (i < end && (data[i] == '+' || data[i] == '-')) {
+			i++;
+		}
+		if (i == end || !IsDigit(data[i])) {
+			return -1;
+		}
+		while (i < end && IsDigit(data[i])) {
+			i++;
+		}
+	}
+
+	token->text.data = data + start;
+	token->text.length = i - start;
+	tokenizer->position = i;
+
+	return 0;
+}
+
+static int ReadJSONLiteral(JSONTokenizer* tokenizer,
+													 JSONToken* token,
+													 const char* literal) {
+	size_t length = strlen(literal);
+	if (tokenizer->length - tokenizer->position < length ||
+			memcmp(tokenizer->data + tokenizer->position, literal, length) != 0) {
+		return -1;
+	}
+
+	token->text.data = tokenizer->data + tokenizer->position;
+	token->text.length = length;
+	tokenizer->position += length;
+
+	return 0;
+}
+
+// A value or a container end has been read: what follows depends on the
+// container it is in.
+static void FinishJSONValue(JSONTokenizer* tokenizer) {
+	tokenizer->expect = (tokenizer->depth == 0) ? JSON_EXPECT_DOCUMENT_END
+																							: JSON_EXPECT_COMMA_OR_END;
+}
+
+static JSONTokenType ReadJSONValue(JSONTokenizer* tokenizer,
+																	 JSONToken* token) {
+	char c = tokenizer->data[tokenizer->position];
+
+	switch (c) {
+		case '{':
+		case '[':
+			if (tokenizer->depth == MAX_JSON_DEPTH) {
+				return FailJSONToken(tokenizer, token);
+			}
+
+			tokenizer->in_object[tokenizer->depth++] = (c == '{');
+			tokenizer->position++;
+			tokenizer->expect =
+					(c == '{') ? JSON_EXPECT_KEY_OR_END : JSON_EXPECT_VALUE_OR_END;
+			token->text.data = tokenizer->data + tokenizer->position - 1;
+			token->text.length = 1;
+			token->type = (c == '{') ? JSON_OBJECT_START : JSON_ARRAY_START;
+			return token->type;
+		case '"':
+			if (ReadJSONString(tokenizer, token) < 0) {
+				return FailJSONToken(tokenizer, token);
+			}
+			token->type = JSON_STRING;
+			break;
+		case 't':
+			if (ReadJSONLiteral(tokenizer, token, "true") < 0) {
+				return FailJSONToken(tokenizer, token);
+			}
+			token->type = JSON_TRUE;
+			break;
+		case 'f':
+			if (ReadJSONLiteral(tokenizer, token, "false") < 0) {
+				return FailJSONToken(tokenizer, token);
+			}
+			token->type = JSON_FALSE;
+			break;
+		case 'n':
+			if (ReadJSONLiteral(tokenizer, token, "null") < 0) {
+				return FailJSONToken(tokenizer, token);
+			}
+			token->type = JSON_NULL;
+			break;
+		default:
+			if (ReadJSONNumber(tokenizer, token) < 0) {
+				return FailJSONToken(tokenizer, token);
+			}
+			token->type = JSON_NUMBER;
+			break;
+	}
+
+	FinishJSONValue(tokenizer);
+	return token->type;
+}
+
+static JSONTokenType ReadJSONKey(JSONTokenizer* tokenizer, JSONToken* token) {
+	if (tokenizer->data[tokenizer->position] != '"' ||
+			ReadJSONString(tokenizer, token) < 0) {
+		return FailJSONToken(tokenizer, token);
+	}
+
+	while (tokenizer->position < tokenizer->length &&
+				 IsJSONWhitespace(tokenizer->data[tokenizer->position])) {
+		tokenizer->position++;
+	}
+
+	if (tokenizer->position == tokenizer->length ||
+			tokenizer->data[tokenizer->position] != ':') {
+		return FailJSONToken(tokenizer, token);
+	}
+
+	tokenizer->position++;
+	tokenizer->expect = JSON_EXPECT_VALUE;
+	token->type = JSON_KEY;
+	return JSON_KEY;
+}
+
+static JSONTokenType ReadJSONEnd(JSONTokenizer* tokenizer, JSONToken* token) {
+	char c = tokenizer->data[tokenizer->position];
+	int is_object = tokenizer->in_object[tokenizer->depth - 1];
+
+	if (c != (is_object ? '}' : ']')) {
+		return FailJSONToken(tokenizer, token);
+	}
+
+	tokenizer->depth--;
+	tokenizer->position++;
+	token->depth = tokenizer->depth;
+	token->text.data = tokenizer->data + tokenizer->position - 1;
+	token->text.length = 1;
+	token->type = is_object ? JSON_OBJECT_END : JSON_ARRAY_END;
+
+	FinishJSONValue(tokenizer);
+	return token->type;
+}
+
+JSONTokenType NextJSONToken(JSONTokenizer* tokenizer, JSONToken* token) {
+	token->text.data = NULL;
+	token->text.length = 0;
+	token->has_escapes = 0;
+	token->depth = tokenizer->depth;
+
+	if (tokenizer->expect == JSON_EXPECT_NOTHING) {
+		token->type = JSON_END;
+		return JSON_END;
+	}
+
+	if (tokenizer->expect == JSON_EXPECT_FAILED) {
+		token->type = JSON_ERROR;
+		return JSON_ERROR;
+	}
+
+	for (;;) {
+		while (tokenizer->position < tokenizer->length &&
+					 IsJSONWhitespace(tokenizer->data[tokenizer->position])) {
+			tokenizer->position++;
+		}
+
+		if (tokenizer->position == tokenizer->length) {
+			if (tokenizer->expect != JSON_EXPECT_DOCUMENT_END) {
+				return FailJSONToken(tokenizer, token);
+			}
+
+			tokenizer->expect = JSON_EXPECT_NOTHING;
+			token->type = JSON_END;
+			return JSON_END;
+		}
+
+		char c = tokenizer->data[tokenizer->position];
+
+		switch (tokenizer->expect) {
+			case JSON_EXPECT_VALUE:
+				return ReadJSONValue(tokenizer, token);
+			case JSON_EXPECT_VALUE_OR_END:
+				return (c == ']') ? ReadJSONEnd(tokenizer, token)
+													: ReadJSONValue(tokenizer, token);
+			case JSON_EXPECT_KEY:
+				return ReadJSONKey(tokenizer, token);
+			case JSON_EXPECT_KEY_OR_END:
+				return (c == '}') ? ReadJSONEnd(tokenizer, token)
+													: ReadJSONKey(tokenizer, token);
+			case JSON_EXPECT_COMMA_OR_END:
+				if (c != ',') {
+					return ReadJSONEnd(tokenizer, token);
+				}
+
+				// The comma is not a token of its own; the entry after it is.
+				tokenizer->position++;
+				tokenizer->expect = tokenizer->in_object[tokenizer->depth - 1]
+																? JSON_EXPECT_KEY
+																: JSON_EXPECT_VALUE;
+				break;
+			default:
+				return FailJSONToken(tokenizer, token);
+		}
+	}
+}
+
+// Decodes the escape at *data, advancing past it. Returns the number of bytes
+// stored in output, or -1 if the escape is malformed.
+static int DecodeJSONEscape(const char** data, const char* end, char* output) {
+	const char* escape = *data;
+	if (end - escape < 2) {
+		return -1;
+	}
+
+	switch (escape[1]) {
+		case '"':
+		case '\\':
+		case '/':
+			output[0] = escape[1];
+			break;
+		case 'b':
+			output[0] = '\b';
+			break;
+		case 'f':
+			output[0] = '\f';
+			break;
+		case 'n':
+			output[0] = '\n';
+			break;
+		case 'r':
+			output[0] = '\r';
+			break;
+		case 't':
+			output[0] = '\t';
+			break;
+		case 'u': {
+			if (end - escape < 6) {
+				return -1;
+			}
+
+			long code_point = ReadHex4(escape + 2);
+			if (code_point < 0 || (code_point >= 0xDC00 && code_point <= 0xDFFF)) {
+				return -1;
+			}
+			escape += 6;
+
+			// A high surrogate must be followed by the low one of its pair.
+			if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+				if (end - escape < 6 || escape[0] != '\\' || escape[1] != 'u') {
+					return -1;
+				}
+
+				long low = ReadHex4(escape + 2);
+				if (low < 0xDC00 || low > 0xDFFF) {
+					return -1;
+				}
+				escape += 6;
+
+				code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+			}
+
+			*data = escape;
+
+			if (code_point < 0x80) {
+				output[0] = (char)code_point;
+				return 1;
+			}
+			if (code_point < 0x800) {
+				output[0] = (char)(0xC0 | (code_point >> 6));
+				output[1] = (char)(0x80 | (code_point & 0x3F));
+				return 2;
+			}
+			if (code_point < 0x10000) {
+				output[0] = (char)(0xE0 | (code_point >> 12));
+				output[1] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+				output[2] = (char)(0x80 | (code_point & 0x3F));
+				return 3;
+			}
+
+			output[0] = (char)(0xF0 | (code_point >> 18));
+			output[1] = (char)(0x80 | ((code_point >> 12) & 0x3F));
+			output[2] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+			output[3] = (char)(0x80 | (code_point & 0x3F));
+			return 4;
+		}
+		default:
+			return -1;
+	}
+
+	*data = escape + 2;
+	return 1;
+}
+
+int UnescapeJSONString(StringView text, char* output, size_t* length) {
+	const char* data = text.data;
+	const char* end = text.data + text.length;
+	char* out = output;
+
+	while (data < end) {
+		const char* escape = memchr(data, '\\', (size_t)(end - data));
+		if (escape == NULL) {
+			escape = end;
+		}
+
+		memcpy(out, data, (size_t)(escape - data));
+		out += escape - data;
+		data = escape;
+
+		if (data < end) {
+			int decoded = DecodeJSONEscape(&data, end, out);
+			if (decoded < 0) {
+				return -1;
+			}
+			out += decoded;
+		}
+	}
+
+	*length = (size_t)(out - output);
+	return 0;
+}
+
+int JSONStringEquals(const JSONToken* token, const char* text) {
+	size_t text_length = strlen(text);
+
+	if (!token->has_escapes) {
+		return token->text.length == text_length &&
+					 memcmp(token->text.data, text, text_length) == 0;
+	}
+
+	const char* data = token->text.data;
+	const char* end = token->text.data + token->text.length;
+	size_t matched = 0;
+
+	while (data < end) {
+		char decoded[4];
+		int decoded_length = 1;
+
+		if (*data == '\\') {
+			decoded_length = DecodeJSONEscape(&data, end, decoded);
+			if (decoded_length < 0) {
+				return 0;
+			}
+		} else {
+			decoded[0] = *data++;
+		}
+
+		if (text_length - matched < (size_t)decoded_length ||
+				memcmp(text + matched, decoded, (size_t)decoded_length) != 0) {
+			return 0;
+		}
+		matched += (size_t)decoded_length;
+	}
+
+	return matched == text_length;
+}
+
+void InitJSONWriter(JSONWriter* writer, char* output) {
+	writer->output = output;
+	writer->length = 0;
+	writer->depth = 0;
+	writer->is_first = 1;
+	writer->after_key = 0;
+}
+
+static void WriteBytes(JSONWriter* writer, const char* data, size_t length) {
+	if (writer->output != NULL) {
+		memcpy(writer->output + writer->length, data, length);
+	}
+	writer->length += length;
+}
+
+static void WriteByte(JSONWriter* writer, char c) {
+	if (writer->output != NULL) {
+		writer->output[writer->length] = c;
+	}
+	writer->length++;
+}
+
+static void WriteLineBreak(JSONWriter* writer) {
+	WriteBytes(writer, "\r\n", 2);
+	for (size_t i = 0; i < writer->depth; i++) {
+		WriteByte(writer, '\t');
+	}
+}
+
+// Places the separator and indentation in front of an entry of the current
+// container. Values following their key need none.
+static void BeginJSONEntry(JSONWriter* writer) {
+	if (writer->after_key) {
+		writer->after_key = 0;
+		return;
+	}
+
+	if (writer->depth > 0) {
+		if (!writer->is_first) {
+			WriteByte(writer, ',');
+		}
+		WriteLineBreak(writer);
+	}
+
+	writer->is_first = 0;
+}
+
+static void WriteEscaped(JSONWriter* writer, const char* data, size_t length) {
+	static const char HEX_DIGITS[] = "0123456789abcdef";
+
+	WriteByte(writer, '"');
+
+	while (length > 0) {
+		// Plain runs are found a vector at a time and copied as they are.
+		size_t plain = FindJSONSpecial(data, length);
+		WriteBytes(writer, data, plain);
+		data += plain;
+		length -= plain;
+
+		if (length == 0) {
+			break;
+		}
+
+		char c = *data++;
+		length--;
+
+		switch (c) {
+			case '"':
+				WriteBytes(writer, "\\\"", 2);
+				break;
+			case '\\':
+				WriteBytes(writer, "\\\\", 2);
+				break;
+			case '\b':
+				WriteBytes(writer, "\\b", 2);
+				break;
+			case '\f':
+				WriteBytes(writer, "\\f", 2);
+				break;
+			case '\n':
+				WriteBytes(writer, "\\n", 2);
+				break;
+			case '\r':
+				WriteBytes(writer, "\\r", 2);
+				break;
+			case '\t':
+				WriteBytes(writer, "\\t", 2);
+				break;
+			default: {
+				char escape[6] = {'\\',
+													'u',
+													'0',
+													'0',
+													HEX_DIGITS[((unsigned char)c >> 4) & 0xF],
+													HEX_DIGITS[(unsigned char)c & 0xF]};
+				WriteBytes(writer, escape, sizeof(escape));
+				break;
+			}
+		}
+	}
+
+	WriteByte(writer, '"');
+}
+
+static void BeginJSONContainer(JSONWriter* writer, char open) {
+	BeginJSONEntry(writer);
+	WriteByte(writer, open);
+	writer->depth++;
+	writer->is_first = 1;
+}
+
+static void EndJSONContainer(JSONWriter* writer, char close) {
+	writer->depth--;
+	if (!writer->is_first) {
+		WriteLineBreak(writer);
+	}
+	WriteByte(writer, close);
+	writer->is_first = 0;
+}
+
+void BeginJSONObject(JSONWriter* writer) {
+	BeginJSONContainer(writer, '{');
+}
+
+void EndJSONObject(JSONWriter* writer) {
+	EndJSONContainer(writer, '}');
+}
+
+void BeginJSONArray(JSONWriter* writer) {
+	BeginJSONContainer(writer, '[');
+}
+
+void EndJSONArray(JSONWriter* writer) {
+	EndJSONContainer(writer, ']');
+}
+
+void WriteJSONKey(JSONWriter* writer, const char* key) {
+	BeginJSONEntry(writer);
+	WriteEscaped(writer, key, strlen(key));
+	WriteBytes(writer, ": ", 2);
+	writer->after_key = 1;
+}
+
+void WriteJSONString(JSONWriter* writer, const char* data, size_t length) {
+	BeginJSONEntry(writer);
+	WriteEscaped(writer, data, length);
+}
+
+// src/json.c
\ No newline at end of file
@@ -1,19 +1,39 @@
 #include "network.h"
 
 #include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <ifaddrs.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "common.h"
+#include "connection.h"
+#include "thread_pool.h"
+#include "uring.h"
 
-static void PrintLocalIP() {
+static const int REACTOR_TIMEOUT_MS = 1000;
+
+// Connections indexed by their client socket. A slot is written by the event
+// loop on accept and cleared by whoever closes the connection. The lock only
+// guards adding and removing entries; the current owner of a connection reads
+// its slot without it.
+static Connection** connections = NULL;
+static pthread_mutex_t connections_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void PrintLocalIP() {
 	struct ifaddrs* ifaddr = NULL;
 	struct ifaddrs* ifa = NULL;
 	char ip_str[INET_ADDRSTRLEN];
@@ -38,7 +58,7 @@ static void PrintLocalIP() {
 	freeifaddrs(ifaddr);
 }
 
-int CreateServerSocket(int port, int max_connections) {
+int CreateServerSocket(int port, int max_connections, int reuse_port) {
 	int server_socket = socket(AF_INET, SOCK_STREAM, 0);
 
 	if (server_socket < 0) {
@@ -54,6 +74,14 @@ int CreateServerSocket(int port, int max_connections) {
 		return -1;
 	}
 
+	if (reuse_port &&
+			setsockopt(
+					server_socket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+		perror("Error: In CreateServerSocket(): setsockopt() failed");
+		close(server_socket);
+		return -1;
+	}
+
 	struct sockaddr_in server_addr;
 	server_addr.sin_family = AF_INET;
 	server_addr.sin_addr.s_addr = INADDR_ANY;
@@ -66,8 +94,6 @@ int CreateServerSocket(int port, int max_connections) {
 		return -1;
 	}
 
-	PrintLocalIP();
-
 	if (listen(server_socket, max_connections) < 0) {
 		perror("Error: In CreateServerSocket(): listen() failed");
 		close(server_socket);
@@ -78,20 +104,599 @@ int CreateServerSocket(int port, int max_connections) {
 }
 
 int AcceptClient(int server_socket) {
-	int client_socket = accept(server_socket, NULL, NULL);
+	int client_socket =
+			accept4(server_socket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
 
 	if (!is_server_running) {
+		if (client_socket >= 0) {
+			close(client_socket);
+		}
 		return -1;
 	}
 
 	if (client_socket < 0) {
-		(void)fprintf(stderr, "Error: In AcceptClient(): accept() failed\n");
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			(void)fprintf(stderr, "Error: In AcceptClient(): accept() failed\n");
+		}
 		return -1;
 	}
 
 	return client_socket;
 }
 
+static int SetNonBlocking(int fd) {
+	int flags = fcntl(fd, F_GETFL, 0);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		perror("Error: In SetNonBlocking(): fcntl() failed");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void RaiseFileLimit() {
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+		perror("Error: In RaiseFileLimit(): getrlimit() failed");
+		return;
+	}
+
+	rlim_t wanted = (rlim_t)MAX_CONNECTIONS;
+	if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < wanted) {
+		wanted = limit.rlim_max;
+	}
+
+	if (limit.rlim_cur < wanted) {
+		limit.rlim_cur = wanted;
+		if (setrlimit(RLIMIT_NOFILE, &limit) != 0) {
+			perror("Error: In RaiseFileLimit(): setrlimit() failed");
+		}
+	}
+}
+
+// Waits for the next request, or with is_sending set for the socket to take
+// more of a response. A half-closed peer is not watched for while sending, as
+// it would be reported again on every re-arm.
+static int WatchConnection(Reactor* reactor,
+													 int client_socket,
+													 int op,
+													 int is_sending) {
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLET | EPOLLONESHOT;
+	event.events |= is_sending ? EPOLLOUT : EPOLLIN | EPOLLRDHUP;
+	event.data.fd = client_socket;
+
+	if (epoll_ctl(reactor->epoll_fd, op, client_socket, &event) < 0) {
+		perror("Error: In WatchConnection(): epoll_ctl() failed");
+		return -1;
+	}
+
+	return 0;
+}
+
+// Takes a connection off the idle list of its reactor, whose lock is held.
+static void DetachIdle(Reactor* reactor, Connection* connection) {
+	if (!connection->is_idle) {
+		return;
+	}
+
+	if (connection->idle_prev != NULL) {
+		connection->idle_prev->idle_next = connection->idle_next;
+	} else {
+		reactor->idle_head = connection->idle_next;
+	}
+
+	if (connection->idle_next != NULL) {
+		connection->idle_next->idle_prev = connection->idle_prev;
+	} else {
+		reactor->idle_tail = connection->idle_prev;
+	}
+
+	connection->is_idle = 0;
+	connection->idle_prev = NULL;
+	connection->idle_next = NULL;
+}
+
+// Moves a connection the reactor owns to the tail of its idle list, which is
+// thereby kept ordered by last_active.
+static void TouchConnection(Reactor* reactor, Connection* connection) {
+	if (pthread_mutex_lock(&reactor->idle_lock) != 0) {
+		perror("Error: In TouchConnection(): pthread_mutex_lock() failed");
+		return;
+	}
+
+	DetachIdle(reactor, connection);
+
+	connection->last_active = GetMonotonicTime();
+	connection->is_idle = 1;
+	connection->idle_prev = reactor->idle_tail;
+
+	if (reactor->idle_tail != NULL) {
+		reactor->idle_tail->idle_next = connection;
+	} else {
+		reactor->idle_head = connection;
+	}
+	reactor->idle_tail = connection;
+
+	if (pthread_mutex_unlock(&reactor->idle_lock) != 0) {
+		perror("Error: In TouchConnection(): pthread_mutex_unlock() failed");
+	}
+}
+
+// Takes a connection off the idle list of its reactor once the reactor hands
+// it on. Only the owner of the connection may call this, as is_idle is read
+// without the lock.
+static void UnlinkConnection(Connection* connection) {
+	Reactor* reactor = connection->reactor;
+	if (reactor == NULL || !connection->is_idle) {
+		return;
+	}
+
+	if (pthread_mutex_lock(&reactor->idle_lock) != 0) {
+		perror("Error: In UnlinkConnection(): pthread_mutex_lock() failed");
+		return;
+	}
+
+	DetachIdle(reactor, connection);
+
+	if (pthread_mutex_unlock(&reactor->idle_lock) != 0) {
+		perror("Error: In UnlinkConnection(): pthread_mutex_unlock() failed");
+	}
+}
+
+static void AcceptClients(Reactor* reactor) {
+	while (is_server_running) {
+		int client_socket = AcceptClient(reactor->server_socket);
+		if (client_socket < 0) {
+			return;
+		}
+
+		Connection* connection = CreateConnection(client_socket);
+		if (connection == NULL) {
+			close(client_socket);
+			continue;
+		}
+
+		connection->reactor = reactor;
+
+		if (RegisterConnection(connection) < 0) {
+			FreeConnection(connection);
+			close(client_socket);
+			continue;
+		}
+
+		TouchConnection(reactor, connection);
+
+		if (WatchConnection(reactor, client_socket, EPOLL_CTL_ADD, 0) < 0) {
+			CloseConnection(client_socket);
+		}
+	}
+}
+
+// Sends as much of the queued output of a connection as the socket takes
+// without blocking. Returns 0 once all of it has been sent, 1 if the rest has
+// to wait for the socket to become writable, -1 on error.
+static int SendOutput(Connection* connection) {
+	while (connection->pending_length > 0) {
+		int count = BuildOutputVector(connection);
+		if (count <= 0) {
+			return -1;
+		}
+
+		struct msghdr message = {0};
+		message.msg_iov = connection->iov;
+		message.msg_iovlen = (size_t)((count < IOV_MAX) ? count : IOV_MAX);
+
+		ssize_t written =
+				sendmsg(connection->fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return 1;
+			}
+
+			perror("Error: In SendOutput(): sendmsg() failed");
+			return -1;
+		}
+
+		ConsumeOutput(connection, (size_t)written);
+	}
+
+	return 0;
+}
+
+// Prepares a connection whose response has been sent in full for its next
+// request. Returns 1 if that request is already buffered, 0 if it has yet to
+// arrive, or -1 if the connection has been closed.
+static int FinishResponse(Connection* connection) {
+	if (!connection->keep_alive) {
+		CloseConnection(connection->fd);
+		return -1;
+	}
+
+	ResetConnection(connection);
+	return IsRequestComplete(connection);
+}
+
+// Passes a connection with a complete request on to the Workers.
+static void HandOverConnection(Reactor* reactor, Connection* connection) {
+	UnlinkConnection(connection);
+	__atomic_store_n(&connection->is_processing, 1, __ATOMIC_RELEASE);
+
+	if (SubmitConnection(reactor->pool, connection) != 0) {
+		CloseConnection(connection->fd);
+	}
+}
+
+// Carries on with a response a Worker could not send in full.
+static void ResumeSend(Reactor* reactor, Connection* connection) {
+	int client_socket = connection->fd;
+
+	int status = SendOutput(connection);
+	if (status < 0) {
+		CloseConnection(client_socket);
+		return;
+	}
+
+	if (status > 0) {
+		TouchConnection(reactor, connection);
+		if (WatchConnection(reactor, client_socket, EPOLL_CTL_MOD, 1) < 0) {
+			CloseConnection(client_socket);
+		}
+		return;
+	}
+
+	status = FinishResponse(connection);
+	if (status < 0) {
+		return;
+	}
+
+	if (status == 0) {
+		TouchConnection(reactor, connection);
+		if (WatchConnection(reactor, client_socket, EPOLL_CTL_MOD, 0) < 0) {
+			CloseConnection(client_socket);
+		}
+		return;
+	}
+
+	HandOverConnection(reactor, connection);
+}
+
+static void HandleClientEvent(Reactor* reactor, int client_socket) {
+	Connection* connection = GetConnection(client_socket);
+	if (connection == NULL) {
+		return;
+	}
+
+	// Pairs with the release store in ReleaseConnection(), so that everything
+	// the last Worker did to the connection is visible here.
+	if (__atomic_load_n(&connection->is_processing, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+
+	if (connection->pending_length > 0) {
+		ResumeSend(reactor, connection);
+		return;
+	}
+
+	int status = ReadConnection(connection);
+	if (status < 0) {
+		CloseConnection(client_socket);
+		return;
+	}
+
+	if (!IsRequestComplete(connection)) {
+		TouchConnection(reactor, connection);
+		if (status == 0 ||
+				WatchConnection(reactor, client_socket, EPOLL_CTL_MOD, 0) < 0) {
+			CloseConnection(client_socket);
+		}
+		return;
+	}
+
+	HandOverConnection(reactor, connection);
+}
+
+static void CloseIdleConnections(Reactor* reactor) {
+	time_t now = GetMonotonicTime();
+	if (now == reactor->last_sweep) {
+		return;
+	}
+	reactor->last_sweep = now;
+
+	// The idle list is ordered by last_active, so the sweep stops at the first
+	// connection that has not timed out. Connections owned by a Worker are not
+	// on it.
+	while (1) {
+		if (pthread_mutex_lock(&reactor->idle_lock) != 0) {
+			perror("Error: In CloseIdleConnections(): pthread_mutex_lock() failed");
+			return;
+		}
+
+		Connection* connection = reactor->idle_head;
+		if (connection != NULL &&
+				(size_t)(now - connection->last_active) >= KEEP_ALIVE_TIMEOUT) {
+			DetachIdle(reactor, connection);
+		} else {
+			connection = NULL;
+		}
+
+		if (pthread_mutex_unlock(&reactor->idle_lock) != 0) {
+			perror(
+					"Error: In CloseIdleConnections(): pthread_mutex_unlock() failed");
+		}
+
+		if (connection == NULL) {
+			return;
+		}
+
+		CloseConnection(connection->fd);
+	}
+}
+
+int InitReactor(Reactor* reactor,
+								int server_socket,
+								struct ThreadPool* pool) {
+	if (reactor == NULL || pool == NULL) {
+		(void)fprintf(stderr, "Error: In InitReactor(): Invalid arguments\n");
+		return -1;
+	}
+
+	if (InitConnectionTable() < 0) {
+		return -1;
+	}
+
+	if (SetNonBlocking(server_socket) < 0) {
+		return -1;
+	}
+
+	reactor->server_socket = server_socket;
+	reactor->pool = pool;
+	reactor->last_sweep = GetMonotonicTime();
+	reactor->idle_head = NULL;
+	reactor->idle_tail = NULL;
+
+	if (pthread_mutex_init(&reactor->idle_lock, NULL) != 0) {
+		perror("Error: In InitReactor(): pthread_mutex_init() failed");
+		return -1;
+	}
+
+	reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (reactor->epoll_fd < 0) {
+		perror("Error: In InitReactor(): epoll_create1() failed");
+		return -1;
+	}
+
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLET;
+	event.data.fd = server_socket;
+
+	if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, server_socket, &event) < 0) {
+		perror("Error: In InitReactor(): epoll_ctl() failed");
+		close(reactor->epoll_fd);
+		reactor->epoll_fd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+void RunReactor(Reactor* reactor) {
+	struct epoll_event events[MAX_EVENTS];
+
+	while (is_server_running) {
+		int num_events = epoll_wait(
+				reactor->epoll_fd, events, (int)MAX_EVENTS, REACTOR_TIMEOUT_MS);
+
+		if (num_events < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("Error: In RunReactor(): epoll_wait() failed");
+			break;
+		}
+
+		for (int i = 0; i < num_events && is_server_running; i++) {
+			if (events[i].data.fd == reactor->server_socket) {
+				AcceptClients(reactor);
+			} else {
+				HandleClientEvent(reactor, events[i].data.fd);
+			}
+		}
+
+		CloseIdleConnections(reactor);
+	}
+}
+
+int InitConnectionTable() {
+	if (connections != NULL) {
+		return 0;
+	}
+
+	connections = (Connection**)calloc(MAX_CONNECTIONS, sizeof(Connection*));
+	if (connections == NULL) {
+		perror("Error: In InitConnectionTable(): calloc() failed");
+		return -1;
+	}
+
+	RaiseFileLimit();
+	return 0;
+}
+
+Connection* GetConnection(int client_socket) {
+	if (connections == NULL || client_socket < 0 ||
+			(size_t)client_socket >= MAX_CONNECTIONS) {
+		return NULL;
+	}
+
+	return connections[client_socket];
+}
+
+int RegisterConnection(Connection* connection) {
+	if (connections == NULL || connection->fd < 0 ||
+			(size_t)connection->fd >= MAX_CONNECTIONS) {
+		(void)fprintf(stderr,
+									"Error: In RegisterConnection(): Too many connections\n");
+		return -1;
+	}
+
+	if (pthread_mutex_lock(&connections_lock) != 0) {
+		perror("Error: In RegisterConnection(): pthread_mutex_lock() failed");
+		return -1;
+	}
+
+	connections[connection->fd] = connection;
+
+	if (pthread_mutex_unlock(&connections_lock) != 0) {
+		perror("Error: In RegisterConnection(): pthread_mutex_unlock() failed");
+	}
+
+	return 0;
+}
+
+static Connection* RemoveConnection(int client_socket) {
+	if (GetConnection(client_socket) == NULL) {
+		return NULL;
+	}
+
+	if (pthread_mutex_lock(&connections_lock) != 0) {
+		perror("Error: In RemoveConnection(): pthread_mutex_lock() failed");
+		return NULL;
+	}
+
+	Connection* connection = connections[client_socket];
+	connections[client_socket] = NULL;
+
+	if (pthread_mutex_unlock(&connections_lock) != 0) {
+		perror("Error: In RemoveConnection(): pthread_mutex_unlock() failed");
+	}
+
+	return connection;
+}
+
+void UnregisterConnection(int client_socket) {
+	(void)RemoveConnection(client_socket);
+}
+
+void CloseConnection(int client_socket) {
+	// The slot must be released before close(), as the descriptor number may be
+	// handed out by accept() again as soon as it is closed.
+	Connection* connection = RemoveConnection(client_socket);
+	if (connection == NULL) {
+		return;
+	}
+
+	UnlinkConnection(connection);
+	FreeConnection(connection);
+
+	if (close(client_socket) < 0) {
+		perror("Error: In CloseConnection(): close() failed");
+	}
+}
+
+int ReleaseConnection(int client_socket) {
+	Connection* connection = GetConnection(client_socket);
+	if (connection == NULL) {
+		return 0;
+	}
+
+	if (connection->ring != NULL) {
+		SubmitRingResponse(connection);
+		return 0;
+	}
+
+	// A client that does not read its response must not hold on to the
+	// Worker, so the reactor sends the rest once the socket is writable, and
+	// closes the connection if that takes longer than KEEP_ALIVE_TIMEOUT.
+	int is_sending = SendOutput(connection);
+	if (is_sending < 0) {
+		CloseConnection(client_socket);
+		return 0;
+	}
+
+	if (!is_sending) {
+		int status = FinishResponse(connection);
+		if (status != 0) {
+			return status > 0;
+		}
+	}
+
+	// Once is_processing is cleared the reactor may close the connection, so it
+	// must not be touched afterwards.
+	Reactor* reactor = connection->reactor;
+	TouchConnection(reactor, connection);
+	__atomic_store_n(&connection->is_processing, 0, __ATOMIC_RELEASE);
+
+	if (WatchConnection(reactor, client_socket, EPOLL_CTL_MOD, is_sending) < 0) {
+		CloseConnection(client_socket);
+	}
+
+	return 0;
+}
+
+int FlushConnection(Connection* connection) {
+	// The Worker owns the connection, so no send of the io_uring backend can be
+	// in flight on it either.
+	int status = SendOutput(connection);
+	if (status == 0) {
+		DiscardOutput(connection);
+	}
+
+	return status;
+}
+
+time_t GetMonotonicTime() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec;
+}
+
+uint64_t GetMonotonicTimeNs() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+void CleanupReactor(Reactor* reactor) {
+	if (reactor == NULL) {
+		return;
+	}
+
+	if (reactor->epoll_fd >= 0 && close(reactor->epoll_fd) < 0) {
+		perror("Error: In CleanupReactor(): close() failed");
+	}
+	reactor->epoll_fd = -1;
+
+	// The connections are closed later by CloseAllConnections(), which must not
+	// take the lock any more.
+	while (reactor->idle_head != NULL) {
+		DetachIdle(reactor, reactor->idle_head);
+	}
+
+	if (pthread_mutex_destroy(&reactor->idle_lock) != 0) {
+		perror("Error: In CleanupReactor(): pthread_mutex_destroy() failed");
+	}
+}
+
+void CloseAllConnections() {
+	if (connections == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+		CloseConnection((int)i);
+	}
+
+	free(connections);
+	connections = NULL;
+}
+
 int CloseServerSocket(int server_fd) {
 	if (close(server_fd) < 0) {
 		perror("Error: In CloseServerSocket(): close() failed");
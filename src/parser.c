@@ -1,85 +1,361 @@
 #include "parser.h"
 
+#include <ctype.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #include "common.h"
+#include "scan.h"
+
+// Position of the request parser within the request line and the headers.
+typedef enum {
+	PARSE_METHOD,					 // Inside the method
+	PARSE_BEFORE_PATH,		 // Spaces between method and path
+	PARSE_PATH,						 // Inside the path
+	PARSE_BEFORE_VERSION,	 // Spaces between path and version
+	PARSE_VERSION,				 // Inside the version
+	PARSE_LINE_TAIL,			 // Anything after the version, up to CR or LF
+	PARSE_LINE_LF,				 // CR seen, LF expected
+	PARSE_HEADER_START,		 // At the start of a header line
+	PARSE_HEADER_NAME,		 // Inside a header name
+	PARSE_HEADER_VALUE,		 // Between the colon and the end of a header line
+	PARSE_HEADER_LF,			 // CR of a header line seen, LF expected
+	PARSE_END_LF,					 // CR of the empty line seen, LF expected
+	PARSE_BODY,						 // Past the empty line
+} ParseState;
+
+// Names of the well-known headers, indexed by HeaderID.
+static const char* const KNOWN_HEADER_NAMES[NUM_KNOWN_HEADERS] = {
+		"Content-Length",
+		"Content-Type",
+		"Connection",
+		"Accept-Encoding",
+		"If-None-Match",
+		"Host",
+		"Transfer-Encoding",
+		"Expect",
+};
+
+// Well-known headers by HeaderSlot() of their name. Adding a header requires
+// a name that hashes to a free slot.
+static const HeaderID HEADER_SLOTS[16] = {
+		HEADER_ACCEPT_ENCODING,
+		HEADER_CONTENT_LENGTH,
+		HEADER_OTHER,
+		HEADER_OTHER,
+		HEADER_OTHER,
+		HEADER_TRANSFER_ENCODING,
+		HEADER_IF_NONE_MATCH,
+		HEADER_OTHER,
+		HEADER_OTHER,
+		HEADER_OTHER,
+		HEADER_OTHER,
+		HEADER_EXPECT,
+		HEADER_HOST,
+		HEADER_CONNECTION,
+		HEADER_OTHER,
+		HEADER_CONTENT_TYPE,
+};
+
+static size_t HeaderSlot(const char* name, size_t length) {
+	return ((size_t)tolower((unsigned char)name[0]) + length) & 15;
+}
 
-HTTPRequest* ParseHTTPRequest(const char* raw_request) {
-	if (raw_request == NULL) {
-		perror("Error: In ParseHTTPRequest(): raw_request is NULL");
-		return NULL;
+static StringView MakeView(const char* data, size_t start, size_t end) {
+	StringView view = {data + start, end - start};
+	return view;
+}
+
+static void AddHeader(HTTPRequest* request,
+											StringView name,
+											const char* value,
+											const char* value_end) {
+	while (value < value_end && (*value == ' ' || *value == '\t')) {
+		value++;
+	}
+	while (value_end > value &&
+				 (value_end[-1] == ' ' || value_end[-1] == '\t')) {
+		value_end--;
 	}
 
-	HTTPRequest* request = calloc(1, sizeof(HTTPRequest));
-	if (request == NULL) {
-		return NULL;
+	StringView value_view = {value, (size_t)(value_end - value)};
+	HeaderID id = GetHeaderID(name.data, name.length);
+
+	if (id != HEADER_OTHER && request->known_headers[id].data == NULL) {
+		request->known_headers[id] = value_view;
 	}
 
-	const char* header_end = strstr(raw_request, "\r\n\r\n");
-	size_t header_len =
-			(header_end) ? (size_t)(header_end - raw_request) : strlen(raw_request);
+	if (request->num_headers < MAX_HEADERS) {
+		HTTPHeader* header = &request->header_index[request->num_headers];
+		header->name = name;
+		header->value = value_view;
+		header->id = id;
+	}
+	request->num_headers++;
+}
 
-	char* raw_request_copy = strndup(raw_request, header_len);
-	if (raw_request_copy == NULL) {
-		perror("Error: In ParseHTTPRequest(): strndup() failed");
-		free(request);
-		return NULL;
+int ParseHTTPRequest(const char* data, size_t length, HTTPRequest* request) {
+	if (data == NULL || request == NULL) {
+		(void)fprintf(stderr, "Error: In ParseHTTPRequest(): data is NULL\n");
+		return -1;
 	}
 
-	char* line = strtok(raw_request_copy, "\r\n");
-	if (line == NULL) {
-		perror("Error: In ParseHTTPRequest(): strtok() failed");
-		free(raw_request_copy);
-		free(request);
-		return NULL;
+	// The header index is only read up to num_headers, so it is not cleared.
+	memset(request, 0, offsetof(HTTPRequest, header_index));
+	request->num_headers = 0;
+	memset(request->known_headers, 0, sizeof(request->known_headers));
+
+	ParseState state = PARSE_METHOD;
+	size_t start = 0;
+	size_t name_end = 0;
+	size_t headers_start = 0;
+	size_t headers_end = 0;
+	size_t i = 0;
+
+	for (; i < length && state != PARSE_BODY; i++) {
+		// Bytes inside a token or a header line change nothing, so they are
+		// skipped a whole vector at a time.
+		if (state == PARSE_HEADER_NAME) {
+			i += FindDelimiter(data + i, length - i, &HEADER_DELIMITERS);
+		} else if (state == PARSE_HEADER_VALUE) {
+			i += FindDelimiter(data + i, length - i, &LINE_END_DELIMITERS);
+		} else if (state == PARSE_METHOD || state == PARSE_PATH ||
+							 state == PARSE_VERSION || state == PARSE_LINE_TAIL) {
+			i += FindDelimiter(data + i, length - i, &TOKEN_DELIMITERS);
+		}
+
+		if (i >= length) {
+			break;
+		}
+
+		char c = data[i];
+		int is_line_end = (c == '\r' || c == '\n');
+
+		// A line may end in CRLF or in a bare LF.
+		ParseState next_line = (c == '\r') ? PARSE_LINE_LF : PARSE_HEADER_START;
+
+		switch (state) {
+			case PARSE_METHOD:
+				if (c == ' ' && i > 0) {
+					request->method = MakeView(data, 0, i);
+					state = PARSE_BEFORE_PATH;
+				} else if (c == ' ' || is_line_end) {
+					return -1;
+				}
+				break;
+			case PARSE_BEFORE_PATH:
+				if (is_line_end) {
+					return -1;
+				}
+				if (c != ' ') {
+					start = i;
+					state = PARSE_PATH;
+				}
+				break;
+			case PARSE_PATH:
+				if (c == ' ' || is_line_end) {
+					request->path = MakeView(data, start, i);
+					state = is_line_end ? next_line : PARSE_BEFORE_VERSION;
+				}
+				break;
+			case PARSE_BEFORE_VERSION:
+				if (is_line_end) {
+					state = next_line;
+				} else if (c != ' ') {
+					start = i;
+					state = PARSE_VERSION;
+				}
+				break;
+			case PARSE_VERSION:
+				if (c == ' ' || is_line_end) {
+					request->version = MakeView(data, start, i);
+					state = is_line_end ? next_line : PARSE_LINE_TAIL;
+				}
+				break;
+			case PARSE_LINE_TAIL:
+				if (is_line_end) {
+					state = next_line;
+				}
+				break;
+			case PARSE_LINE_LF:
+			case PARSE_HEADER_LF:
+				if (c != '\n') {
+					return -1;
+				}
+				state = PARSE_HEADER_START;
+				break;
+			case PARSE_HEADER_START:
+				if (c == '\r') {
+					headers_end = i;
+					state = PARSE_END_LF;
+				} else if (c == '\n') {
+					headers_end = i;
+					state = PARSE_BODY;
+				} else if (c == ':') {
+					return -1;
+				} else {
+					start = i;
+					state = PARSE_HEADER_NAME;
+				}
+				break;
+			case PARSE_HEADER_NAME:
+				// A header line without a colon is malformed.
+				if (c == ':') {
+					name_end = i;
+					state = PARSE_HEADER_VALUE;
+				} else if (c == '\n') {
+					return -1;
+				}
+				break;
+			case PARSE_HEADER_VALUE:
+				if (is_line_end) {
+					AddHeader(request,
+										MakeView(data, start, name_end),
+										data + name_end + 1,
+										data + i);
+					state = (c == '\r') ? PARSE_HEADER_LF : PARSE_HEADER_START;
+				}
+				break;
+			case PARSE_END_LF:
+				if (c != '\n') {
+					return -1;
+				}
+				state = PARSE_BODY;
+				break;
+			case PARSE_BODY:
+				break;
+		}
+
+		// The header block starts right after the request line.
+		if (state == PARSE_HEADER_START && headers_start == 0) {
+			headers_start = i + 1;
+		}
 	}
 
-	char* method = strtok(line, " ");
-	if (method == NULL) {
-		perror("Error: In ParseHTTPRequest(): strtok() failed");
-		free(raw_request_copy);
-		free(request);
-		return NULL;
+	if (state != PARSE_BODY) {
+		return -1;
 	}
 
-	char* path = strtok(NULL, " ");
-	if (path == NULL) {
-		perror("Error: In ParseHTTPRequest(): strtok() failed");
-		free(raw_request_copy);
-		free(request);
-		return NULL;
+	request->headers = MakeView(data, headers_start, headers_end);
+	request->body = MakeView(data, i, length);
+
+	return 0;
+}
+
+HeaderID GetHeaderID(const char* name, size_t length) {
+	if (length == 0) {
+		return HEADER_OTHER;
 	}
 
-	if (method != NULL) {
-		request->method = strdup(method);
-		if (request->method == NULL) {
-			perror("Error: In ParseHTTPRequest(): strdup() failed");
-			free(raw_request_copy);
-			free(request);
-			return NULL;
+	HeaderID id = HEADER_SLOTS[HeaderSlot(name, length)];
+	if (id == HEADER_OTHER || strlen(KNOWN_HEADER_NAMES[id]) != length ||
+			strncasecmp(name, KNOWN_HEADER_NAMES[id], length) != 0) {
+		return HEADER_OTHER;
+	}
+
+	return id;
+}
+
+// Scans the raw header block, for headers beyond the index.
+static int FindHTTPHeader(const HTTPRequest* request,
+													const char* name,
+													StringView* value) {
+	size_t name_length = strlen(name);
+	const char* line = request->headers.data;
+	const char* end = line + request->headers.length;
+
+	while (line < end) {
+		size_t line_length = (size_t)(end - line);
+		size_t name_end = FindDelimiter(line, line_length, &HEADER_DELIMITERS);
+
+		const char* line_end =
+				memchr(line + name_end, '\n', line_length - name_end);
+		if (line_end == NULL) {
+			line_end = end;
 		}
+
+		if (name_end == name_length && name_end < line_length &&
+				line[name_end] == ':' && strncasecmp(line, name, name_length) == 0) {
+			const char* start = line + name_end + 1;
+			const char* stop = line_end;
+			while (start < stop && (*start == ' ' || *start == '\t')) {
+				start++;
+			}
+			while (stop > start && (stop[-1] == '\r' || stop[-1] == ' ' ||
+															stop[-1] == '\t')) {
+				stop--;
+			}
+
+			value->data = start;
+			value->length = (size_t)(stop - start);
+			return 1;
+		}
+
+		line = line_end + 1;
 	}
 
-	request->path = strdup(path);
-	if (request->path == NULL) {
-		perror("Error: In ParseHTTPRequest(): strdup() failed");
-		free(raw_request_copy);
-		free(request);
-		return NULL;
+	return 0;
+}
+
+int GetHTTPHeader(const HTTPRequest* request,
+									const char* name,
+									StringView* value) {
+	size_t name_length = strlen(name);
+
+	HeaderID id = GetHeaderID(name, name_length);
+	if (id != HEADER_OTHER) {
+		return GetKnownHTTPHeader(request, id, value);
+	}
+
+	size_t num_indexed = request->num_headers;
+	if (num_indexed > MAX_HEADERS) {
+		num_indexed = MAX_HEADERS;
+	}
+
+	for (size_t i = 0; i < num_indexed; i++) {
+		const HTTPHeader* header = &request->header_index[i];
+		if (header->name.length == name_length &&
+				strncasecmp(header->name.data, name, name_length) == 0) {
+			*value = header->value;
+			return 1;
+		}
 	}
 
-	request->headers =
-			strndup(raw_request + strlen(line) + 2, header_len - strlen(line) - 2);
+	if (request->num_headers > MAX_HEADERS) {
+		return FindHTTPHeader(request, name, value);
+	}
+
+	return 0;
+}
+
+int GetKnownHTTPHeader(const HTTPRequest* request,
+											 HeaderID id,
+											 StringView* value) {
+	if (id < 0 || id >= NUM_KNOWN_HEADERS ||
+			request->known_headers[id].data == NULL) {
+		return 0;
+	}
+
+	*value = request->known_headers[id];
+	return 1;
+}
+
+int GetHTTPMinorVersion(const HTTPRequest* request) {
+	// Requests without a version predate HTTP/1.1.
+	const StringView* version = &request->version;
+	if (version->length == 0) {
+		return 0;
+	}
 
-	if (header_end != NULL) {
-		request->body = strdup(header_end + 4);
+	if (version->length != 8 || memcmp(version->data, "HTTP/1.", 7) != 0 ||
+			!isdigit((unsigned char)version->data[7])) {
+		return -1;
 	}
 
-	free(raw_request_copy);
-	return request;
+	return version->data[7] - '0';
 }
 
 void FreeHTTPRequest(HTTPRequest* request) {
@@ -87,46 +363,33 @@ void FreeHTTPRequest(HTTPRequest* request) {
 		return;
 	}
 
-	free(request->method);
-	free(request->path);
-	free(request->headers);
-	free(request->body);
-	free(request);
+	memset(request, 0, sizeof(HTTPRequest));
 }
 
-HTTPResponse* CreateHTTPResponse(int status_code,
-																 const char* headers,
-																 const char* body) {
-	HTTPResponse* response = (HTTPResponse*)malloc(sizeof(HTTPResponse));
+HTTPResponse* CreateHTTPResponse(Arena* arena,
+																 int status_code,
+																 const char* body,
+																 size_t body_length,
+																 int owns_body) {
+	HTTPResponse* response =
+			(arena != NULL)
+					? (HTTPResponse*)ArenaAllocate(arena, sizeof(HTTPResponse))
+					: (HTTPResponse*)malloc(sizeof(HTTPResponse));
 	if (response == NULL) {
-		perror("Error: In CreateHTTPResponse(): malloc() failed");
+		(void)fprintf(stderr, "Error: In CreateHTTPResponse(): Out of memory\n");
+		if (owns_body) {
+			free((char*)body);
+		}
 		return NULL;
 	}
 
 	response->status_code = status_code;
-
-	if (headers != NULL) {
-		response->headers = strdup(headers);
-		if (response->headers == NULL) {
-			perror("Error: In CreateHTTPResponse(): strdup() failed");
-			free(response);
-			return NULL;
-		}
-	} else {
-		response->headers = NULL;
-	}
-
-	if (body != NULL) {
-		response->body = strdup(body);
-		if (response->body == NULL) {
-			perror("Error: In CreateHTTPResponse(): strdup() failed");
-			free(response->headers);
-			free(response);
-			return NULL;
-		}
-	} else {
-		response->body = NULL;
-	}
+	response->headers = NULL;
+	response->body = (char*)body;
+	response->body_length = body_length;
+	response->owns_body = owns_body;
+	response->arena = arena;
+	response->is_static = 0;
 
 	return response;
 }
@@ -144,7 +407,9 @@ HTTPResponse* ParseHTTPResponse(const char* raw_response) {
 	}
 	memset(response, 0, sizeof(HTTPResponse));
 
-	char* line_end = strstr(raw_response, "\r\n");
+	size_t length = strlen(raw_response);
+
+	const char* line_end = FindSequence(raw_response, length, "\r\n", 2);
 	if (line_end == NULL) {
 		perror(
 				"Error: In ParseHTTPResponse(): Invalid response format (no header "
@@ -171,7 +436,7 @@ HTTPResponse* ParseHTTPResponse(const char* raw_response) {
 	response->status_code = status_code;
 	free(status_line);
 
-	char* header_end = strstr(raw_response, "\r\n\r\n");
+	const char* header_end = FindSequence(raw_response, length, "\r\n\r\n", 4);
 	if (header_end == NULL) {
 		perror("Error: In ParseHTTPResponse(): No headers end found");
 		free(response);
@@ -194,20 +459,25 @@ HTTPResponse* ParseHTTPResponse(const char* raw_response) {
 		free(response);
 		return NULL;
 	}
+	response->body_length = strlen(response->body);
+	response->owns_body = 1;
 
 	return response;
 }
 
 void FreeHTTPResponse(HTTPResponse* response) {
-	if (response != NULL) {
+	if (response != NULL && !response->is_static) {
 		if (response->headers != NULL) {
 			free(response->headers);
 		}
-		if (response->body != NULL) {
+		if (response->owns_body) {
 			free(response->body);
 		}
 
-		free(response);
+		// Responses in an arena go away when it is reset.
+		if (response->arena == NULL) {
+			free(response);
+		}
 	}
 }
 
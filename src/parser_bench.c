@@ -0,0 +1,147 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+#include "network.h"
+#include "parser.h"
+#include "scan.h"
+
+static const char* const REQUESTS[] = {
+		"GET /?roll_num=23K-0760 HTTP/1.1\r\n"
+		"Host: 127.0.0.1:8080\r\n"
+		"User-Agent: curl/8.5.0\r\n"
+		"Accept: */*\r\n"
+		"\r\n",
+
+		"POST / HTTP/1.1\r\n"
+		"Host: 127.0.0.1:8080\r\n"
+		"User-Agent: curl/8.5.0\r\n"
+		"Accept: */*\r\n"
+		"Content-Type: application/json\r\n"
+		"Content-Length: 58\r\n"
+		"\r\n"
+		"{\"roll_num\": \"23K-0760\", \"name\": \"Muhammad Abd-Ur-Rahman\"}",
+
+		"GET /?roll_num=23K-0760 HTTP/1.1\r\n"
+		"Host: www.example.com:8080\r\n"
+		"Connection: keep-alive\r\n"
+		"Cache-Control: max-age=0\r\n"
+		"Upgrade-Insecure-Requests: 1\r\n"
+		"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, "
+		"like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+		"Accept: "
+		"text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/"
+		"webp,image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+		"Accept-Encoding: gzip, deflate, br\r\n"
+		"Accept-Language: en-US,en;q=0.9\r\n"
+		"Cookie: session=0123456789abcdef0123456789abcdef; theme=dark; "
+		"tracking=ffffffffffffffffffffffffffffffff\r\n"
+		"\r\n",
+};
+
+static const size_t NUM_REQUESTS = sizeof(REQUESTS) / sizeof(REQUESTS[0]);
+
+static const size_t DEFAULT_ITERATIONS = 1000000;
+
+// Does the work of the server per request: find the end of the header block,
+// parse the request, look up headers and tokenize the JSON body.
+static size_t ParseAll(const size_t* lengths, size_t iterations) {
+	size_t checksum = 0;
+
+	for (size_t i = 0; i < iterations; i++) {
+		for (size_t j = 0; j < NUM_REQUESTS; j++) {
+			const char* header_end =
+					FindSequence(REQUESTS[j], lengths[j], "\r\n\r\n", 4);
+
+			HTTPRequest request;
+			if (header_end == NULL ||
+					ParseHTTPRequest(REQUESTS[j], lengths[j], &request) < 0) {
+				(void)fprintf(stderr,
+											"Error: In ParseAll(): Request %zu is invalid\n",
+											j);
+				exit(EXIT_FAILURE);
+			}
+
+			StringView value;
+			if (GetKnownHTTPHeader(&request, HEADER_CONTENT_LENGTH, &value)) {
+				checksum += value.length;
+			}
+			if (GetHTTPHeader(&request, "Cookie", &value)) {
+				checksum += value.length;
+			}
+			checksum += request.headers.length + request.body.length;
+
+			if (request.body.length > 0) {
+				JSONTokenizer tokenizer;
+				JSONToken token;
+				InitJSONTokenizer(&tokenizer, request.body.data, request.body.length);
+				while (NextJSONToken(&tokenizer, &token) != JSON_END) {
+					if (token.type == JSON_ERROR) {
+						(void)fprintf(stderr,
+													"Error: In ParseAll(): Body %zu is invalid\n",
+													j);
+						exit(EXIT_FAILURE);
+					}
+					checksum += token.text.length;
+				}
+			}
+		}
+	}
+
+	return checksum;
+}
+
+int main(int argc, char* argv[]) {
+	size_t iterations = DEFAULT_ITERATIONS;
+	if (argc > 1) {
+		iterations = strtoul(argv[1], NULL, 10);
+		if (iterations == 0) {
+			(void)fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	size_t lengths[sizeof(REQUESTS) / sizeof(REQUESTS[0])];
+	size_t total_length = 0;
+	for (size_t j = 0; j < NUM_REQUESTS; j++) {
+		lengths[j] = strlen(REQUESTS[j]);
+		total_length += lengths[j];
+	}
+
+	(void)printf("Parsing %zu requests (%zu bytes) %zu times\n",
+							 NUM_REQUESTS,
+							 total_length,
+							 iterations);
+
+	ScanLevel levels[] = {SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2};
+
+	for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+		if (SetScanLevel(levels[i]) < 0) {
+			(void)printf("%-8s unsupported by this CPU\n",
+									 GetScanLevelName(levels[i]));
+			continue;
+		}
+
+		// One untimed round warms up the caches and the branch predictors.
+		(void)ParseAll(lengths, iterations / 10 + 1);
+
+		uint64_t start = GetMonotonicTimeNs();
+		volatile size_t checksum = ParseAll(lengths, iterations);
+		uint64_t elapsed = GetMonotonicTimeNs() - start;
+		(void)checksum;
+
+		double seconds = (double)elapsed / 1e9;
+		double num_parsed = (double)(iterations * NUM_REQUESTS);
+		(void)printf("%-8s %8.1f MB/s %12.0f requests/s %8.1f ns/request\n",
+								 GetScanLevelName(levels[i]),
+								 (double)(iterations * total_length) / seconds / 1e6,
+								 num_parsed / seconds,
+								 (double)elapsed / num_parsed);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+// src/parser_bench.c
\ No newline at end of file
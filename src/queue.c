@@ -1,84 +1,165 @@
 #include "queue.h"
 
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "common.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#else
+#define CPU_RELAX() ((void)0)
+#endif
+
+// Attempts on an empty queue before a Worker goes to sleep.
+static const int QUEUE_SPIN_COUNT = 64;
+
+// Sleeping Workers wake up this often to check is_server_running.
+static const time_t QUEUE_SLEEP_TIMEOUT_S = 1;
+
+static void FutexWait(unsigned int* word,
+											unsigned int expected,
+											const struct timespec* timeout) {
+	if (syscall(SYS_futex,
+							word,
+							FUTEX_WAIT_PRIVATE,
+							expected,
+							timeout,
+							NULL,
+							0) < 0 &&
+			errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT) {
+		perror("Error: In FutexWait(): futex() failed");
+	}
+}
+
+static void FutexWake(unsigned int* word, int count) {
+	if (syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0) <
+			0) {
+		perror("Error: In FutexWake(): futex() failed");
+	}
+}
+
+static void WakeSleepers(Queue* queue, int count) {
+	__atomic_add_fetch(&queue->wake_sequence, 1, __ATOMIC_SEQ_CST);
+	FutexWake(&queue->wake_sequence, count);
+}
+
+int TryDequeue(Queue* queue) {
+	size_t position =
+			__atomic_load_n(&queue->dequeue_position, __ATOMIC_RELAXED);
+
+	for (;;) {
+		QueueCell* cell = &queue->cells[position & queue->mask];
+		size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+		long difference = (long)(sequence - (position + 1));
+
+		if (difference == 0) {
+			if (__atomic_compare_exchange_n(&queue->dequeue_position,
+																			&position,
+																			position + 1,
+																			1,
+																			__ATOMIC_RELAXED,
+																			__ATOMIC_RELAXED)) {
+				int client_socket = cell->client_socket;
+				__atomic_store_n(
+						&cell->sequence, position + queue->mask + 1, __ATOMIC_RELEASE);
+				return client_socket;
+			}
+		} else if (difference < 0) {
+			return -1;
+		} else {
+			position = __atomic_load_n(&queue->dequeue_position, __ATOMIC_RELAXED);
+		}
+	}
+}
+
 void InitQueue(Queue* queue, int size) {
 	if (size <= 0) {
 		size = 1;
 	}
 
-	queue->queue = (int*)malloc(size * sizeof(int));
-	if (queue->queue == NULL) {
-		perror("Error: In InitQueue(): malloc() failed");
-		exit(EXIT_FAILURE);
+	size_t num_cells = 1;
+	while (num_cells < (size_t)size) {
+		num_cells *= 2;
 	}
 
-	queue->size = size;
-	queue->front = 0;
-	queue->rear = 0;
-	queue->count = 0;
+	memset(queue, 0, sizeof(Queue));
 
-	if (pthread_mutex_init(&queue->lock, NULL) != 0) {
-		perror("Error: In InitQueue(): pthread_mutex_init() failed");
-		free(queue->queue);
+	queue->cells = (QueueCell*)malloc(num_cells * sizeof(QueueCell));
+	if (queue->cells == NULL) {
+		perror("Error: In InitQueue(): malloc() failed");
 		exit(EXIT_FAILURE);
 	}
 
-	if (pthread_cond_init(&queue->cond, NULL) != 0) {
-		perror("Error: In InitQueue(): pthread_cond_init() failed");
-		if (pthread_mutex_destroy(&queue->lock) != 0) {
-			perror("Error: In InitQueue(): pthread_mutex_destroy() failed");
-		}
-		free(queue->queue);
-		exit(EXIT_FAILURE);
+	for (size_t i = 0; i < num_cells; i++) {
+		queue->cells[i].sequence = i;
+		queue->cells[i].client_socket = -1;
 	}
+
+	queue->mask = num_cells - 1;
 }
 
-void Enqueue(Queue* queue, int client_socket) {
+int Enqueue(Queue* queue, int client_socket) {
 	if (queue == NULL) {
 		(void)fprintf(stderr, "Error: In Enqueue(): queue is NULL\n");
-		return;
+		return -1;
 	}
 
 	if (client_socket < 0) {
 		(void)fprintf(stderr, "Error: In Enqueue(): client_socket is invalid\n");
-		return;
+		return -1;
 	}
 
-	if (queue->queue == NULL) {
+	if (queue->cells == NULL) {
 		(void)fprintf(stderr, "Error: In Enqueue(): queue is not initialized\n");
-		return;
+		return -1;
 	}
 
-	if (pthread_mutex_lock(&queue->lock) != 0) {
-		perror("Error: In Enqueue(): pthread_mutex_lock() failed");
-		return;
-	}
+	size_t position =
+			__atomic_load_n(&queue->enqueue_position, __ATOMIC_RELAXED);
+	QueueCell* cell = NULL;
 
-	if (queue->count == queue->size) {
-		perror("Error: In Enqueue(): Queue is full, dropping connection");
-		if (pthread_mutex_unlock(&queue->lock) != 0) {
-			perror("Error: In Enqueue(): pthread_mutex_unlock() failed");
+	for (;;) {
+		cell = &queue->cells[position & queue->mask];
+		size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+		long difference = (long)(sequence - position);
+
+		if (difference == 0) {
+			if (__atomic_compare_exchange_n(&queue->enqueue_position,
+																			&position,
+																			position + 1,
+																			1,
+																			__ATOMIC_RELAXED,
+																			__ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (difference < 0) {
+			(void)fprintf(stderr,
+										"Error: In Enqueue(): Queue is full, dropping connection\n");
+			return -1;
+		} else {
+			position = __atomic_load_n(&queue->enqueue_position, __ATOMIC_RELAXED);
 		}
-		return;
 	}
 
-	queue->queue[queue->rear] = client_socket;
-	queue->rear = (queue->rear + 1) % queue->size;
-	queue->count++;
+	cell->client_socket = client_socket;
+	__atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
 
-	if (pthread_cond_signal(&queue->cond) != 0) {
-		perror("Error: In Enqueue(): pthread_cond_signal() failed");
+	// Pairs with the increment of num_sleepers in Dequeue(): either the Worker
+	// sees the new socket, or this thread sees the Worker and wakes it.
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&queue->num_sleepers, __ATOMIC_RELAXED) > 0) {
+		WakeSleepers(queue, 1);
 	}
 
-	if (pthread_mutex_unlock(&queue->lock) != 0) {
-		perror("Error: In Enqueue(): pthread_mutex_unlock() failed");
-		return;
-	}
+	return 0;
 }
 
 int Dequeue(Queue* queue) {
@@ -87,61 +168,113 @@ int Dequeue(Queue* queue) {
 		return -1;
 	}
 
-	if (!is_server_running) {
-		return -1;
+	while (is_server_running) {
+		int client_socket = DequeueOrSteal(queue, NULL, NULL);
+		if (client_socket >= 0) {
+			return client_socket;
+		}
 	}
 
-	if (pthread_mutex_lock(&queue->lock) != 0) {
-		perror("Error: In Dequeue(): pthread_mutex_lock() failed");
-		return -1;
+	return -1;
+}
+
+static int TryDequeueOrSteal(Queue* queue,
+														 int (*steal)(void* arg),
+														 void* arg) {
+	int client_socket = TryDequeue(queue);
+	if (client_socket < 0 && steal != NULL) {
+		client_socket = steal(arg);
 	}
 
-	if (!is_server_running) {
-		pthread_mutex_unlock(&queue->lock);
+	return client_socket;
+}
+
+int DequeueOrSteal(Queue* queue, int (*steal)(void* arg), void* arg) {
+	if (queue == NULL) {
+		(void)fprintf(stderr, "Error: In DequeueOrSteal(): queue is NULL\n");
 		return -1;
 	}
 
-	while (queue->count == 0 && is_server_running) {
-		if (pthread_cond_wait(&queue->cond, &queue->lock) != 0) {
-			pthread_mutex_unlock(&queue->lock);
-			perror("Error: In Dequeue(): pthread_cond_wait() failed");
-			return -1;
+	for (int i = 0; i < QUEUE_SPIN_COUNT; i++) {
+		int client_socket = TryDequeueOrSteal(queue, steal, arg);
+		if (client_socket >= 0) {
+			return client_socket;
 		}
+		CPU_RELAX();
+	}
 
-		if (!is_server_running) {
-			pthread_mutex_unlock(&queue->lock);
-			return -1;
-		}
+	unsigned int wake_sequence =
+			__atomic_load_n(&queue->wake_sequence, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&queue->num_sleepers, 1, __ATOMIC_SEQ_CST);
+
+	int client_socket = TryDequeueOrSteal(queue, steal, arg);
+	if (client_socket < 0 && is_server_running) {
+		struct timespec timeout = {.tv_sec = QUEUE_SLEEP_TIMEOUT_S, .tv_nsec = 0};
+		FutexWait(&queue->wake_sequence, wake_sequence, &timeout);
+		client_socket = TryDequeueOrSteal(queue, steal, arg);
 	}
 
-	if (queue->count == 0) {
-		pthread_mutex_unlock(&queue->lock);
+	__atomic_sub_fetch(&queue->num_sleepers, 1, __ATOMIC_SEQ_CST);
+
+	return client_socket;
+}
+
+int DequeueWithTimeout(Queue* queue, uint64_t timeout) {
+	if (queue == NULL) {
+		(void)fprintf(stderr, "Error: In DequeueWithTimeout(): queue is NULL\n");
 		return -1;
 	}
 
-	int client_socket = queue->queue[queue->front];
-	queue->front = (queue->front + 1) % queue->size;
-	queue->count--;
+	unsigned int wake_sequence =
+			__atomic_load_n(&queue->wake_sequence, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&queue->num_sleepers, 1, __ATOMIC_SEQ_CST);
+
+	int client_socket = TryDequeue(queue);
+	if (client_socket < 0 && is_server_running && timeout > 0) {
+		struct timespec duration = {
+				.tv_sec = (time_t)(timeout / 1000000000ULL),
+				.tv_nsec = (long)(timeout % 1000000000ULL)};
+		FutexWait(&queue->wake_sequence, wake_sequence, &duration);
+		client_socket = TryDequeue(queue);
+	}
+
+	__atomic_sub_fetch(&queue->num_sleepers, 1, __ATOMIC_SEQ_CST);
 
-	pthread_mutex_unlock(&queue->lock);
 	return client_socket;
 }
 
-void CleanupQueue(Queue* queue) {
+size_t QueueLength(Queue* queue) {
+	size_t dequeue_position =
+			__atomic_load_n(&queue->dequeue_position, __ATOMIC_RELAXED);
+	size_t enqueue_position =
+			__atomic_load_n(&queue->enqueue_position, __ATOMIC_RELAXED);
+
+	return (enqueue_position > dequeue_position)
+						 ? enqueue_position - dequeue_position
+						 : 0;
+}
+
+int HasSleepers(Queue* queue) {
+	return __atomic_load_n(&queue->num_sleepers, __ATOMIC_SEQ_CST) > 0;
+}
+
+void WakeQueue(Queue* queue) {
 	if (queue == NULL) {
-		(void)fprintf(stderr, "Error: In CleanupQueue(): queue is NULL\n");
+		(void)fprintf(stderr, "Error: In WakeQueue(): queue is NULL\n");
 		return;
 	}
 
-	free(queue->queue);
+	WakeSleepers(queue, INT_MAX);
+}
 
-	if (pthread_mutex_destroy(&queue->lock) != 0) {
-		perror("Error: In CleanupQueue(): pthread_mutex_destroy() failed");
+void CleanupQueue(Queue* queue) {
+	if (queue == NULL) {
+		(void)fprintf(stderr, "Error: In CleanupQueue(): queue is NULL\n");
+		return;
 	}
 
-	if (pthread_cond_destroy(&queue->cond) != 0) {
-		perror("Error: In CleanupQueue(): pthread_cond_destroy() failed");
-	}
+	free(queue->cells);
+	queue->cells = NULL;
 }
 
-// src/queue.c
\ No newline at end of file
+// src/queue.c
@@ -0,0 +1,386 @@
+#include "record_cache.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of independently locked shards, a power of two.
+#define NUM_SHARDS 64
+
+// Number of buckets a shard starts with, doubled whenever it holds more
+// records than buckets.
+static const size_t MIN_BUCKETS = 16;
+
+typedef struct CacheEntry {
+	struct CacheEntry* next;				// Next entry in the same bucket (NULL-able)
+	struct CacheEntry* clock_prev;	// Previous entry on the clock
+	struct CacheEntry* clock_next;	// Next entry on the clock
+	uint64_t hash;									// Hash of the key
+	size_t size;										// Bytes charged to the shard
+	int is_referenced;							// Set by lookups, cleared by the clock hand
+	char* value;										// The value, stored after the key in data
+	char data[];										// The key and the value, NUL-terminated
+} CacheEntry;
+
+typedef struct {
+	pthread_rwlock_t lock;	// Read for lookups, write for changes
+	CacheEntry** buckets;		// Chains of entries, by the low bits of their hash
+	size_t num_buckets;			// Number of buckets, a power of two
+	size_t count;						// Number of entries
+	size_t size;						// Bytes charged by the entries
+	CacheEntry* hand;				// Entry the clock looks at next (NULL-able)
+	uint64_t generation;		// Incremented by every write to the database
+	uint64_t hits;					// Lookups that found their key
+	uint64_t misses;				// Lookups that did not
+	uint64_t evictions;			// Entries evicted to make room
+} CacheShard;
+
+static CacheShard* shards = NULL;
+static size_t shard_capacity = 0;
+
+// FNV-1a, which is fast on the short keys records have.
+static uint64_t HashKey(const char* key) {
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (const unsigned char* byte = (const unsigned char*)key; *byte != '\0';
+			 byte++) {
+		hash ^= *byte;
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+// The bucket takes the low bits of the hash, so the shard takes high ones.
+static CacheShard* GetShard(uint64_t hash) {
+	return &shards[(hash >> 32) & (NUM_SHARDS - 1)];
+}
+
+// Returns the link that points to the entry of key, which is NULL if the key
+// is not cached.
+static CacheEntry** FindEntry(CacheShard* shard,
+															const char* key,
+															uint64_t hash) {
+	CacheEntry** link = &shard->buckets[hash & (shard->num_buckets - 1)];
+
+	while (*link != NULL) {
+		if ((*link)->hash == hash && strcmp((*link)->data, key) == 0) {
+			break;
+		}
+		link = &(*link)->next;
+	}
+
+	return link;
+}
+
+static void RemoveEntry(CacheShard* shard, CacheEntry** link) {
+	CacheEntry* entry = *link;
+	*link = entry->next;
+
+	if (entry->clock_next == entry) {
+		shard->hand = NULL;
+	} else {
+		entry->clock_prev->clock_next = entry->clock_next;
+		entry->clock_next->clock_prev = entry->clock_prev;
+		if (shard->hand == entry) {
+			shard->hand = entry->clock_next;
+		}
+	}
+
+	shard->count--;
+	shard->size -= entry->size;
+	free(entry);
+}
+
+// Sweeps the clock hand until size more bytes fit into the shard. Entries
+// looked up since the last sweep get another round.
+static void EvictEntries(CacheShard* shard, size_t size) {
+	while (shard->hand != NULL && shard->size + size > shard_capacity) {
+		CacheEntry* entry = shard->hand;
+
+		if (__atomic_load_n(&entry->is_referenced, __ATOMIC_RELAXED)) {
+			__atomic_store_n(&entry->is_referenced, 0, __ATOMIC_RELAXED);
+			shard->hand = entry->clock_next;
+			continue;
+		}
+
+		RemoveEntry(shard, FindEntry(shard, entry->data, entry->hash));
+		shard->evictions++;
+	}
+}
+
+// Doubles the buckets of a shard. The shard keeps working with longer chains
+// if that fails.
+static void GrowBuckets(CacheShard* shard) {
+	size_t num_buckets = shard->num_buckets * 2;
+
+	CacheEntry** buckets = (CacheEntry**)calloc(num_buckets, sizeof(CacheEntry*));
+	if (buckets == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < shard->num_buckets; i++) {
+		CacheEntry* entry = shard->buckets[i];
+		while (entry != NULL) {
+			CacheEntry* next = entry->next;
+			CacheEntry** bucket = &buckets[entry->hash & (num_buckets - 1)];
+			entry->next = *bucket;
+			*bucket = entry;
+			entry = next;
+		}
+	}
+
+	free(shard->buckets);
+	shard->buckets = buckets;
+	shard->num_buckets = num_buckets;
+}
+
+// Adds or replaces the entry of key. The write lock of the shard is held.
+static void AddEntry(CacheShard* shard,
+										 const char* key,
+										 uint64_t hash,
+										 const char* value) {
+	CacheEntry** link = FindEntry(shard, key, hash);
+	if (*link != NULL) {
+		RemoveEntry(shard, link);
+	}
+
+	size_t key_length = strlen(key);
+	size_t value_length = strlen(value);
+	size_t size = sizeof(CacheEntry) + key_length + value_length + 2;
+	if (size > shard_capacity) {
+		return;
+	}
+
+	EvictEntries(shard, size);
+
+	CacheEntry* entry = (CacheEntry*)malloc(size);
+	if (entry == NULL) {
+		perror("Error: In AddEntry(): malloc() failed");
+		return;
+	}
+
+	memcpy(entry->data, key, key_length + 1);
+	entry->value = entry->data + key_length + 1;
+	memcpy(entry->value, value, value_length + 1);
+	entry->hash = hash;
+	entry->size = size;
+	entry->is_referenced = 0;
+
+	// A new entry goes right behind the hand, so it is looked at last.
+	if (shard->hand == NULL) {
+		entry->clock_prev = entry;
+		entry->clock_next = entry;
+		shard->hand = entry;
+	} else {
+		entry->clock_next = shard->hand;
+		entry->clock_prev = shard->hand->clock_prev;
+		entry->clock_prev->clock_next = entry;
+		shard->hand->clock_prev = entry;
+	}
+
+	if (shard->count >= shard->num_buckets) {
+		GrowBuckets(shard);
+	}
+
+	link = &shard->buckets[hash & (shard->num_buckets - 1)];
+	entry->next = *link;
+	*link = entry;
+
+	shard->count++;
+	shard->size += size;
+}
+
+void InitRecordCache(size_t capacity) {
+	if (capacity == 0) {
+		return;
+	}
+
+	shards = (CacheShard*)calloc(NUM_SHARDS, sizeof(CacheShard));
+	if (shards == NULL) {
+		perror("Error: In InitRecordCache(): calloc() failed");
+		exit(EXIT_FAILURE);
+	}
+
+	shard_capacity = capacity / NUM_SHARDS;
+
+	for (int i = 0; i < NUM_SHARDS; i++) {
+		CacheShard* shard = &shards[i];
+
+		if (pthread_rwlock_init(&shard->lock, NULL) != 0) {
+			perror("Error: In InitRecordCache(): pthread_rwlock_init() failed");
+			exit(EXIT_FAILURE);
+		}
+
+		shard->num_buckets = MIN_BUCKETS;
+		shard->buckets = (CacheEntry**)calloc(MIN_BUCKETS, sizeof(CacheEntry*));
+		if (shard->buckets == NULL) {
+			perror("Error: In InitRecordCache(): calloc() failed");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+int LookupRecord(const char* key,
+								 Arena* arena,
+								 char** value,
+								 uint64_t* generation) {
+	if (shards == NULL) {
+		*generation = 0;
+		return 0;
+	}
+
+	uint64_t hash = HashKey(key);
+	CacheShard* shard = GetShard(hash);
+
+	if (pthread_rwlock_rdlock(&shard->lock) != 0) {
+		perror("Error: In LookupRecord(): pthread_rwlock_rdlock() failed");
+		// The shard never gets this far, so the value is not inserted.
+		*generation = UINT64_MAX;
+		return 0;
+	}
+
+	int is_hit = 0;
+	CacheEntry* entry = *FindEntry(shard, key, hash);
+	if (entry != NULL) {
+		__atomic_store_n(&entry->is_referenced, 1, __ATOMIC_RELAXED);
+		*value = (arena != NULL)
+								 ? ArenaStrndup(arena, entry->value, strlen(entry->value))
+								 : strdup(entry->value);
+		is_hit = *value != NULL;
+	}
+	*generation = shard->generation;
+
+	if (pthread_rwlock_unlock(&shard->lock) != 0) {
+		perror("Error: In LookupRecord(): pthread_rwlock_unlock() failed");
+	}
+
+	__atomic_fetch_add(
+			is_hit ? &shard->hits : &shard->misses, 1, __ATOMIC_RELAXED);
+	return is_hit;
+}
+
+void InsertRecord(const char* key, const char* value, uint64_t generation) {
+	if (shards == NULL) {
+		return;
+	}
+
+	uint64_t hash = HashKey(key);
+	CacheShard* shard = GetShard(hash);
+
+	if (pthread_rwlock_wrlock(&shard->lock) != 0) {
+		perror("Error: In InsertRecord(): pthread_rwlock_wrlock() failed");
+		return;
+	}
+
+	if (shard->generation == generation) {
+		AddEntry(shard, key, hash, value);
+	}
+
+	if (pthread_rwlock_unlock(&shard->lock) != 0) {
+		perror("Error: In InsertRecord(): pthread_rwlock_unlock() failed");
+	}
+}
+
+void UpdateRecord(const char* key, const char* value) {
+	if (shards == NULL) {
+		return;
+	}
+
+	uint64_t hash = HashKey(key);
+	CacheShard* shard = GetShard(hash);
+
+	if (pthread_rwlock_wrlock(&shard->lock) != 0) {
+		perror("Error: In UpdateRecord(): pthread_rwlock_wrlock() failed");
+		return;
+	}
+
+	// Lookups that missed before this write may have read the old value.
+	shard->generation++;
+
+	if (value != NULL) {
+		AddEntry(shard, key, hash, value);
+	} else {
+		CacheEntry** link = FindEntry(shard, key, hash);
+		if (*link != NULL) {
+			RemoveEntry(shard, link);
+		}
+	}
+
+	if (pthread_rwlock_unlock(&shard->lock) != 0) {
+		perror("Error: In UpdateRecord(): pthread_rwlock_unlock() failed");
+	}
+}
+
+void PrintRecordCacheStats() {
+	if (shards == NULL) {
+		(void)printf("Record cache: disabled\n");
+		return;
+	}
+
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+	size_t count = 0;
+	size_t size = 0;
+
+	for (int i = 0; i < NUM_SHARDS; i++) {
+		CacheShard* shard = &shards[i];
+
+		if (pthread_rwlock_rdlock(&shard->lock) != 0) {
+			perror("Error: In PrintRecordCacheStats(): pthread_rwlock_rdlock() failed");
+			continue;
+		}
+
+		hits += __atomic_load_n(&shard->hits, __ATOMIC_RELAXED);
+		misses += __atomic_load_n(&shard->misses, __ATOMIC_RELAXED);
+		evictions += shard->evictions;
+		count += shard->count;
+		size += shard->size;
+
+		if (pthread_rwlock_unlock(&shard->lock) != 0) {
+			perror(
+					"Error: In PrintRecordCacheStats(): pthread_rwlock_unlock() failed");
+		}
+	}
+
+	(void)printf(
+			"Record cache: %llu hits, %llu misses, %llu evictions, %zu records in "
+			"%zu bytes\n",
+			(unsigned long long)hits,
+			(unsigned long long)misses,
+			(unsigned long long)evictions,
+			count,
+			size);
+}
+
+void CleanupRecordCache() {
+	if (shards == NULL) {
+		return;
+	}
+
+	for (int i = 0; i < NUM_SHARDS; i++) {
+		CacheShard* shard = &shards[i];
+
+		for (size_t j = 0; j < shard->num_buckets; j++) {
+			CacheEntry* entry = shard->buckets[j];
+			while (entry != NULL) {
+				CacheEntry* next = entry->next;
+				free(entry);
+				entry = next;
+			}
+		}
+
+		free(shard->buckets);
+
+		if (pthread_rwlock_destroy(&shard->lock) != 0) {
+			perror("Error: In CleanupRecordCache(): pthread_rwlock_destroy() failed");
+		}
+	}
+
+	free(shards);
+	shards = NULL;
+}
+
+// src/record_cache.c
\ No newline at end of file
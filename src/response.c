@@ -0,0 +1,318 @@
+#include "response.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+#include "network.h"
+
+// Size of the first body block, doubled for every block after it.
+static const size_t MIN_BLOCK_SIZE = 1024;
+
+// Blocks stop doubling at this size, so that a large body does not reserve
+// as much again in its last block.
+static const size_t MAX_BLOCK_SIZE = 64 * 1024;
+
+// A chunked response is sent as soon as this many bytes are queued on its
+// connection, so that a large body never waits in memory as a whole.
+static const size_t FLUSH_THRESHOLD = 64 * 1024;
+
+int FormatResponseHeaders(char* output,
+													size_t size,
+													int status_code,
+													const char* headers,
+													int is_chunked,
+													size_t body_length,
+													int keep_alive) {
+	const char* connection_value = keep_alive ? "keep-alive" : "close";
+	if (headers == NULL) {
+		headers = "";
+	}
+
+	if (is_chunked) {
+		return snprintf(output,
+										size,
+										"HTTP/1.1 %d\r\n"
+										"%s"
+										"Content-Type: application/json\r\n"
+										"Transfer-Encoding: chunked\r\n"
+										"Connection: %s\r\n"
+										"\r\n",
+										status_code,
+										headers,
+										connection_value);
+	}
+
+	return snprintf(output,
+									size,
+									"HTTP/1.1 %d\r\n"
+									"%s"
+									"Content-Type: application/json\r\n"
+									"Content-Length: %zu\r\n"
+									"Connection: %s\r\n"
+									"\r\n",
+									status_code,
+									headers,
+									body_length,
+									connection_value);
+}
+
+// Formats into the output buffer of the connection and queues the bytes.
+static int QueueHeaders(ResponseBuilder* builder) {
+	Connection* connection = builder->connection;
+
+	int length = FormatResponseHeaders(NULL,
+																		 0,
+																		 builder->status_code,
+																		 NULL,
+																		 builder->is_chunked,
+																		 builder->body_length,
+																		 connection->keep_alive);
+	if (length < 0) {
+		(void)fprintf(stderr, "Error: In QueueHeaders(): snprintf() failed\n");
+		return -1;
+	}
+
+	char* output = ReserveOutput(connection, (size_t)length);
+	if (output == NULL) {
+		return -1;
+	}
+
+	(void)FormatResponseHeaders(output,
+															(size_t)length + 1,
+															builder->status_code,
+															NULL,
+															builder->is_chunked,
+															builder->body_length,
+															connection->keep_alive);
+
+	return CommitOutput(connection, (size_t)length);
+}
+
+// Queues generated bytes, such as chunk framing, on the connection.
+static int QueueText(Connection* connection, const char* text) {
+	size_t length = strlen(text);
+
+	char* output = ReserveOutput(connection, length);
+	if (output == NULL) {
+		return -1;
+	}
+
+	memcpy(output, text, length);
+	return CommitOutput(connection, length);
+}
+
+// Queues the blocks held back so far, each as a chunk if the response is
+// chunked. The blocks stay in the arena until they have been sent.
+static int QueueBlocks(ResponseBuilder* builder) {
+	Connection* connection = builder->connection;
+
+	for (ResponseBlock* block = builder->pending; block != NULL;
+			 block = block->next) {
+		if (block->length == 0) {
+			continue;
+		}
+
+		if (builder->is_chunked) {
+			char size_line[32];
+			(void)snprintf(size_line, sizeof(size_line), "%zx\r\n", block->length);
+			if (QueueText(connection, size_line) < 0) {
+				return -1;
+			}
+		}
+
+		if (AppendOutput(connection, block->data, block->length, 0) < 0) {
+			return -1;
+		}
+
+		if (builder->is_chunked && QueueText(connection, "\r\n") < 0) {
+			return -1;
+		}
+	}
+
+	builder->pending = NULL;
+
+	return 0;
+}
+
+// Sends the queued chunks once they reach FLUSH_THRESHOLD. Every block has
+// been queued by then, and can be written into again once it has been sent.
+// A client that reads slowly leaves them queued, to be sent with the rest of
+// the response once the Worker has let go of the connection.
+static int FlushBlocks(ResponseBuilder* builder) {
+	if (builder->connection->pending_length < FLUSH_THRESHOLD) {
+		return 0;
+	}
+
+	int status = FlushConnection(builder->connection);
+	if (status != 0) {
+		return (status < 0) ? -1 : 0;
+	}
+
+	// Blocks stop growing at MAX_BLOCK_SIZE, so only blocks of that size are
+	// asked for again.
+	ResponseBlock* block = builder->head;
+	while (block != NULL) {
+		ResponseBlock* next = block->next;
+		if (block->capacity >= MAX_BLOCK_SIZE) {
+			block->next = builder->spare;
+			builder->spare = block;
+		}
+		block = next;
+	}
+
+	builder->head = NULL;
+	builder->tail = NULL;
+
+	return 0;
+}
+
+int BeginResponse(ResponseBuilder* builder,
+									Connection* connection,
+									int status_code,
+									int is_chunked) {
+	builder->connection = connection;
+	builder->status_code = status_code;
+	builder->is_chunked = is_chunked;
+	builder->has_failed = 0;
+	builder->head = NULL;
+	builder->pending = NULL;
+	builder->tail = NULL;
+	builder->spare = NULL;
+	builder->last_capacity = 0;
+	builder->body_length = 0;
+
+	if (is_chunked && QueueHeaders(builder) < 0) {
+		builder->has_failed = 1;
+		return -1;
+	}
+
+	return 0;
+}
+
+static ResponseBlock* AddBlock(ResponseBuilder* builder, size_t length) {
+	// A chunked response queues what it has before starting the next block,
+	// and sends it once enough has piled up.
+	if (builder->is_chunked &&
+			(QueueBlocks(builder) < 0 || FlushBlocks(builder) < 0)) {
+		return NULL;
+	}
+
+	size_t capacity = MIN_BLOCK_SIZE;
+	if (builder->last_capacity > 0) {
+		capacity = builder->last_capacity * 2;
+	}
+	if (capacity > MAX_BLOCK_SIZE) {
+		capacity = MAX_BLOCK_SIZE;
+	}
+	if (capacity < length) {
+		capacity = length;
+	}
+
+	ResponseBlock* block = builder->spare;
+	if (block != NULL && block->capacity >= capacity) {
+		builder->spare = block->next;
+	} else {
+		block = (ResponseBlock*)ArenaAllocate(&builder->connection->arena,
+																					sizeof(ResponseBlock) + capacity);
+		if (block == NULL) {
+			(void)fprintf(stderr, "Error: In AddBlock(): ArenaAllocate() failed\n");
+			return NULL;
+		}
+		block->capacity = capacity;
+	}
+
+	block->next = NULL;
+	block->length = 0;
+	builder->last_capacity = block->capacity;
+
+	if (builder->tail != NULL) {
+		builder->tail->next = block;
+	} else {
+		builder->head = block;
+	}
+	builder->tail = block;
+
+	if (builder->pending == NULL) {
+		builder->pending = block;
+	}
+
+	return block;
+}
+
+char* ReserveResponseBody(ResponseBuilder* builder, size_t length) {
+	if (builder->has_failed) {
+		return NULL;
+	}
+
+	ResponseBlock* block = builder->tail;
+	if (block == NULL || block->capacity - block->length < length) {
+		block = AddBlock(builder, length);
+		if (block == NULL) {
+			builder->has_failed = 1;
+			return NULL;
+		}
+	}
+
+	return block->data + block->length;
+}
+
+void CommitResponseBody(ResponseBuilder* builder, size_t length) {
+	builder->tail->length += length;
+	builder->body_length += length;
+}
+
+int AppendResponseBody(ResponseBuilder* builder,
+											 const char* data,
+											 size_t length) {
+	while (length > 0) {
+		if (builder->has_failed) {
+			return -1;
+		}
+
+		// The rest of the current block is filled before a new one is started.
+		ResponseBlock* block = builder->tail;
+		size_t available = (block != NULL) ? block->capacity - block->length : 0;
+		if (available == 0) {
+			block = AddBlock(builder, 1);
+			if (block == NULL) {
+				builder->has_failed = 1;
+				return -1;
+			}
+			available = block->capacity;
+		}
+
+		size_t count = (length < available) ? length : available;
+		memcpy(block->data + block->length, data, count);
+		CommitResponseBody(builder, count);
+
+		data += count;
+		length -= count;
+	}
+
+	return builder->has_failed ? -1 : 0;
+}
+
+int FinishResponse(ResponseBuilder* builder) {
+	if (builder->has_failed) {
+		return -1;
+	}
+
+	if (!builder->is_chunked && QueueHeaders(builder) < 0) {
+		return -1;
+	}
+
+	if (QueueBlocks(builder) < 0) {
+		return -1;
+	}
+
+	// The last chunk is empty and has no trailers.
+	if (builder->is_chunked && QueueText(builder->connection, "0\r\n\r\n") < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+// src/response.c
\ No newline at end of file
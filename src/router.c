@@ -0,0 +1,308 @@
+#include "router.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scan.h"
+
+static const size_t INITIAL_ROUTE_NODES = 16;
+
+HTTPMethod GetHTTPMethod(StringView method) {
+	// The supported methods differ in length, so one comparison settles it.
+	switch (method.length) {
+		case 3:
+			return (memcmp(method.data, "GET", 3) == 0) ? METHOD_GET
+																									: METHOD_INVALID;
+		case 4:
+			return (memcmp(method.data, "POST", 4) == 0) ? METHOD_POST
+																									 : METHOD_INVALID;
+		case 6:
+			return (memcmp(method.data, "DELETE", 6) == 0) ? METHOD_DELETE
+																										 : METHOD_INVALID;
+		default:
+			return METHOD_INVALID;
+	}
+}
+
+static int AddNode(Router* router, char byte) {
+	if (router->num_nodes == router->capacity) {
+		size_t capacity = router->capacity * 2;
+		RouteNode* nodes =
+				(RouteNode*)realloc(router->nodes, capacity * sizeof(RouteNode));
+		if (nodes == NULL) {
+			perror("Error: In AddNode(): realloc() failed");
+			return -1;
+		}
+
+		router->nodes = nodes;
+		router->capacity = capacity;
+	}
+
+	int index = (int)router->num_nodes++;
+	RouteNode* node = &router->nodes[index];
+	memset(node, 0, sizeof(RouteNode));
+	node->byte = byte;
+	node->first_child = -1;
+	node->next_sibling = -1;
+
+	return index;
+}
+
+static int FindChild(const Router* router, int parent, char byte) {
+	int child = router->nodes[parent].first_child;
+	while (child >= 0 && router->nodes[child].byte != byte) {
+		child = router->nodes[child].next_sibling;
+	}
+
+	return child;
+}
+
+int InitRouter(Router* router) {
+	router->nodes = (RouteNode*)malloc(INITIAL_ROUTE_NODES * sizeof(RouteNode));
+	if (router->nodes == NULL) {
+		perror("Error: In InitRouter(): malloc() failed");
+		return -1;
+	}
+
+	router->num_nodes = 0;
+	router->capacity = INITIAL_ROUTE_NODES;
+
+	return (AddNode(router, '\0') < 0) ? -1 : 0;
+}
+
+int AddRoute(Router* router,
+						 HTTPMethod method,
+						 const char* path,
+						 RouteHandler handler) {
+	if (method < 0 || method >= NUM_METHODS || path == NULL || handler == NULL) {
+		(void)fprintf(stderr, "Error: In AddRoute(): Invalid route\n");
+		return -1;
+	}
+
+	int node = 0;
+	for (const char* c = path; *c != '\0'; c++) {
+		int child = FindChild(router, node, *c);
+		if (child < 0) {
+			child = AddNode(router, *c);
+			if (child < 0) {
+				return -1;
+			}
+
+			router->nodes[child].next_sibling = router->nodes[node].first_child;
+			router->nodes[node].first_child = child;
+		}
+
+		node = child;
+	}
+
+	router->nodes[node].handlers[method] = handler;
+	return 0;
+}
+
+static int HexValue(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+
+	return -1;
+}
+
+static int NeedsDecoding(StringView view, int is_query) {
+	return memchr(view.data, '%', view.length) != NULL ||
+				 (is_query && memchr(view.data, '+', view.length) != NULL);
+}
+
+// Percent-decodes view into output, which advances past the decoded bytes,
+// and points view at them. Views without escapes are left as they are.
+// Returns 0 on success, -1 on a malformed escape.
+static int DecodeView(StringView* view, int is_query, char** output) {
+	if (!NeedsDecoding(*view, is_query)) {
+		return 0;
+	}
+
+	char* start = *output;
+	char* out = start;
+
+	for (size_t i = 0; i < view->length; i++) {
+		char c = view->data[i];
+
+		if (c == '%') {
+			if (view->length - i < 3) {
+				return -1;
+			}
+
+			int high = HexValue(view->data[i + 1]);
+			int low = HexValue(view->data[i + 2]);
+			if (high < 0 || low < 0) {
+				return -1;
+			}
+
+			*out++ = (char)(high * 16 + low);
+			i += 2;
+		} else if (c == '+' && is_query) {
+			*out++ = ' ';
+		} else {
+			*out++ = c;
+		}
+	}
+
+	view->data = start;
+	view->length = (size_t)(out - start);
+	*output = out;
+
+	return 0;
+}
+
+static RouteResult ParseQuery(StringView query,
+															RouteMatch* match,
+															char** output) {
+	const char* param = query.data;
+	const char* end = query.data + query.length;
+
+	while (param < end) {
+		// A parameter ends at the next '&'; only its first '=' is special.
+		const char* equal_to = NULL;
+		const char* stop = param;
+		for (;;) {
+			stop += FindDelimiter(stop, (size_t)(end - stop), &QUERY_DELIMITERS);
+			if (stop == end || *stop == '&') {
+				break;
+			}
+			if (*stop == '=' && equal_to == NULL) {
+				equal_to = stop;
+			}
+			stop++;
+		}
+
+		// Empty parameters, as in "a=1&&b=2", are skipped.
+		if (stop > param) {
+			if (match->num_params == MAX_QUERY_PARAMS) {
+				return ROUTE_BAD_QUERY;
+			}
+
+			const char* key_end = (equal_to != NULL) ? equal_to : stop;
+			const char* value = (equal_to != NULL) ? equal_to + 1 : stop;
+
+			QueryParam* query_param = &match->params[match->num_params++];
+			query_param->key.data = param;
+			query_param->key.length = (size_t)(key_end - param);
+			query_param->value.data = value;
+			query_param->value.length = (size_t)(stop - value);
+
+			if (DecodeView(&query_param->key, 1, output) < 0 ||
+					DecodeView(&query_param->value, 1, output) < 0) {
+				return ROUTE_BAD_QUERY;
+			}
+		}
+
+		if (stop == end) {
+			break;
+		}
+		param = stop + 1;
+	}
+
+	return ROUTE_FOUND;
+}
+
+RouteResult MatchRoute(const Router* router,
+											 const HTTPRequest* request,
+											 Arena* arena,
+											 RouteMatch* match) {
+	match->handler = NULL;
+	match->num_params = 0;
+
+	// The path ends at the first '?', the query string follows it.
+	StringView target = request->path;
+	size_t path_length = 0;
+	for (;;) {
+		path_length += FindDelimiter(target.data + path_length,
+																 target.length - path_length,
+																 &QUERY_DELIMITERS);
+		if (path_length == target.length || target.data[path_length] == '?') {
+			break;
+		}
+		path_length++;
+	}
+
+	StringView path = {target.data, path_length};
+	StringView query = {target.data + path_length, 0};
+	if (path_length < target.length) {
+		query.data++;
+		query.length = target.length - path_length - 1;
+	}
+
+	// Decoded bytes are never more than the encoded ones.
+	char* output = NULL;
+	if (NeedsDecoding(target, 1)) {
+		output = (char*)ArenaAllocate(arena, target.length);
+		if (output == NULL) {
+			(void)fprintf(stderr,
+										"Error: In MatchRoute(): ArenaAllocate() failed\n");
+			return ROUTE_ERROR;
+		}
+	}
+
+	if (DecodeView(&path, 0, &output) < 0) {
+		return ROUTE_BAD_QUERY;
+	}
+
+	int node = 0;
+	for (size_t i = 0; i < path.length && node >= 0; i++) {
+		node = FindChild(router, node, path.data[i]);
+	}
+
+	if (node < 0) {
+		return ROUTE_NOT_FOUND;
+	}
+
+	const RouteNode* route = &router->nodes[node];
+	HTTPMethod method = GetHTTPMethod(request->method);
+	if (method == METHOD_INVALID || route->handlers[method] == NULL) {
+		for (int i = 0; i < NUM_METHODS; i++) {
+			if (route->handlers[i] != NULL) {
+				return ROUTE_METHOD_NOT_ALLOWED;
+			}
+		}
+
+		return ROUTE_NOT_FOUND;
+	}
+
+	match->handler = route->handlers[method];
+
+	return ParseQuery(query, match, &output);
+}
+
+int GetQueryParam(const RouteMatch* match, const char* key, StringView* value) {
+	size_t key_length = strlen(key);
+
+	for (size_t i = 0; i < match->num_params; i++) {
+		const QueryParam* param = &match->params[i];
+		if (param->key.length == key_length &&
+				memcmp(param->key.data, key, key_length) == 0) {
+			*value = param->value;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void CleanupRouter(Router* router) {
+	if (router == NULL) {
+		return;
+	}
+
+	free(router->nodes);
+	router->nodes = NULL;
+	router->num_nodes = 0;
+	router->capacity = 0;
+}
+
+// src/router.c
\ No newline at end of file
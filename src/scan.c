@@ -0,0 +1,395 @@
+#include "scan.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_VECTOR_SCANNERS 1
+#else
+#define HAS_VECTOR_SCANNERS 0
+#endif
+
+typedef size_t (*DelimiterScanner)(const char*, size_t, const ScanSet*);
+typedef const char* (*SequenceScanner)(const char*,
+																			 size_t,
+																			 const char*,
+																			 size_t);
+typedef size_t (*JSONScanner)(const char*, size_t);
+
+const ScanSet LINE_END_DELIMITERS = {
+		.bytes = {'\r', '\n', '\r', '\r'},
+		.table = {['\r'] = 1, ['\n'] = 1},
+};
+
+const ScanSet TOKEN_DELIMITERS = {
+		.bytes = {' ', '\r', '\n', ' '},
+		.table = {[' '] = 1, ['\r'] = 1, ['\n'] = 1},
+};
+
+const ScanSet HEADER_DELIMITERS = {
+		.bytes = {':', '\n', ':', ':'},
+		.table = {[':'] = 1, ['\n'] = 1},
+};
+
+const ScanSet QUERY_DELIMITERS = {
+		.bytes = {'?', '=', '&', '?'},
+		.table = {['?'] = 1, ['='] = 1, ['&'] = 1},
+};
+
+static size_t FindDelimiterScalar(const char* data,
+																	size_t length,
+																	const ScanSet* set) {
+	for (size_t i = 0; i < length; i++) {
+		if (set->table[(unsigned char)data[i]]) {
+			return i;
+		}
+	}
+
+	return length;
+}
+
+static const char* FindSequenceScalar(const char* data,
+																			size_t length,
+																			const char* sequence,
+																			size_t sequence_length) {
+	char first = sequence[0];
+	char last = sequence[sequence_length - 1];
+
+	for (size_t i = 0; i + sequence_length <= length; i++) {
+		if (data[i] == first && data[i + sequence_length - 1] == last &&
+				memcmp(data + i, sequence, sequence_length) == 0) {
+			return data + i;
+		}
+	}
+
+	return NULL;
+}
+
+static int IsJSONSpecial(char c) {
+	return c == '"' || c == '\\' || (unsigned char)c < 0x20;
+}
+
+static size_t FindJSONSpecialScalar(const char* data, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		if (IsJSONSpecial(data[i])) {
+			return i;
+		}
+	}
+
+	return length;
+}
+
+#if HAS_VECTOR_SCANNERS
+
+__attribute__((target("sse2"))) static size_t FindDelimiterSSE2(
+		const char* data,
+		size_t length,
+		const ScanSet* set) {
+	const __m128i d0 = _mm_set1_epi8(set->bytes[0]);
+	const __m128i d1 = _mm_set1_epi8(set->bytes[1]);
+	const __m128i d2 = _mm_set1_epi8(set->bytes[2]);
+	const __m128i d3 = _mm_set1_epi8(set->bytes[3]);
+
+	size_t i = 0;
+	for (; i + 16 <= length; i += 16) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i match = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(block, d0), _mm_cmpeq_epi8(block, d1)),
+				_mm_or_si128(_mm_cmpeq_epi8(block, d2), _mm_cmpeq_epi8(block, d3)));
+
+		unsigned mask = (unsigned)_mm_movemask_epi8(match);
+		if (mask != 0) {
+			return i + (size_t)__builtin_ctz(mask);
+		}
+	}
+
+	return i + FindDelimiterScalar(data + i, length - i, set);
+}
+
+__attribute__((target("avx2"))) static size_t FindDelimiterAVX2(
+		const char* data,
+		size_t length,
+		const ScanSet* set) {
+	const __m256i d0 = _mm256_set1_epi8(set->bytes[0]);
+	const __m256i d1 = _mm256_set1_epi8(set->bytes[1]);
+	const __m256i d2 = _mm256_set1_epi8(set->bytes[2]);
+	const __m256i d3 = _mm256_set1_epi8(set->bytes[3]);
+
+	size_t i = 0;
+	for (; i + 32 <= length; i += 32) {
+		__m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+		__m256i match = _mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(block, d0),
+												_mm256_cmpeq_epi8(block, d1)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(block, d2),
+												_mm256_cmpeq_epi8(block, d3)));
+
+		unsigned mask = (unsigned)_mm256_movemask_epi8(match);
+		if (mask != 0) {
+			return i + (size_t)__builtin_ctz(mask);
+		}
+	}
+
+	// Short tails, which most tokens are, take one 16-byte vector, then bytes.
+	if (i + 16 <= length) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i match = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(block, _mm256_castsi256_si128(d0)),
+										 _mm_cmpeq_epi8(block, _mm256_castsi256_si128(d1))),
+				_mm_or_si128(_mm_cmpeq_epi8(block, _mm256_castsi256_si128(d2)),
+										 _mm_cmpeq_epi8(block, _mm256_castsi256_si128(d3))));
+
+		unsigned mask = (unsigned)_mm_movemask_epi8(match);
+		if (mask != 0) {
+			return i + (size_t)__builtin_ctz(mask);
+		}
+		i += 16;
+	}
+
+	for (; i < length; i++) {
+		if (set->table[(unsigned char)data[i]]) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2"))) static const char* FindSequenceSSE2(
+		const char* data,
+		size_t length,
+		const char* sequence,
+		size_t sequence_length) {
+	const __m128i first = _mm_set1_epi8(sequence[0]);
+	const __m128i last = _mm_set1_epi8(sequence[sequence_length - 1]);
+
+	size_t i = 0;
+	for (; i + sequence_length - 1 + 16 <= length; i += 16) {
+		__m128i head = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i tail =
+				_mm_loadu_si128((const __m128i*)(data + i + sequence_length - 1));
+
+		unsigned mask = (unsigned)_mm_movemask_epi8(
+				_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+		while (mask != 0) {
+			size_t candidate = i + (size_t)__builtin_ctz(mask);
+			if (memcmp(data + candidate, sequence, sequence_length) == 0) {
+				return data + candidate;
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return FindSequenceScalar(data + i, length - i, sequence, sequence_length);
+}
+
+__attribute__((target("avx2"))) static const char* FindSequenceAVX2(
+		const char* data,
+		size_t length,
+		const char* sequence,
+		size_t sequence_length) {
+	const __m256i first = _mm256_set1_epi8(sequence[0]);
+	const __m256i last = _mm256_set1_epi8(sequence[sequence_length - 1]);
+
+	size_t i = 0;
+	for (; i + sequence_length - 1 + 32 <= length; i += 32) {
+		__m256i head = _mm256_loadu_si256((const __m256i*)(data + i));
+		__m256i tail =
+				_mm256_loadu_si256((const __m256i*)(data + i + sequence_length - 1));
+
+		unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(
+				_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last)));
+		while (mask != 0) {
+			size_t candidate = i + (size_t)__builtin_ctz(mask);
+			if (memcmp(data + candidate, sequence, sequence_length) == 0) {
+				return data + candidate;
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	// The tail is scanned in place, calls into the other scanners cost more
+	// than they save on the few positions left.
+	for (; i + sequence_length <= length; i++) {
+		if (data[i] == sequence[0] &&
+				memcmp(data + i, sequence, sequence_length) == 0) {
+			return data + i;
+		}
+	}
+
+	return NULL;
+}
+
+// Control characters are the bytes left unchanged by an unsigned maximum
+// with 0x1F, which needs no sign juggling.
+__attribute__((target("sse2"))) static size_t FindJSONSpecialSSE2(
+		const char* data,
+		size_t length) {
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i control = _mm_set1_epi8(0x1F);
+
+	size_t i = 0;
+	for (; i + 16 <= length; i += 16) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i match = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(block, quote),
+										 _mm_cmpeq_epi8(block, backslash)),
+				_mm_cmpeq_epi8(_mm_max_epu8(block, control), control));
+
+		unsigned mask = (unsigned)_mm_movemask_epi8(match);
+		if (mask != 0) {
+			return i + (size_t)__builtin_ctz(mask);
+		}
+	}
+
+	return i + FindJSONSpecialScalar(data + i, length - i);
+}
+
+__attribute__((target("avx2"))) static size_t FindJSONSpecialAVX2(
+		const char* data,
+		size_t length) {
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i control = _mm256_set1_epi8(0x1F);
+
+	size_t i = 0;
+	for (; i + 32 <= length; i += 32) {
+		__m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+		__m256i match = _mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(block, quote),
+												_mm256_cmpeq_epi8(block, backslash)),
+				_mm256_cmpeq_epi8(_mm256_max_epu8(block, control), control));
+
+		unsigned mask = (unsigned)_mm256_movemask_epi8(match);
+		if (mask != 0) {
+			return i + (size_t)__builtin_ctz(mask);
+		}
+	}
+
+	if (i + 16 <= length) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i match = _mm_or_si128(
+				_mm_or_si128(
+						_mm_cmpeq_epi8(block, _mm256_castsi256_si128(quote)),
+						_mm_cmpeq_epi8(block, _mm256_castsi256_si128(backslash))),
+				_mm_cmpeq_epi8(
+						_mm_max_epu8(block, _mm256_castsi256_si128(control)),
+						_mm256_castsi256_si128(control)));
+
+		unsigned mask = (unsigned)_mm_movemask_epi8(match);
+		if (mask != 0) {
+			return i + (size_t)__builtin_ctz(mask);
+		}
+		i += 16;
+	}
+
+	for (; i < length; i++) {
+		if (IsJSONSpecial(data[i])) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+#endif
+
+static DelimiterScanner find_delimiter = FindDelimiterScalar;
+static SequenceScanner find_sequence = FindSequenceScalar;
+static JSONScanner find_json_special = FindJSONSpecialScalar;
+
+static int IsScanLevelSupported(ScanLevel level) {
+	switch (level) {
+		case SCAN_SCALAR:
+			return 1;
+#if HAS_VECTOR_SCANNERS
+		case SCAN_SSE2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("sse2");
+		case SCAN_AVX2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return 0;
+	}
+}
+
+ScanLevel InitScanner() {
+	ScanLevel levels[] = {SCAN_AVX2, SCAN_SSE2};
+
+	for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+		if (SetScanLevel(levels[i]) == 0) {
+			return levels[i];
+		}
+	}
+
+	(void)SetScanLevel(SCAN_SCALAR);
+	return SCAN_SCALAR;
+}
+
+int SetScanLevel(ScanLevel level) {
+	if (!IsScanLevelSupported(level)) {
+		return -1;
+	}
+
+	switch (level) {
+#if HAS_VECTOR_SCANNERS
+		case SCAN_SSE2:
+			find_delimiter = FindDelimiterSSE2;
+			find_sequence = FindSequenceSSE2;
+			find_json_special = FindJSONSpecialSSE2;
+			break;
+		case SCAN_AVX2:
+			find_delimiter = FindDelimiterAVX2;
+			find_sequence = FindSequenceAVX2;
+			find_json_special = FindJSONSpecialAVX2;
+			break;
+#endif
+		default:
+			find_delimiter = FindDelimiterScalar;
+			find_sequence = FindSequenceScalar;
+			find_json_special = FindJSONSpecialScalar;
+			break;
+	}
+
+	return 0;
+}
+
+const char* GetScanLevelName(ScanLevel level) {
+	switch (level) {
+		case SCAN_SSE2:
+			return "sse2";
+		case SCAN_AVX2:
+			return "avx2";
+		default:
+			return "scalar";
+	}
+}
+
+size_t FindDelimiter(const char* data, size_t length, const ScanSet* set) {
+	return find_delimiter(data, length, set);
+}
+
+const char* FindSequence(const char* data,
+												 size_t length,
+												 const char* sequence,
+												 size_t sequence_length) {
+	if (sequence_length == 0) {
+		return data;
+	}
+
+	if (length < sequence_length) {
+		return NULL;
+	}
+
+	return find_sequence(data, length, sequence, sequence_length);
+}
+
+size_t FindJSONSpecial(const char* data, size_t length) {
+	return find_json_special(data, length);
+}
+
+// src/scan.c
\ No newline at end of file
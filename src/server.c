@@ -1,60 +1,248 @@
 #include "server.h"
 
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "buffer_pool.h"
 #include "common.h"
+#include "config.h"
+#include "cpu.h"
 #include "database.h"
+#include "executor.h"
 #include "network.h"
-#include "queue.h"
+#include "scan.h"
 #include "signal_handler.h"
 #include "terminal.h"
 #include "thread_pool.h"
+#include "transaction_handler.h"
+#include "uring.h"
 
-static Queue queue;
-static ThreadPool thread_pool;
-static int server_socket;
+/**
+ * @struct Acceptor
+ * @brief A listening socket together with the reactor and Workers serving it.
+ *
+ * In multi-acceptor mode every Acceptor owns its own SO_REUSEPORT listener, so
+ * the kernel spreads new connections across them and no accept lock or Worker
+ * is shared between groups. Depending on the configured backend, either the
+ * reactor or the ring drives the listener. With pinning enabled, each group
+ * runs on its own slice of CPUs from one NUMA node where possible.
+ */
+typedef struct {
+	int server_socket;			 // Listening socket of this group
+	Reactor reactor;				 // epoll event loop accepting on server_socket
+	Ring ring;							 // io_uring event loop accepting on server_socket
+	int uses_ring;					 // Non-zero if ring drives this group
+	ThreadPool thread_pool;	 // Workers serving connections of this group
+	pthread_t thread;				 // Event loop thread (unused for the first group)
+	const int* cpus;				 // CPUs of this group (NULL-able)
+	int num_cpus;						 // Number of entries in cpus, 0 if not pinned
+} Acceptor;
+
+static Acceptor* acceptors = NULL;
+static int num_acceptors = 0;
+static int* usable_cpus = NULL;
+
+static void AssignCPUs() {
+	usable_cpus = (int*)malloc(CPU_SETSIZE * sizeof(int));
+	if (usable_cpus == NULL) {
+		perror("Error: In AssignCPUs(): malloc() failed");
+		exit(EXIT_FAILURE);
+	}
+
+	int count = GetUsableCPUs(usable_cpus, CPU_SETSIZE);
+	if (count <= 0) {
+		(void)printf("No usable CPUs found, threads are not pinned\n");
+		return;
+	}
+
+	// CPUs are ordered by NUMA node, so contiguous slices keep each group, and
+	// the buffers its threads allocate, on as few nodes as possible.
+	for (int i = 0; i < num_acceptors; i++) {
+		int start = i * count / num_acceptors;
+		int end = (i + 1) * count / num_acceptors;
+		if (end == start) {
+			start = i % count;
+			end = start + 1;
+		}
+
+		acceptors[i].cpus = usable_cpus + start;
+		acceptors[i].num_cpus = end - start;
+	}
+}
+
+static void RunAcceptor(Acceptor* acceptor) {
+	if (acceptor->uses_ring) {
+		RunRing(&acceptor->ring);
+	} else {
+		RunReactor(&acceptor->reactor);
+	}
+}
+
+static void* AcceptorThread(void* arg) {
+	DisableSignalsInThread();
+	RunAcceptor((Acceptor*)arg);
+	return NULL;
+}
 
 void InitServer() {
 	InitTerminalConfig();
-	InitSignalHandlers(&queue);
+	InitSignalHandlers();
+	(void)InitScanner();
 
-	server_socket = CreateServerSocket((int)PORT, (int)MAX_PENDING_CONNECTIONS);
-
-	if (server_socket < 0) {
-		(void)fprintf(stderr,
-									"Error: In InitServer(): CreateServerSocket() failed\n");
+	num_acceptors = server_config.num_acceptors;
+	acceptors = (Acceptor*)calloc(num_acceptors, sizeof(Acceptor));
+	if (acceptors == NULL) {
+		perror("Error: In InitServer(): calloc() failed");
 		exit(EXIT_FAILURE);
 	}
 
-	InitDatabase();
-	InitQueue(&queue, (int)MAX_PENDING_CONNECTIONS);
-	InitThreadPool(&thread_pool, (int)MAX_PENDING_CONNECTIONS, &queue);
+	for (int i = 0; i < num_acceptors; i++) {
+		acceptors[i].server_socket = CreateServerSocket(
+				(int)PORT, (int)MAX_PENDING_CONNECTIONS, num_acceptors > 1);
+
+		if (acceptors[i].server_socket < 0) {
+			(void)fprintf(stderr,
+										"Error: In InitServer(): CreateServerSocket() failed\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	PrintLocalIP();
+	InitDatabase(&server_config.database);
+	InitRoutes();
+	InitStaticResponses();
+
+	int min_threads = server_config.num_threads / num_acceptors;
+	if (min_threads <= 0) {
+		min_threads = 1;
+	}
+
+	int max_threads = server_config.max_threads / num_acceptors;
+	if (max_threads < min_threads) {
+		max_threads = min_threads;
+	}
+
+	if (server_config.pin_threads) {
+		AssignCPUs();
+	}
+
+	is_server_running = 1;
+
+	InitExecutor(server_config.num_db_threads,
+							 server_config.write_batch_size,
+							 server_config.write_window);
+
+	for (int i = 0; i < num_acceptors; i++) {
+		Acceptor* acceptor = &acceptors[i];
+
+		InitThreadPool(&acceptor->thread_pool,
+									 min_threads,
+									 max_threads,
+									 (time_t)server_config.cooldown,
+									 acceptor->cpus,
+									 acceptor->num_cpus);
+
+		if (server_config.backend == IO_BACKEND_IO_URING) {
+			if (InitRing(&acceptor->ring,
+									 acceptor->server_socket,
+									 &acceptor->thread_pool) == 0) {
+				acceptor->uses_ring = 1;
+			} else {
+				(void)printf("io_uring is unavailable, falling back to epoll\n");
+			}
+		}
+
+		if (!acceptor->uses_ring && InitReactor(&acceptor->reactor,
+																						acceptor->server_socket,
+																						&acceptor->thread_pool) < 0) {
+			(void)fprintf(stderr, "Error: In InitServer(): InitReactor() failed\n");
+			exit(EXIT_FAILURE);
+		}
+	}
 }
 
 void RunServer() {
-	is_server_running = 1;
-	while (is_server_running) {
-		int client_socket = AcceptClient(server_socket);
+	for (int i = 1; i < num_acceptors; i++) {
+		pthread_attr_t attr;
+		if (pthread_attr_init(&attr) != 0) {
+			perror("Error: In RunServer(): pthread_attr_init() failed");
+			exit(EXIT_FAILURE);
+		}
 
-		if (!is_server_running) {
-			break;
+		if (acceptors[i].num_cpus > 0) {
+			(void)SetThreadAffinity(&attr, acceptors[i].cpus, acceptors[i].num_cpus);
 		}
 
-		if (client_socket < 0) {
-			(void)fprintf(stderr, "Error: In RunServer(): AcceptClient() failed\n");
-			continue;
+		int result = pthread_create(
+				&acceptors[i].thread, &attr, AcceptorThread, &acceptors[i]);
+
+		if (pthread_attr_destroy(&attr) != 0) {
+			perror("Error: In RunServer(): pthread_attr_destroy() failed");
 		}
 
-		Enqueue(&queue, client_socket);
+		if (result != 0) {
+			perror("Error: In RunServer(): pthread_create() failed");
+			is_server_running = 0;
+			num_acceptors = i;
+			break;
+		}
 	}
+
+	if (acceptors[0].num_cpus > 0) {
+		(void)PinCurrentThread(acceptors[0].cpus, acceptors[0].num_cpus);
+	}
+
+	RunAcceptor(&acceptors[0]);
 }
 
 void ShutdownServer() {
-	CleanupThreadPool(&thread_pool);
-	CleanupQueue(&queue);
+	for (int i = 1; i < num_acceptors; i++) {
+		if (pthread_join(acceptors[i].thread, NULL) != 0) {
+			perror("Error: In ShutdownServer(): pthread_join() failed");
+		}
+	}
+
+	// Database threads hand connections back to the Workers, so they stop first.
+	StopExecutor();
+
+	for (int i = 0; i < server_config.num_acceptors; i++) {
+		CleanupThreadPool(&acceptors[i].thread_pool);
+		if (acceptors[i].uses_ring) {
+			CleanupRing(&acceptors[i].ring);
+		} else {
+			CleanupReactor(&acceptors[i].reactor);
+		}
+	}
+
+	CloseAllConnections();
+
+	// Every thread has exited and handed its cached buffers to the depot.
+	CleanupBufferPool();
+
+	for (int i = 0; i < server_config.num_acceptors; i++) {
+		char name[32];
+		(void)snprintf(name, sizeof(name), "Listener %d", i);
+		PrintThreadPoolStats(&acceptors[i].thread_pool, name);
+	}
+	PrintExecutorStats();
+	PrintDatabaseStats();
+	CleanupExecutor();
+
+	for (int i = 0; i < server_config.num_acceptors; i++) {
+		CloseServerSocket(acceptors[i].server_socket);
+	}
+
+	free(acceptors);
+	acceptors = NULL;
+
+	free(usable_cpus);
+	usable_cpus = NULL;
+
+	CleanupStaticResponses();
+	CleanupRoutes();
 	CleanupDatabase();
-	CloseServerSocket(server_socket);
 	CleanupSignalHandlers();
 	RevertTerminalConfig();
 
@@ -63,10 +251,11 @@ void ShutdownServer() {
 	(void)putchar('\n');
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+	ParseServerConfig(argc, argv);
 	InitServer();
 	RunServer();
 	ShutdownServer();
 }
 
-// src/server.c
\ No newline at end of file
+// src/server.c
@@ -6,14 +6,10 @@
 #include <stdlib.h>
 
 #include "common.h"
-#include "queue.h"
 
 static pthread_mutex_t signal_lock;
-static Queue* queue_ref = NULL;
-
-void InitSignalHandlers(Queue* queue) {
-	queue_ref = queue;
 
+void InitSignalHandlers() {
 	pthread_mutex_init(&signal_lock, NULL);
 
 	struct sigaction sa;
@@ -40,7 +36,6 @@ void HandleSignal(int sig) {
 		}
 
 		is_server_running = 0;
-		pthread_cond_broadcast(&queue_ref->cond);
 
 		if (pthread_mutex_unlock(&signal_lock) != 0) {
 			perror("Error: In HandleSignal(): pthread_mutex_unlock() failed");
@@ -61,8 +56,6 @@ void CleanupSignalHandlers() {
 	if (pthread_mutex_destroy(&signal_lock) != 0) {
 		perror("Error: In CleanupSignalHandlers(): pthread_mutex_destroy() failed");
 	}
-
-	queue_ref = NULL;
 }
 
 // src/signal_handler.c
\ No newline at end of file
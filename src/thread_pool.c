@@ -3,116 +3,426 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 
 #include "common.h"
+#include "cpu.h"
+#include "network.h"
 #include "parser.h"
 #include "queue.h"
 #include "signal_handler.h"
 #include "transaction_handler.h"
 
-void InitThreadPool(ThreadPool* pool, int num_thread, Queue* queue) {
-	if (num_thread <= 0) {
-		(void)fprintf(stderr,
-									"Error: In InitThreadPool(): num_thread must be > 0\n");
-		exit(EXIT_FAILURE);
+static int StartWorker(ThreadPool* pool, int index) {
+	Worker* worker = &pool->workers[index];
+	worker->is_retiring = 0;
+	worker->has_exited = 0;
+
+	pthread_attr_t attr;
+	if (pthread_attr_init(&attr) != 0) {
+		perror("Error: In StartWorker(): pthread_attr_init() failed");
+		return -1;
 	}
 
-	if (queue == NULL) {
-		(void)fprintf(stderr, "Error: In InitThreadPool(): queue is NULL\n");
-		exit(EXIT_FAILURE);
+	if (pool->num_cpus > 0) {
+		(void)SetThreadAffinity(&attr, &pool->cpus[index % pool->num_cpus], 1);
 	}
 
-	pool->num_threads = num_thread;
-	pool->queue = queue;
+	int result = pthread_create(&worker->thread, &attr, WorkerThread, worker);
 
-	pool->threads = (pthread_t*)malloc(num_thread * sizeof(pthread_t));
-	if (pool->threads == NULL) {
-		perror("Error: In InitThreadPool(): malloc() failed");
-		exit(EXIT_FAILURE);
+	if (pthread_attr_destroy(&attr) != 0) {
+		perror("Error: In StartWorker(): pthread_attr_destroy() failed");
+	}
+
+	if (result != 0) {
+		perror("Error: In StartWorker(): pthread_create() failed");
+		return -1;
 	}
 
-	if (pthread_mutex_init(&pool->lock, NULL) != 0) {
-		perror("Error: In InitThreadPool(): pthread_mutex_init() failed");
-		free(pool->threads);
+	return 0;
+}
+
+static void* ManagerThread(void* arg);
+
+void InitThreadPool(ThreadPool* pool,
+										int min_threads,
+										int max_threads,
+										time_t cooldown,
+										const int* cpus,
+										int num_cpus) {
+	if (min_threads <= 0 || max_threads < min_threads) {
+		(void)fprintf(stderr,
+									"Error: In InitThreadPool(): Invalid thread limits %d-%d\n",
+									min_threads,
+									max_threads);
 		exit(EXIT_FAILURE);
 	}
 
-	if (pthread_cond_init(&pool->cond, NULL) != 0) {
-		perror("Error: In InitThreadPool(): pthread_cond_init() failed");
-		free(pool->threads);
-		if (pthread_mutex_destroy(&pool->lock) != 0) {
-			perror("Error: In InitThreadPool(): pthread_mutex_destroy() failed");
-		}
+	pool->num_threads = min_threads;
+	pool->min_threads = min_threads;
+	pool->max_threads = max_threads;
+	pool->cooldown = cooldown;
+	pool->next_worker = 0;
+	pool->cpus = cpus;
+	pool->num_cpus = num_cpus;
+	memset(&pool->stats, 0, sizeof(ThreadPoolStats));
+	pool->stats.peak_threads = min_threads;
+
+	pool->workers = (Worker*)calloc(max_threads, sizeof(Worker));
+	if (pool->workers == NULL) {
+		perror("Error: In InitThreadPool(): calloc() failed");
 		exit(EXIT_FAILURE);
 	}
 
-	for (int i = 0; i < num_thread; i++) {
-		if (pthread_create(&pool->threads[i], NULL, WorkerThread, (void*)pool) !=
-				0) {
-			perror("Error: In InitThreadPool(): pthread_create() failed");
+	// Every connection is in at most one local queue at a time, so a queue of
+	// this size never fills up.
+	for (int i = 0; i < max_threads; i++) {
+		pool->workers[i].pool = pool;
+		pool->workers[i].index = i;
+		InitQueue(&pool->workers[i].queue, (int)MAX_CONNECTIONS);
+	}
 
+	for (int i = 0; i < min_threads; i++) {
+		if (StartWorker(pool, i) < 0) {
 			for (int j = 0; j < i; j++) {
-				if (pthread_cancel(pool->threads[j]) != 0) {
+				if (pthread_cancel(pool->workers[j].thread) != 0) {
 					perror("Error: In InitThreadPool(): pthread_cancel() failed");
 				}
 			}
 
-			free(pool->threads);
+			exit(EXIT_FAILURE);
+		}
+	}
 
-			if (pthread_mutex_destroy(&pool->lock) != 0) {
-				perror("Error: In InitThreadPool(): pthread_mutex_destroy() failed");
-			}
+	if (pthread_create(&pool->manager, NULL, ManagerThread, pool) != 0) {
+		perror("Error: In InitThreadPool(): pthread_create() failed");
+		exit(EXIT_FAILURE);
+	}
+}
 
-			if (pthread_cond_destroy(&pool->cond) != 0) {
-				perror("Error: In InitThreadPool(): pthread_cond_destroy() failed");
-			}
+static void WakeThief(ThreadPool* pool, Worker* owner) {
+	if (HasSleepers(&owner->queue)) {
+		return;
+	}
 
-			exit(EXIT_FAILURE);
+	int num_threads = __atomic_load_n(&pool->num_threads, __ATOMIC_ACQUIRE);
+	for (int i = 1; i < num_threads; i++) {
+		Worker* worker = &pool->workers[(owner->index + i) % num_threads];
+		if (HasSleepers(&worker->queue)) {
+			WakeQueue(&worker->queue);
+			return;
+		}
+	}
+}
+
+static void RescueConnections(ThreadPool* pool, Worker* worker);
+
+int SubmitConnection(ThreadPool* pool, Connection* connection) {
+	int num_threads = __atomic_load_n(&pool->num_threads, __ATOMIC_ACQUIRE);
+
+	int index = connection->worker;
+	if (index < 0 || index >= num_threads) {
+		index = (int)(__atomic_fetch_add(&pool->next_worker, 1, __ATOMIC_RELAXED) %
+									(unsigned int)num_threads);
+	}
+
+	connection->pool = pool;
+	connection->queued_at = GetMonotonicTimeNs();
+
+	Worker* worker = &pool->workers[index];
+	if (Enqueue(&worker->queue, connection->fd) != 0) {
+		return -1;
+	}
+
+	// Enqueue() ends with a full fence, which pairs with RetireWorker(): either
+	// the manager drains the socket from the queue of the retired Worker, or
+	// this thread sees that the Worker is gone and moves the socket itself.
+	if (index >= __atomic_load_n(&pool->num_threads, __ATOMIC_SEQ_CST)) {
+		RescueConnections(pool, worker);
+		return 0;
+	}
+
+	// The owner wakes up by itself if it sleeps; if it is busy, an idle Worker
+	// takes the connection instead of letting it wait.
+	WakeThief(pool, worker);
+	return 0;
+}
+
+static void RescueConnections(ThreadPool* pool, Worker* worker) {
+	int client_socket = -1;
+	while ((client_socket = TryDequeue(&worker->queue)) >= 0) {
+		if (SubmitConnection(pool, GetConnection(client_socket)) != 0) {
+			(void)fprintf(stderr,
+										"Error: In RescueConnections(): SubmitConnection() "
+										"failed\n");
 		}
 	}
 }
 
+static int StealConnection(void* arg) {
+	Worker* thief = (Worker*)arg;
+	ThreadPool* pool = thief->pool;
+
+	int num_threads = __atomic_load_n(&pool->num_threads, __ATOMIC_ACQUIRE);
+	for (int i = 1; i < num_threads; i++) {
+		Worker* victim = &pool->workers[(thief->index + i) % num_threads];
+		int client_socket = TryDequeue(&victim->queue);
+		if (client_socket >= 0) {
+			return client_socket;
+		}
+	}
+
+	return -1;
+}
+
 void* WorkerThread(void* arg) {
 	DisableSignalsInThread();
 
-	while (is_server_running) {
-		int client_socket = Dequeue(((ThreadPool*)arg)->queue);
+	Worker* worker = (Worker*)arg;
+
+	while (is_server_running &&
+				 !__atomic_load_n(&worker->is_retiring, __ATOMIC_ACQUIRE)) {
+		int client_socket =
+				DequeueOrSteal(&worker->queue, StealConnection, worker);
 		if (client_socket < 0) {
 			continue;
 		}
 
-		HandleTransaction(client_socket);
+		uint64_t start = GetMonotonicTimeNs();
+
+		Connection* connection = GetConnection(client_socket);
+		connection->worker = worker->index;
+		uint64_t wait_time =
+				(start > connection->queued_at) ? start - connection->queued_at : 0;
+
+		do {
+			// A connection handed to the database stage comes back through the
+			// queues once its operation has run, and must not be touched here.
+			if (HandleTransaction(connection) > 0) {
+				break;
+			}
+		} while (ReleaseConnection(client_socket) > 0);
+
+		uint64_t busy_time = GetMonotonicTimeNs() - start;
+
+		// Only the Worker itself writes its counters, the manager reads them.
+		__atomic_store_n(
+				&worker->num_served, worker->num_served + 1, __ATOMIC_RELAXED);
+		__atomic_store_n(
+				&worker->wait_time, worker->wait_time + wait_time, __ATOMIC_RELAXED);
+		__atomic_store_n(
+				&worker->busy_time, worker->busy_time + busy_time, __ATOMIC_RELAXED);
+	}
 
-		if (close(client_socket) < 0) {
-			perror("Error: In WorkerThread(): close() failed");
+	// A retired Worker drains its own queue, as it takes no more connections
+	// from it. Connections queued after this are moved by SubmitConnection().
+	if (__atomic_load_n(&worker->is_retiring, __ATOMIC_ACQUIRE)) {
+		RescueConnections(worker->pool, worker);
+		__atomic_store_n(&worker->has_exited, 1, __ATOMIC_RELEASE);
+	}
+
+	return NULL;
+}
+
+static void RetireWorker(ThreadPool* pool) {
+	int index = pool->num_threads - 1;
+	Worker* worker = &pool->workers[index];
+
+	// New connections stop going to the Worker before it is woken. It may
+	// still be serving a connection, so the manager does not wait for it; its
+	// thread is joined once it has exited, by ReapWorker().
+	__atomic_store_n(&pool->num_threads, index, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&worker->is_retiring, 1, __ATOMIC_RELEASE);
+	WakeQueue(&worker->queue);
+}
+
+// Joins the thread of a retired Worker, so that its slot can be started
+// again. Returns 0 if the slot is free, -1 while the Worker is still busy.
+static int ReapWorker(Worker* worker) {
+	if (!worker->is_retiring) {
+		return 0;
+	}
+
+	if (!__atomic_load_n(&worker->has_exited, __ATOMIC_ACQUIRE)) {
+		return -1;
+	}
+
+	if (pthread_join(worker->thread, NULL) != 0) {
+		perror("Error: In ReapWorker(): pthread_join() failed");
+	}
+
+	worker->is_retiring = 0;
+	return 0;
+}
+
+static void* ManagerThread(void* arg) {
+	DisableSignalsInThread();
+
+	ThreadPool* pool = (ThreadPool*)arg;
+
+	struct timespec interval = {
+			.tv_sec = (time_t)(THREAD_POOL_CHECK_INTERVAL / 1000),
+			.tv_nsec = (long)(THREAD_POOL_CHECK_INTERVAL % 1000) * 1000000,
+	};
+
+	uint64_t last_check = GetMonotonicTimeNs();
+	uint64_t last_served = 0;
+	uint64_t last_wait_time = 0;
+	uint64_t last_busy_time = 0;
+	time_t idle_since = GetMonotonicTime();
+
+	while (is_server_running) {
+		(void)nanosleep(&interval, NULL);
+
+		uint64_t now = GetMonotonicTimeNs();
+		uint64_t served = 0;
+		uint64_t wait_time = 0;
+		uint64_t busy_time = 0;
+		size_t num_queued = 0;
+
+		// Retired Workers keep their counters, so the totals never go down.
+		for (int i = 0; i < pool->max_threads; i++) {
+			Worker* worker = &pool->workers[i];
+			served += __atomic_load_n(&worker->num_served, __ATOMIC_RELAXED);
+			wait_time += __atomic_load_n(&worker->wait_time, __ATOMIC_RELAXED);
+			busy_time += __atomic_load_n(&worker->busy_time, __ATOMIC_RELAXED);
+		}
+
+		int num_threads = pool->num_threads;
+		for (int i = 0; i < num_threads; i++) {
+			num_queued += QueueLength(&pool->workers[i].queue);
+		}
+
+		if (num_queued > pool->stats.max_queue_depth) {
+			pool->stats.max_queue_depth = num_queued;
+		}
+
+		uint64_t elapsed = now - last_check;
+		uint64_t num_served = served - last_served;
+		uint64_t waited = wait_time - last_wait_time;
+		uint64_t busy = busy_time - last_busy_time;
+
+		last_check = now;
+		last_served = served;
+		last_wait_time = wait_time;
+		last_busy_time = busy_time;
+
+		// Connections that waited too long, or that did not move at all because
+		// every Worker is blocked, call for another Worker.
+		int is_stalled = num_queued > 0 && num_served == 0;
+		int is_waiting =
+				num_served > 0 && waited / num_served > MAX_QUEUE_WAIT * 1000;
+
+		if (is_stalled) {
+			pool->stats.num_stalls++;
+		}
+
+		if (is_stalled || is_waiting) {
+			idle_since = GetMonotonicTime();
+
+			// A Worker retired from the same slot may still be finishing its last
+			// connection, in which case the pool grows on a later check.
+			if (num_threads >= pool->max_threads) {
+				pool->stats.num_capped++;
+			} else if (ReapWorker(&pool->workers[num_threads]) == 0 &&
+								 StartWorker(pool, num_threads) == 0) {
+				__atomic_store_n(&pool->num_threads, num_threads + 1, __ATOMIC_RELEASE);
+				pool->stats.num_grown++;
+				if (num_threads + 1 > pool->stats.peak_threads) {
+					pool->stats.peak_threads = num_threads + 1;
+				}
+			}
+			continue;
+		}
+
+		// The last Worker is spare once the others could take over its work and
+		// stay at most half busy.
+		if (busy * 2 >= (uint64_t)(num_threads - 1) * elapsed) {
+			idle_since = GetMonotonicTime();
+			continue;
+		}
+
+		if (num_threads > pool->min_threads &&
+				GetMonotonicTime() - idle_since >= pool->cooldown) {
+			RetireWorker(pool);
+			pool->stats.num_shrunk++;
+			idle_since = GetMonotonicTime();
 		}
 	}
 
 	return NULL;
 }
 
-void CleanupThreadPool(ThreadPool* pool) {
+void PrintThreadPoolStats(ThreadPool* pool, const char* name) {
 	if (pool == NULL) {
 		return;
 	}
 
+	(void)printf(
+			"%s: %d-%d Workers, peak %d, grown %zu, shrunk %zu, stalls %zu, "
+			"capped %zu\n",
+			name,
+			pool->min_threads,
+			pool->max_threads,
+			pool->stats.peak_threads,
+			pool->stats.num_grown,
+			pool->stats.num_shrunk,
+			pool->stats.num_stalls,
+			pool->stats.num_capped);
+
+	(void)printf(
+			"%s: %llu dispatches, queue depth max %zu, wait avg %llu us, service "
+			"avg %llu us\n",
+			name,
+			(unsigned long long)pool->stats.num_served,
+			pool->stats.max_queue_depth,
+			(unsigned long long)(pool->stats.wait_time / 1000),
+			(unsigned long long)(pool->stats.busy_time / 1000));
+}
+
+void CleanupThreadPool(ThreadPool* pool) {
+	if (pool == NULL || pool->workers == NULL) {
+		return;
+	}
+
+	if (pthread_join(pool->manager, NULL) != 0) {
+		perror("Error: In CleanupThreadPool(): pthread_join() failed");
+	}
+
 	for (int i = 0; i < pool->num_threads; i++) {
-		if (pthread_join(pool->threads[i], NULL) != 0) {
+		WakeQueue(&pool->workers[i].queue);
+	}
+
+	for (int i = 0; i < pool->num_threads; i++) {
+		if (pthread_join(pool->workers[i].thread, NULL) != 0) {
 			perror("Error: In CleanupThreadPool(): pthread_join() failed");
 		}
 	}
 
-	free(pool->threads);
-	pool->threads = NULL;
+	// Retired Workers that have not been joined yet exit once they have
+	// finished their last connection.
+	for (int i = pool->num_threads; i < pool->max_threads; i++) {
+		Worker* worker = &pool->workers[i];
+		if (worker->is_retiring && pthread_join(worker->thread, NULL) != 0) {
+			perror("Error: In CleanupThreadPool(): pthread_join() failed");
+		}
+	}
 
-	if (pthread_mutex_destroy(&pool->lock) != 0) {
-		perror("Error: In CleanupThreadPool(): pthread_mutex_destroy() failed");
+	uint64_t wait_time = 0;
+	uint64_t busy_time = 0;
+	for (int i = 0; i < pool->max_threads; i++) {
+		pool->stats.num_served += pool->workers[i].num_served;
+		wait_time += pool->workers[i].wait_time;
+		busy_time += pool->workers[i].busy_time;
+		CleanupQueue(&pool->workers[i].queue);
 	}
 
-	if (pthread_cond_destroy(&pool->cond) != 0) {
-		perror("Error: In CleanupThreadPool(): pthread_cond_destroy() failed");
+	if (pool->stats.num_served > 0) {
+		pool->stats.wait_time = wait_time / pool->stats.num_served;
+		pool->stats.busy_time = busy_time / pool->stats.num_served;
 	}
+
+	free(pool->workers);
+	pool->workers = NULL;
 }
 
 // src/thread_pool.c
\ No newline at end of file
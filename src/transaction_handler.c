@@ -3,355 +3,1159 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
+#include <strings.h>
 
 #include "common.h"
+#include "connection.h"
 #include "database.h"
+#include "executor.h"
+#include "json.h"
 #include "parser.h"
+#include "response.h"
+#include "router.h"
+
+static Router router;
+
+// Most operations a single batch request may carry.
+static const size_t MAX_BATCH_OPERATIONS = 4096;
+
+/**
+ * @enum StaticResponseID
+ * @brief Responses whose bytes never change from one request to the next.
+ */
+typedef enum {
+	STATIC_INVALID_METHOD,
+	STATIC_BAD_REQUEST,
+	STATIC_PAYLOAD_TOO_LARGE,
+	STATIC_UNKNOWN_ROUTE,
+	STATIC_NOT_FOUND,
+	STATIC_INTERNAL_ERROR,
+	STATIC_NOT_IMPLEMENTED,
+	STATIC_VERSION_NOT_SUPPORTED,
+	STATIC_POSTED,
+	STATIC_DELETED,
+	NUM_STATIC_RESPONSES,
+} StaticResponseID;
+
+/**
+ * @struct StaticResponse
+ * @brief A fixed response, serialized once by InitStaticResponses().
+ *
+ * Handlers return the embedded response, which AppendResponse() recognizes
+ * by is_static and sends as the serialized bytes, without formatting or
+ * allocating anything. The bytes are shared by all threads and never written
+ * after startup.
+ */
+typedef struct {
+	HTTPResponse response;	// Status and body, must be the first member
+	char* serialized[2];		// Status line, headers and body, by keep_alive
+	size_t lengths[2];			// Number of bytes in serialized
+} StaticResponse;
+
+static StaticResponse static_responses[NUM_STATIC_RESPONSES];
+
+static HTTPResponse* GetStaticResponse(StaticResponseID id) {
+	return &static_responses[id].response;
+}
 
 static HTTPResponse* HandleInvalidRequest() {
-	const char* body =
-			"{\r\n"
-			"\t\"status\": \"error\",\r\n"
-			"\t\"message\": \"Supported methods: GET, POST, DELETE.\"\r\n"
-			"}";
-
-	char header[BUFFER_SIZE];
-	if (snprintf(header,
-							 sizeof(header),
-							 "Content-Type: application/json\r\n"
-							 "Content-Length: %zu\r\n"
-							 "Connection: close\r\n",
-							 strlen(body)) < 0) {
+	return GetStaticResponse(STATIC_INVALID_METHOD);
+}
+
+static HTTPResponse* HandleBadRequest() {
+	return GetStaticResponse(STATIC_BAD_REQUEST);
+}
+
+static HTTPResponse* HandlePayloadTooLarge() {
+	return GetStaticResponse(STATIC_PAYLOAD_TOO_LARGE);
+}
+
+static HTTPResponse* HandleUnknownRoute() {
+	return GetStaticResponse(STATIC_UNKNOWN_ROUTE);
+}
+
+static HTTPResponse* HandleNotFound() {
+	return GetStaticResponse(STATIC_NOT_FOUND);
+}
+
+static HTTPResponse* HandleInternalError() {
+	return GetStaticResponse(STATIC_INTERNAL_ERROR);
+}
+
+static HTTPResponse* HandleNotImplemented() {
+	return GetStaticResponse(STATIC_NOT_IMPLEMENTED);
+}
+
+static HTTPResponse* HandleVersionNotSupported() {
+	return GetStaticResponse(STATIC_VERSION_NOT_SUPPORTED);
+}
+
+// Copies the key and value of a request into the arena of its connection,
+// where they stay until the response has been sent.
+static int PrepareOperation(Connection* connection,
+														DatabaseOperation* operation,
+														DatabaseOperationType type,
+														StringView key,
+														const StringView* value) {
+	operation->arena = &connection->arena;
+	operation->key = ArenaStrndup(operation->arena, key.data, key.length);
+	operation->value =
+			(value != NULL)
+					? ArenaStrndup(operation->arena, value->data, value->length)
+					: NULL;
+
+	if (operation->key == NULL || (value != NULL && operation->value == NULL)) {
 		(void)fprintf(stderr,
-									"Error: In HandleInvalidRequest(): snprintf() failed\n");
-		return NULL;
+									"Error: In PrepareOperation(): ArenaStrndup() failed\n");
+		ClearDatabaseOperation(operation);
+		return -1;
 	}
 
-	return CreateHTTPResponse((int)HTTP_INVALID_METHOD, header, body);
+	operation->type = type;
+	return 0;
 }
 
-static HTTPResponse* HandleBadRequest() {
-	const char* body =
-			"{\r\n"
-			"\t\"status\": \"error\",\r\n"
-			"\t\"message\": \"Bad request.\"\r\n"
-			"}";
-
-	char header[BUFFER_SIZE];
-	if (snprintf(header,
-							 sizeof(header),
-							 "Content-Type: application/json\r\n"
-							 "Content-Length: %zu\r\n"
-							 "Connection: close\r\n",
-							 strlen(body)) < 0) {
-		(void)fprintf(stderr, "Error: In HandleBadRequest(): snprintf() failed\n");
-		return NULL;
+// Extracts the value of the roll_num query parameter. Errors are reported on
+// behalf of the handler named caller.
+static int GetRollNumber(const RouteMatch* match,
+												 const char* caller,
+												 StringView* roll_num) {
+	if (!GetQueryParam(match, "roll_num", roll_num)) {
+		(void)fprintf(stderr,
+									"Error: In %s(): roll_num not present in the query\n",
+									caller);
+		return -1;
 	}
 
-	return CreateHTTPResponse((int)HTTP_BAD_REQUEST, header, body);
+	return 0;
 }
 
-static HTTPResponse* HandleNotFound() {
-	const char* body =
-			"{\r\n"
-			"\t\"status\": \"error\",\r\n"
-			"\t\"message\": \"roll_num not found.\"\r\n"
-			"}";
-
-	char header[BUFFER_SIZE];
-	if (snprintf(header,
-							 sizeof(header),
-							 "Content-Type: application/json\r\n"
-							 "Content-Length: %zu\r\n"
-							 "Connection: close\r\n",
-							 strlen(body)) < 0) {
-		(void)fprintf(stderr, "Error: In HandleNotFound(): snprintf() failed\n");
-		return NULL;
-	}
-
-	return CreateHTTPResponse((int)HTTP_NOT_FOUND, header, body);
-}
-
-static HTTPResponse* HandleGET(HTTPRequest* request) {
-	char* question_mark = strchr(request->path, '?');
-	if (question_mark == NULL) {
-		(void)fprintf(
-				stderr,
-				"Error: In HandleGET(): Invalid request path: '?' not present\n");
+static HTTPResponse* HandleGET(const HTTPRequest* request,
+															 const RouteMatch* match,
+															 void* context) {
+	(void)request;
+
+	Connection* connection = (Connection*)context;
+
+	StringView roll_num;
+	if (GetRollNumber(match, "HandleGET", &roll_num) < 0) {
 		return HandleBadRequest();
 	}
 
-	char* path = question_mark + 1;
+	if (PrepareOperation(connection,
+											 &connection->operation,
+											 DATABASE_GET,
+											 roll_num,
+											 NULL) < 0) {
+		return HandleInternalError();
+	}
 
-	char* equal_to = strchr(path, '=');
-	if (equal_to == NULL) {
-		(void)fprintf(
-				stderr,
-				"Error: In HandleGET(): Invalid request path: '=' not present\n");
-		return HandleBadRequest();
+	return NULL;
+}
+
+// Writes an object member whose value is a NUL-terminated string.
+static void WriteJSONMember(JSONWriter* writer,
+														const char* key,
+														const char* value) {
+	WriteJSONKey(writer, key);
+	WriteJSONString(writer, value, strlen(value));
+}
+
+static void WriteGETBody(JSONWriter* writer,
+												 const DatabaseOperation* operation) {
+	BeginJSONObject(writer);
+	WriteJSONMember(writer, "status", "success");
+	WriteJSONMember(writer, "roll_num", operation->key);
+	WriteJSONMember(writer, "name", operation->value);
+	EndJSONObject(writer);
+}
+
+// Writes the body of the answer to an operation, once to measure it and once
+// to fill it in.
+typedef void (*BodyWriter)(JSONWriter* writer,
+													 const DatabaseOperation* operation);
+
+// Answers an operation with a body written by write_body straight into the
+// response. Returns 0 on success, -1 on error.
+static int AppendJSONResponse(Connection* connection, BodyWriter write_body) {
+	const DatabaseOperation* operation = &connection->operation;
+
+	// The body is measured first, so that it is written once into space of
+	// exactly its size.
+	JSONWriter writer;
+	InitJSONWriter(&writer, NULL);
+	write_body(&writer, operation);
+
+	ResponseBuilder builder;
+	(void)BeginResponse(&builder, connection, (int)HTTP_OK, 0);
+
+	char* body = ReserveResponseBody(&builder, writer.length);
+	if (body != NULL) {
+		InitJSONWriter(&writer, body);
+		write_body(&writer, operation);
+		CommitResponseBody(&builder, writer.length);
 	}
 
-	*equal_to = '\0';
-	if (strcmp(path, "roll_num") != 0) {
-		(void)fprintf(
-				stderr, "Error: In HandleGET(): Invalid key: %s\n", request->path);
-		return HandleBadRequest();
+	return FinishResponse(&builder);
+}
+
+// Adds one piece of a body that is written piece by piece, measuring it first
+// like AppendJSONResponse() does with a whole body. writer carries the layout
+// from one piece to the next. Returns 0 on success, -1 on error.
+static int AppendJSONPiece(ResponseBuilder* builder,
+													 JSONWriter* writer,
+													 BodyWriter write_piece,
+													 const DatabaseOperation* operation) {
+	JSONWriter measure = *writer;
+	measure.output = NULL;
+	measure.length = 0;
+	write_piece(&measure, operation);
+
+	char* output = ReserveResponseBody(builder, measure.length);
+	if (output == NULL) {
+		return -1;
 	}
 
-	char* after_equal_to = equal_to + 1;
+	writer->output = output;
+	writer->length = 0;
+	write_piece(writer, operation);
+	CommitResponseBody(builder, writer->length);
+
+	return 0;
+}
 
-	char* name = DatabaseGet(after_equal_to);
+/**
+ * @struct BodyMember
+ * @brief A member of a JSON object in a request body that a handler reads.
+ */
+typedef struct {
+	const char* name;	 // Name of the member
+	JSONToken value;	 // First token of its value
+	int is_present;		 // Non-zero once the member has been seen
+} BodyMember;
 
-	if (name == NULL) {
-		(void)fprintf(stderr, "Error: In HandleGET(): DatabaseGet() failed\n");
-		return HandleNotFound();
+// Returns the member a key token names, unless it has been seen before, in
+// which case the first of the duplicates wins.
+static BodyMember* MatchBodyMember(BodyMember* members,
+																	 size_t num_members,
+																	 const JSONToken* key) {
+	for (size_t i = 0; i < num_members; i++) {
+		if (!members[i].is_present && JSONStringEquals(key, members[i].name)) {
+			members[i].is_present = 1;
+			return &members[i];
+		}
 	}
 
-	char body[BUFFER_SIZE];
-	if (snprintf(body,
-							 sizeof(body),
-							 "{\r\n"
-							 "\t\"status\": \"success\",\r\n"
-							 "\t\"roll_num\": \"%s\",\r\n"
-							 "\t\"name\": \"%s\"\r\n"
-							 "}",
-							 after_equal_to,
-							 name) < 0) {
-		(void)fprintf(stderr, "Error: In HandleGET(): snprintf() failed\n");
+	return NULL;
+}
+
+// Reads the members of a POST body, which must be a JSON object. Nested
+// values are skipped, and the first of duplicate members wins. Returns 0 on
+// success, -1 if the body is malformed, -2 if a member is missing, or -3 if a
+// member is not a string.
+static int ReadPOSTBody(StringView body, JSONToken* roll_num, JSONToken* name) {
+	JSONTokenizer tokenizer;
+	JSONToken token;
+
+	InitJSONTokenizer(&tokenizer, body.data, body.length);
+	if (NextJSONToken(&tokenizer, &token) != JSON_OBJECT_START) {
+		return -1;
 	}
 
-	char header[BUFFER_SIZE];
-	if (snprintf(header,
-							 sizeof(header),
-							 "Content-Type: application/json\r\n"
-							 "Content-Length: %zu\r\n"
-							 "Connection: close\r\n",
-							 strlen(body)) < 0) {
-		(void)fprintf(stderr, "Error: In HandleGET(): snprintf() failed\n");
+	BodyMember members[] = {{.name = "roll_num"}, {.name = "name"}};
+	BodyMember* target = NULL;
+
+	for (;;) {
+		JSONTokenType type = NextJSONToken(&tokenizer, &token);
+		if (type == JSON_ERROR) {
+			return -1;
+		}
+		if (type == JSON_END) {
+			break;
+		}
+		if (token.depth != 1) {
+			continue;
+		}
+
+		if (type == JSON_KEY) {
+			target = MatchBodyMember(
+					members, sizeof(members) / sizeof(members[0]), &token);
+		} else if (target != NULL) {
+			target->value = token;
+			target = NULL;
+		}
 	}
 
-	free(name);
+	if (!members[0].is_present || !members[1].is_present) {
+		return -2;
+	}
 
-	return CreateHTTPResponse((int)HTTP_OK, header, body);
+	*roll_num = members[0].value;
+	*name = members[1].value;
+	if (roll_num->type != JSON_STRING || name->type != JSON_STRING) {
+		return -3;
+	}
+
+	return 0;
 }
 
-static HTTPResponse* HandlePOST(HTTPRequest* request) {
-	if (strstr(request->headers, "Content-Type: application/json") == NULL) {
-		(void)fprintf(
-				stderr,
-				"Error: In HandlePOST(): Content-Type is not application/json\n");
-		return HandleBadRequest();
+// Points view at the text of a string token, decoded into the arena if it has
+// escapes. Returns 0 on success, -1 on error or if the text holds a NUL byte,
+// which the database would cut it short at.
+static int DecodeJSONToken(Arena* arena,
+													 const JSONToken* token,
+													 StringView* view) {
+	if (!token->has_escapes) {
+		*view = token->text;
+		return 0;
 	}
 
-	char* roll_num_key = strstr(request->body, "\"roll_num\"");
-	char* name_key = strstr(request->body, "\"name\"");
+	char* decoded = (char*)ArenaAllocate(arena, token->text.length);
+	if (decoded == NULL ||
+			UnescapeJSONString(token->text, decoded, &view->length) < 0) {
+		return -1;
+	}
 
-	if (roll_num_key == NULL || name_key == NULL) {
+	view->data = decoded;
+	return (memchr(decoded, '\0', view->length) == NULL) ? 0 : -1;
+}
+
+// Compares the media type of a Content-Type value, ignoring case and any
+// parameters such as "; charset=utf-8".
+static int IsMediaType(StringView content_type, const char* media_type) {
+	size_t length = 0;
+	while (length < content_type.length && content_type.data[length] != ';') {
+		length++;
+	}
+	while (length > 0 && (content_type.data[length - 1] == ' ' ||
+												content_type.data[length - 1] == '\t')) {
+		length--;
+	}
+
+	return length == strlen(media_type) &&
+				 strncasecmp(content_type.data, media_type, length) == 0;
+}
+
+// Checks that a request declares a JSON body. Errors are reported on behalf
+// of the handler named caller.
+static int HasJSONBody(const HTTPRequest* request, const char* caller) {
+	StringView content_type;
+	if (!GetKnownHTTPHeader(request, HEADER_CONTENT_TYPE, &content_type) ||
+			!IsMediaType(content_type, "application/json")) {
 		(void)fprintf(stderr,
-									"Error: In HandlePOST(): Missing roll_num or name in body\n");
+									"Error: In %s(): Content-Type is not application/json\n",
+									caller);
+		return 0;
+	}
+
+	return 1;
+}
+
+static HTTPResponse* HandlePOST(const HTTPRequest* request,
+																const RouteMatch* match,
+																void* context) {
+	(void)match;
+
+	Connection* connection = (Connection*)context;
+
+	if (!HasJSONBody(request, "HandlePOST")) {
 		return HandleBadRequest();
 	}
 
-	char* roll_num_start = strchr(roll_num_key, ':');
-	if (roll_num_start == NULL) {
-		(void)fprintf(stderr, "Error: In HandlePOST(): Invalid roll_num format\n");
+	JSONToken roll_num_token;
+	JSONToken name_token;
+	switch (ReadPOSTBody(request->body, &roll_num_token, &name_token)) {
+		case -1:
+			(void)fprintf(stderr, "Error: In HandlePOST(): Malformed JSON body\n");
+			return HandleBadRequest();
+		case -2:
+			(void)fprintf(stderr,
+										"Error: In HandlePOST(): Missing roll_num or name in body\n");
+			return HandleBadRequest();
+		case -3:
+			(void)fprintf(
+					stderr, "Error: In HandlePOST(): roll_num and name must be strings\n");
+			return HandleBadRequest();
+		default:
+			break;
+	}
+
+	StringView roll_num;
+	StringView name;
+	if (DecodeJSONToken(&connection->arena, &roll_num_token, &roll_num) < 0 ||
+			DecodeJSONToken(&connection->arena, &name_token, &name) < 0) {
+		(void)fprintf(stderr,
+									"Error: In HandlePOST(): Invalid roll_num or name value\n");
 		return HandleBadRequest();
 	}
-	roll_num_start++;
-	while (*roll_num_start == ' ' || *roll_num_start == '\"') {
-		roll_num_start++;
+
+	if (PrepareOperation(connection,
+											 &connection->operation,
+											 DATABASE_POST,
+											 roll_num,
+											 &name) < 0) {
+		return HandleInternalError();
 	}
 
-	char* roll_num_end = strchr(roll_num_start, '\"');
-	if (roll_num_end == NULL) {
-		(void)fprintf(stderr, "Error: In HandlePOST(): Invalid roll_num value\n");
+	return NULL;
+}
+
+static HTTPResponse* CompletePOST(DatabaseOperation* operation) {
+	if (operation->result == 0) {
+		(void)fprintf(stderr, "Error: In CompletePOST(): DatabasePost() failed\n");
 		return HandleBadRequest();
 	}
-	*roll_num_end = '\0';
 
-	char* name_start = strchr(name_key, ':');
-	if (name_start == NULL) {
-		(void)fprintf(stderr, "Error: In HandlePOST(): Invalid name format\n");
+	return GetStaticResponse(STATIC_POSTED);
+}
+
+static HTTPResponse* HandleDELETE(const HTTPRequest* request,
+																	const RouteMatch* match,
+																	void* context) {
+	(void)request;
+
+	Connection* connection = (Connection*)context;
+
+	StringView roll_num;
+	if (GetRollNumber(match, "HandleDELETE", &roll_num) < 0) {
 		return HandleBadRequest();
 	}
-	name_start++;
-	while (*name_start == ' ' || *name_start == '\"') {
-		name_start++;
+
+	if (PrepareOperation(connection,
+											 &connection->operation,
+											 DATABASE_DELETE,
+											 roll_num,
+											 NULL) < 0) {
+		return HandleInternalError();
 	}
 
-	char* name_end = strchr(name_start, '\"');
-	if (name_end == NULL) {
-		(void)fprintf(stderr, "Error: In HandlePOST(): Invalid name value\n");
-		return HandleBadRequest();
+	return NULL;
+}
+
+static HTTPResponse* CompleteDELETE(DatabaseOperation* operation) {
+	if (operation->result == 0) {
+		(void)fprintf(stderr,
+									"Error: In CompleteDELETE(): DatabaseDelete() failed\n");
+		return HandleNotFound();
 	}
-	*name_end = '\0';
 
-	if (DatabasePost(roll_num_start, name_start) == 0) {
-		(void)fprintf(stderr, "Error: In HandlePOST(): DatabasePost() failed\n");
-		return HandleBadRequest();
+	return GetStaticResponse(STATIC_DELETED);
+}
+
+// Counts the operations in a batch body, which must be a JSON array of
+// objects. Returns 0 if the body is malformed or empty.
+static size_t CountBatchOperations(StringView body) {
+	JSONTokenizer tokenizer;
+	JSONToken token;
+
+	InitJSONTokenizer(&tokenizer, body.data, body.length);
+	if (NextJSONToken(&tokenizer, &token) != JSON_ARRAY_START) {
+		return 0;
+	}
+
+	size_t count = 0;
+	for (;;) {
+		JSONTokenType type = NextJSONToken(&tokenizer, &token);
+		if (type == JSON_ERROR) {
+			return 0;
+		}
+		if (type == JSON_END) {
+			break;
+		}
+		if (token.depth != 1) {
+			continue;
+		}
+
+		if (type == JSON_OBJECT_START) {
+			count++;
+		} else if (type != JSON_OBJECT_END) {
+			return 0;
+		}
+	}
+
+	return count;
+}
+
+// Turns the members of an item of a batch body into an operation. Returns 0
+// on success, -2 if a member is missing, -3 if a member is not a string or
+// the method is unknown, or -4 on error.
+static int PrepareBatchItem(Connection* connection,
+														DatabaseOperation* item,
+														const BodyMember* method,
+														const BodyMember* roll_num,
+														const BodyMember* name) {
+	if (!method->is_present || !roll_num->is_present) {
+		return -2;
+	}
+
+	if (method->value.type != JSON_STRING ||
+			roll_num->value.type != JSON_STRING) {
+		return -3;
+	}
+
+	DatabaseOperationType type = DATABASE_NONE;
+	if (JSONStringEquals(&method->value, "GET")) {
+		type = DATABASE_GET;
+	} else if (JSONStringEquals(&method->value, "POST")) {
+		type = DATABASE_POST;
+	} else if (JSONStringEquals(&method->value, "DELETE")) {
+		type = DATABASE_DELETE;
+	} else {
+		return -3;
 	}
 
-	char body[BUFFER_SIZE];
-	if (snprintf(body,
-							 sizeof(body),
-							 "{\r\n"
-							 "\t\"status\": \"success\",\r\n"
-							 "\t\"message\": \"Record added successfully.\"\r\n"
-							 "}") < 0) {
-		(void)fprintf(stderr, "Error: In HandlePOST(): snprintf() failed\n");
+	StringView key;
+	if (DecodeJSONToken(&connection->arena, &roll_num->value, &key) < 0) {
+		return -3;
 	}
 
-	char header[BUFFER_SIZE];
-	if (snprintf(header,
-							 sizeof(header),
-							 "Content-Type: application/json\r\n"
-							 "Content-Length: %zu\r\n"
-							 "Connection: close\r\n",
-							 strlen(body)) < 0) {
-		(void)fprintf(stderr, "Error: In HandlePOST(): snprintf() failed\n");
+	if (type != DATABASE_POST) {
+		return PrepareOperation(connection, item, type, key, NULL) < 0 ? -4 : 0;
 	}
 
-	return CreateHTTPResponse((int)HTTP_OK, header, body);
+	if (!name->is_present) {
+		return -2;
+	}
+
+	StringView value;
+	if (name->value.type != JSON_STRING ||
+			DecodeJSONToken(&connection->arena, &name->value, &value) < 0) {
+		return -3;
+	}
+
+	return PrepareOperation(connection, item, type, key, &value) < 0 ? -4 : 0;
 }
 
-static HTTPResponse* HandleDELETE(HTTPRequest* request) {
-	char* question_mark = strchr(request->path, '?');
-	if (question_mark == NULL) {
-		(void)fprintf(
-				stderr,
-				"Error: In HandleDELETE(): Invalid request path: '?' not present\n");
-		return HandleBadRequest();
+// Reads the items of a batch body, already counted by CountBatchOperations(),
+// into operations. Returns 0 on success, or the error of the first item that
+// PrepareBatchItem() rejects.
+static int ReadBatchBody(Connection* connection,
+												 StringView body,
+												 DatabaseOperation* operations) {
+	JSONTokenizer tokenizer;
+	JSONToken token;
+
+	InitJSONTokenizer(&tokenizer, body.data, body.length);
+
+	BodyMember members[3];
+	BodyMember* target = NULL;
+	size_t index = 0;
+
+	for (;;) {
+		JSONTokenType type = NextJSONToken(&tokenizer, &token);
+		if (type == JSON_ERROR) {
+			return -1;
+		}
+		if (type == JSON_END) {
+			break;
+		}
+
+		if (token.depth == 1 && type == JSON_OBJECT_START) {
+			memset(members, 0, sizeof(members));
+			members[0].name = "method";
+			members[1].name = "roll_num";
+			members[2].name = "name";
+			target = NULL;
+		} else if (token.depth == 1 && type == JSON_OBJECT_END) {
+			int result = PrepareBatchItem(connection,
+																		&operations[index++],
+																		&members[0],
+																		&members[1],
+																		&members[2]);
+			if (result < 0) {
+				return result;
+			}
+		} else if (token.depth == 2 && type == JSON_KEY) {
+			target = MatchBodyMember(members, 3, &token);
+		} else if (token.depth == 2 && target != NULL) {
+			target->value = token;
+			target = NULL;
+		}
 	}
 
-	char* path = question_mark + 1;
+	return 0;
+}
+
+static HTTPResponse* HandleBatch(const HTTPRequest* request,
+																 const RouteMatch* match,
+																 void* context) {
+	(void)match;
 
-	char* equal_to = strchr(path, '=');
-	if (equal_to == NULL) {
-		(void)fprintf(
-				stderr,
-				"Error: In HandleDELETE(): Invalid request path: '=' not present\n");
+	Connection* connection = (Connection*)context;
+
+	if (!HasJSONBody(request, "HandleBatch")) {
 		return HandleBadRequest();
 	}
 
-	*equal_to = '\0';
-	if (strcmp(path, "roll_num") != 0) {
-		(void)fprintf(
-				stderr, "Error: In HandleDELETE(): Invalid key: %s\n", request->path);
+	size_t count = CountBatchOperations(request->body);
+	if (count == 0) {
+		(void)fprintf(stderr,
+									"Error: In HandleBatch(): Body is not a non-empty array of "
+									"objects\n");
 		return HandleBadRequest();
 	}
 
-	char* after_equal_to = equal_to + 1;
+	if (count > MAX_BATCH_OPERATIONS) {
+		(void)fprintf(stderr,
+									"Error: In HandleBatch(): %zu operations exceed the limit of "
+									"%zu\n",
+									count,
+									MAX_BATCH_OPERATIONS);
+		return HandlePayloadTooLarge();
+	}
 
-	if (DatabaseDelete(after_equal_to) == 0) {
+	DatabaseOperation* operations = (DatabaseOperation*)ArenaAllocate(
+			&connection->arena, count * sizeof(DatabaseOperation));
+	if (operations == NULL) {
 		(void)fprintf(stderr,
-									"Error: In HandleDELETE(): DatabaseDelete() failed\n");
-		return HandleNotFound();
+									"Error: In HandleBatch(): ArenaAllocate() failed\n");
+		return HandleInternalError();
+	}
+	memset(operations, 0, count * sizeof(DatabaseOperation));
+
+	switch (ReadBatchBody(connection, request->body, operations)) {
+		case -2:
+			(void)fprintf(
+					stderr,
+					"Error: In HandleBatch(): Missing method, roll_num or name in an "
+					"operation\n");
+			return HandleBadRequest();
+		case -3:
+			(void)fprintf(stderr,
+										"Error: In HandleBatch(): Invalid method, roll_num or name "
+										"value in an operation\n");
+			return HandleBadRequest();
+		case -4:
+			return HandleInternalError();
+		default:
+			break;
+	}
+
+	DatabaseOperation* operation = &connection->operation;
+	operation->type = DATABASE_BATCH;
+	operation->arena = &connection->arena;
+	operation->batch = operations;
+	operation->batch_length = count;
+
+	return NULL;
+}
+
+// Writes the outcome of one operation of a batch, with the message its own
+// request would have been answered with.
+static void WriteBatchItem(JSONWriter* writer,
+													 const DatabaseOperation* operation) {
+	const char* message = NULL;
+
+	switch (operation->type) {
+		case DATABASE_POST:
+			message = operation->result ? "Record added successfully."
+																	: "Record could not be added.";
+			break;
+		case DATABASE_DELETE:
+			message = operation->result ? "roll_num deleted successfully."
+																	: "roll_num not found.";
+			break;
+		default:
+			message = operation->result ? NULL : "roll_num not found.";
+			break;
+	}
+
+	BeginJSONObject(writer);
+	WriteJSONMember(writer, "status", operation->result ? "success" : "error");
+	WriteJSONMember(writer, "roll_num", operation->key);
+	if (message != NULL) {
+		WriteJSONMember(writer, "message", message);
+	} else {
+		WriteJSONMember(writer, "name", operation->value);
 	}
+	EndJSONObject(writer);
+}
+
+static void WriteBatchHead(JSONWriter* writer,
+													 const DatabaseOperation* operation) {
+	(void)operation;
+
+	BeginJSONObject(writer);
+	WriteJSONMember(writer, "status", "success");
+	WriteJSONKey(writer, "results");
+	BeginJSONArray(writer);
+}
+
+static void WriteBatchTail(JSONWriter* writer,
+													 const DatabaseOperation* operation) {
+	(void)operation;
+
+	EndJSONArray(writer);
+	EndJSONObject(writer);
+}
+
+// Answers a batch one result at a time, so that its body is never measured
+// or held as a whole. HTTP/1.1 clients get it in chunks, which are sent while
+// the rest is still being written. Returns 0 on success, -1 on error.
+static int AppendBatchResponse(Connection* connection) {
+	const DatabaseOperation* operation = &connection->operation;
+
+	ResponseBuilder builder;
+	(void)BeginResponse(
+			&builder, connection, (int)HTTP_OK, connection->accepts_chunked);
+
+	JSONWriter writer;
+	InitJSONWriter(&writer, NULL);
+
+	// Failures are remembered by the builder and reported by FinishResponse().
+	(void)AppendJSONPiece(&builder, &writer, WriteBatchHead, operation);
+	for (size_t i = 0; i < operation->batch_length && !builder.has_failed;
+			 i++) {
+		(void)AppendJSONPiece(
+				&builder, &writer, WriteBatchItem, &operation->batch[i]);
+	}
+	(void)AppendJSONPiece(&builder, &writer, WriteBatchTail, operation);
+
+	return FinishResponse(&builder);
+}
+
+// Checks whether a request is HTTP/1.1 or a later 1.x version.
+static int IsHTTP11(const HTTPRequest* request) {
+	return GetHTTPMinorVersion(request) >= 1;
+}
+
+static int IsHeaderSpace(char c) {
+	return c == ' ' || c == '\t';
+}
+
+// Checks whether a comma-separated header value such as that of Connection
+// lists token, ignoring case and the whitespace around each element.
+static int HasHeaderToken(StringView value, const char* token) {
+	size_t token_length = strlen(token);
+	const char* position = value.data;
+	const char* end = value.data + value.length;
 
-	char body[BUFFER_SIZE];
-	if (snprintf(body,
-							 sizeof(body),
-							 "{\r\n"
-							 "\t\"status\": \"success\",\r\n"
-							 "\t\"message\": \"roll_num deleted successfully.\"\r\n"
-							 "}") < 0) {
-		(void)fprintf(stderr, "Error: In HandleDELETE(): snprintf() failed\n");
+	while (position < end) {
+		const char* separator =
+				(const char*)memchr(position, ',', (size_t)(end - position));
+		if (separator == NULL) {
+			separator = end;
+		}
+
+		const char* element_end = separator;
+		while (position < element_end && IsHeaderSpace(*position)) {
+			position++;
+		}
+		while (element_end > position && IsHeaderSpace(element_end[-1])) {
+			element_end--;
+		}
+
+		if ((size_t)(element_end - position) == token_length &&
+				strncasecmp(position, token, token_length) == 0) {
+			return 1;
+		}
+
+		position = (separator < end) ? separator + 1 : end;
 	}
 
-	char header[BUFFER_SIZE];
-	if (snprintf(header,
-							 sizeof(header),
-							 "Content-Type: application/json\r\n"
-							 "Content-Length: %zu\r\n"
-							 "Connection: close\r\n",
-							 strlen(body)) < 0) {
-		(void)fprintf(stderr, "Error: In HandleDELETE(): snprintf() failed\n");
+	return 0;
+}
+
+static int WantsKeepAlive(const HTTPRequest* request) {
+	StringView value;
+	if (GetKnownHTTPHeader(request, HEADER_CONNECTION, &value)) {
+		// close wins over keep-alive if a client sends both.
+		if (HasHeaderToken(value, "close")) {
+			return 0;
+		}
+
+		if (HasHeaderToken(value, "keep-alive")) {
+			return 1;
+		}
 	}
 
-	return CreateHTTPResponse((int)HTTP_OK, header, body);
+	// Persistent connections are the default from HTTP/1.1 onwards.
+	return IsHTTP11(request);
+}
+
+// Writes the status line and headers of response into output, like
+// snprintf(). Returns the length they take, or a negative value on error.
+static int FormatHeaders(char* output,
+												 size_t size,
+												 const HTTPResponse* response,
+												 int keep_alive) {
+	return FormatResponseHeaders(output,
+															 size,
+															 response->status_code,
+															 response->headers,
+															 0,
+															 response->body_length,
+															 keep_alive);
 }
 
-typedef enum { GET, POST, DELETE, INVALID } HTTPMethod;
+static int AppendResponse(Connection* connection, HTTPResponse* response) {
+	if (response->is_static) {
+		// Fixed responses are queued as they were serialized at startup.
+		const StaticResponse* shared = (const StaticResponse*)response;
+		int keep_alive = connection->keep_alive != 0;
+
+		return AppendOutput(connection,
+												shared->serialized[keep_alive],
+												shared->lengths[keep_alive],
+												0);
+	}
+
+	int length = FormatHeaders(NULL, 0, response, connection->keep_alive);
+	if (length < 0) {
+		(void)fprintf(stderr, "Error: In AppendResponse(): snprintf() failed\n");
+		return -1;
+	}
 
-static HTTPMethod GetHTTPMethod(const char* method) {
-	if (strcmp(method, "GET") == 0) {
-		return GET;
+	char* output = ReserveOutput(connection, (size_t)length);
+	if (output == NULL) {
+		return -1;
 	}
 
-	if (strcmp(method, "POST") == 0) {
-		return POST;
+	(void)FormatHeaders(
+			output, (size_t)length + 1, response, connection->keep_alive);
+	if (CommitOutput(connection, (size_t)length) < 0) {
+		return -1;
 	}
 
-	if (strcmp(method, "DELETE") == 0) {
-		return DELETE;
+	if (response->body == NULL || response->body_length == 0) {
+		return 0;
 	}
 
-	return INVALID;
+	// The body is sent from where the handler left it; an owned body is handed
+	// over to the connection.
+	int owns_body = response->owns_body;
+	response->owns_body = 0;
+
+	return AppendOutput(
+			connection, response->body, response->body_length, owns_body);
 }
 
-void HandleTransaction(int client_socket) {
-	char buffer[BUFFER_SIZE];
-	int read_size = 0;
+static int CompleteOperation(Connection* connection) {
+	DatabaseOperation* operation = &connection->operation;
+	HTTPResponse* response = NULL;
+	int result = -1;
 
-	read_size = (int)read(client_socket, buffer, sizeof(buffer) - 1);
-	if (read_size < 0) {
-		(void)fprintf(stderr, "Error: In HandleTransaction(): read() failed\n");
-		return;
+	switch (operation->type) {
+		case DATABASE_GET:
+			if (operation->value != NULL) {
+				result = AppendJSONResponse(connection, WriteGETBody);
+			} else {
+				(void)fprintf(stderr,
+											"Error: In CompleteOperation(): DatabaseGet() failed\n");
+				response = HandleNotFound();
+			}
+			break;
+		case DATABASE_POST:
+			response = CompletePOST(operation);
+			break;
+		case DATABASE_DELETE:
+			response = CompleteDELETE(operation);
+			break;
+		case DATABASE_BATCH:
+			result = AppendBatchResponse(connection);
+			break;
+		case DATABASE_NONE:
+			break;
 	}
-	if (read_size == 0) {
-		// (void)fprintf(stderr,
-		// 							"Error: In HandleTransaction(): Client sent no data\n");
-		return;
+
+	if (response != NULL) {
+		result = AppendResponse(connection, response);
 	}
 
-	buffer[read_size] = '\0';
+	FreeHTTPResponse(response);
+	ClearDatabaseOperation(operation);
+
+	return result;
+}
 
-	HTTPRequest* request = ParseHTTPRequest(buffer);
+// Returns 1 if the database operation of the request is pending, 0 if the
+// request has been answered, or -1 on error.
+static int HandleRequest(Connection* connection,
+												 const char* data,
+												 size_t length) {
+	HTTPRequest request;
 
-	if (request == NULL) {
+	if (ParseHTTPRequest(data, length, &request) < 0) {
 		(void)fprintf(stderr,
-									"Error: In HandleTransaction(): ParseHTTPRequest() failed\n");
-		return;
+									"Error: In HandleRequest(): ParseHTTPRequest() failed\n");
+		return -1;
 	}
 
+	connection->num_requests++;
+
+	// The framing of any other version is unknown, so nothing after the
+	// request can be read either.
+	if (GetHTTPMinorVersion(&request) < 0) {
+		connection->keep_alive = 0;
+		connection->accepts_chunked = 0;
+		FreeHTTPRequest(&request);
+		return AppendResponse(connection, HandleVersionNotSupported());
+	}
+
+	connection->keep_alive = is_server_running && WantsKeepAlive(&request) &&
+													 connection->num_requests < MAX_KEEP_ALIVE_REQUESTS;
+	connection->accepts_chunked = IsHTTP11(&request);
+
 	HTTPResponse* response = NULL;
+	DatabaseOperation* operation = &connection->operation;
 
-	HTTPMethod method = GetHTTPMethod(request->method);
+	Arena* arena = &connection->arena;
+	RouteMatch match;
 
-	switch (method) {
-		case GET:
-			response = HandleGET(request);
+	switch (MatchRoute(&router, &request, arena, &match)) {
+		case ROUTE_FOUND:
+			response = match.handler(&request, &match, connection);
 			break;
-		case POST:
-			response = HandlePOST(request);
+		case ROUTE_NOT_FOUND:
+			response = HandleUnknownRoute();
 			break;
-		case DELETE:
-			response = HandleDELETE(request);
-			break;
-		case INVALID:
+		case ROUTE_METHOD_NOT_ALLOWED:
 			response = HandleInvalidRequest();
 			break;
+		case ROUTE_BAD_QUERY:
+			(void)fprintf(stderr, "Error: In HandleRequest(): Malformed query\n");
+			response = HandleBadRequest();
+			break;
+		case ROUTE_ERROR:
+			break;
+	}
+
+	FreeHTTPRequest(&request);
+
+	if (operation->type != DATABASE_NONE) {
+		return 1;
+	}
+
+	int result = -1;
+	if (response != NULL) {
+		result = AppendResponse(connection, response);
 	}
 
-	char response_buffer[BUFFER_SIZE];
-	if (snprintf(response_buffer,
-							 sizeof(response_buffer),
-							 "HTTP/1.1 %d\r\n"
-							 "%s\r\n"
-							 "%s",
-							 response->status_code,
-							 response->headers,
-							 response->body) < 0) {
-		(void)fprintf(stderr, "Error: In HandleTransaction(): snprintf() failed\n");
+	FreeHTTPResponse(response);
+
+	return result;
+}
+
+static void HandleUnreadableRequest(Connection* connection) {
+	HTTPResponse* response = NULL;
+	switch (connection->state) {
+		case REQUEST_TOO_LARGE:
+			response = HandlePayloadTooLarge();
+			break;
+		case REQUEST_UNSUPPORTED:
+			response = HandleNotImplemented();
+			break;
+		default:
+			response = HandleBadRequest();
+			break;
 	}
 
-	if (write(client_socket, response_buffer, strlen(response_buffer)) < 0) {
-		(void)fprintf(stderr, "Error: In HandleTransaction(): write() failed\n");
+	if (response != NULL) {
+		(void)AppendResponse(connection, response);
 	}
 
-	FreeHTTPRequest(request);
 	FreeHTTPResponse(response);
 }
 
+// Drops the answered request at offset. Returns 0 if the batch ends with it.
+static int FinishRequest(Connection* connection, int result) {
+	ConsumeRequest(connection);
+
+	if (result < 0) {
+		connection->keep_alive = 0;
+	}
+
+	if (!connection->keep_alive) {
+		connection->offset = connection->length;
+		return 0;
+	}
+
+	return 1;
+}
+
+int HandleTransaction(Connection* connection) {
+	if (connection == NULL) {
+		return 0;
+	}
+
+	if (connection->operation.type != DATABASE_NONE) {
+		// The database stage has run the operation of the request at offset.
+		if (!FinishRequest(connection, CompleteOperation(connection))) {
+			return 0;
+		}
+	} else {
+		if (connection->length == 0) {
+			return 0;
+		}
+
+		connection->keep_alive = 0;
+	}
+
+	for (size_t i = 0; i < MAX_PIPELINED_REQUESTS; i++) {
+		if (!IsRequestComplete(connection)) {
+			break;
+		}
+
+		if (connection->state != REQUEST_COMPLETE) {
+			connection->keep_alive = 0;
+			HandleUnreadableRequest(connection);
+			ConsumeRequest(connection);
+			break;
+		}
+
+		// The parser only takes views into the buffer, which stays untouched
+		// until the request is consumed.
+		int result =
+				HandleRequest(connection,
+											connection->buffer + connection->offset,
+											connection->header_length + connection->body_length);
+
+		if (result > 0) {
+			if (SubmitDatabaseOperation(connection) == 0) {
+				return 1;
+			}
+
+			ExecuteDatabaseOperation(&connection->operation);
+			result = CompleteOperation(connection);
+		}
+
+		if (!FinishRequest(connection, result)) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+// Serializes a fixed response in both of its Connection header variants.
+static int SetStaticResponse(StaticResponseID id,
+														 size_t status_code,
+														 const char* body) {
+	StaticResponse* shared = &static_responses[id];
+	HTTPResponse* response = &shared->response;
+
+	memset(shared, 0, sizeof(StaticResponse));
+	response->status_code = (int)status_code;
+	response->body = (char*)body;
+	response->body_length = strlen(body);
+	response->is_static = 1;
+
+	for (int keep_alive = 0; keep_alive < 2; keep_alive++) {
+		int length = FormatHeaders(NULL, 0, response, keep_alive);
+		if (length < 0) {
+			(void)fprintf(stderr,
+										"Error: In SetStaticResponse(): snprintf() failed\n");
+			return -1;
+		}
+
+		size_t total = (size_t)length + response->body_length;
+		char* serialized = (char*)malloc(total + 1);
+		if (serialized == NULL) {
+			perror("Error: In SetStaticResponse(): malloc() failed");
+			return -1;
+		}
+
+		(void)FormatHeaders(serialized, (size_t)length + 1, response, keep_alive);
+		memcpy(serialized + length, body, response->body_length + 1);
+
+		shared->serialized[keep_alive] = serialized;
+		shared->lengths[keep_alive] = total;
+	}
+
+	return 0;
+}
+
+void InitStaticResponses() {
+	const struct {
+		size_t status_code;
+		const char* body;
+	} fixed[NUM_STATIC_RESPONSES] = {
+			[STATIC_INVALID_METHOD] = {HTTP_INVALID_METHOD,
+																 "{\r\n"
+																 "\t\"status\": \"error\",\r\n"
+																 "\t\"message\": \"Supported methods: GET, "
+																 "POST, DELETE.\"\r\n"
+																 "}"},
+			[STATIC_BAD_REQUEST] = {HTTP_BAD_REQUEST,
+															"{\r\n"
+															"\t\"status\": \"error\",\r\n"
+															"\t\"message\": \"Bad request.\"\r\n"
+															"}"},
+			[STATIC_PAYLOAD_TOO_LARGE] = {HTTP_PAYLOAD_TOO_LARGE,
+																		"{\r\n"
+																		"\t\"status\": \"error\",\r\n"
+																		"\t\"message\": \"Request too large.\"\r\n"
+																		"}"},
+			[STATIC_UNKNOWN_ROUTE] = {HTTP_NOT_FOUND,
+																"{\r\n"
+																"\t\"status\": \"error\",\r\n"
+																"\t\"message\": \"Route not found.\"\r\n"
+																"}"},
+			[STATIC_NOT_FOUND] = {HTTP_NOT_FOUND,
+														"{\r\n"
+														"\t\"status\": \"error\",\r\n"
+														"\t\"message\": \"roll_num not found.\"\r\n"
+														"}"},
+			[STATIC_INTERNAL_ERROR] = {HTTP_INTERNAL_ERROR,
+																 "{\r\n"
+																 "\t\"status\": \"error\",\r\n"
+																 "\t\"message\": \"Internal server error.\"\r\n"
+																 "}"},
+			[STATIC_NOT_IMPLEMENTED] = {HTTP_NOT_IMPLEMENTED,
+																	"{\r\n"
+																	"\t\"status\": \"error\",\r\n"
+																	"\t\"message\": \"Only the chunked transfer "
+																	"coding is supported.\"\r\n"
+																	"}"},
+			[STATIC_VERSION_NOT_SUPPORTED] = {HTTP_VERSION_NOT_SUPPORTED,
+																				"{\r\n"
+																				"\t\"status\": \"error\",\r\n"
+																				"\t\"message\": \"Only HTTP/1.x is "
+																				"supported.\"\r\n"
+																				"}"},
+			[STATIC_POSTED] = {HTTP_OK,
+												 "{\r\n"
+												 "\t\"status\": \"success\",\r\n"
+												 "\t\"message\": \"Record added successfully.\"\r\n"
+												 "}"},
+			[STATIC_DELETED] = {HTTP_OK,
+													"{\r\n"
+													"\t\"status\": \"success\",\r\n"
+													"\t\"message\": \"roll_num deleted "
+													"successfully.\"\r\n"
+													"}"},
+	};
+
+	for (int id = 0; id < NUM_STATIC_RESPONSES; id++) {
+		if (SetStaticResponse(
+						(StaticResponseID)id, fixed[id].status_code, fixed[id].body) < 0) {
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+void InitRoutes() {
+	if (InitRouter(&router) < 0 ||
+			AddRoute(&router, METHOD_GET, "/", HandleGET) < 0 ||
+			AddRoute(&router, METHOD_POST, "/", HandlePOST) < 0 ||
+			AddRoute(&router, METHOD_DELETE, "/", HandleDELETE) < 0 ||
+			AddRoute(&router, METHOD_POST, "/batch", HandleBatch) < 0) {
+		(void)fprintf(stderr, "Error: In InitRoutes(): AddRoute() failed\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void CleanupRoutes() {
+	CleanupRouter(&router);
+}
+
+void CleanupStaticResponses() {
+	for (int id = 0; id < NUM_STATIC_RESPONSES; id++) {
+		for (int keep_alive = 0; keep_alive < 2; keep_alive++) {
+			free(static_responses[id].serialized[keep_alive]);
+			static_responses[id].serialized[keep_alive] = NULL;
+		}
+	}
+}
+
 // src/transaction_handler.c
\ No newline at end of file
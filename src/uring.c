@@ -0,0 +1,636 @@
+#include "uring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "connection.h"
+#include "network.h"
+#include "thread_pool.h"
+
+static const unsigned RING_ENTRIES = 256;
+static const unsigned RING_BUFFER_COUNT = 256;	// Must be a power of two
+static const unsigned short RING_BUFFER_GROUP = 0;
+
+// The operation of a completion is stored in the low bits of its user_data,
+// the rest holds the Connection it belongs to (if any).
+typedef enum {
+	RING_OP_ACCEPT = 1,
+	RING_OP_EVENT,
+	RING_OP_RECV,
+	RING_OP_SEND,
+	RING_OP_CLOSE,
+	RING_OP_TIMEOUT,
+} RingOp;
+
+static const uint64_t RING_OP_MASK = 0x7;
+
+// Every receive is linked to this timeout, which closes idle connections.
+static struct __kernel_timespec idle_timeout;
+
+static uint64_t EncodeUserData(Connection* connection, RingOp op) {
+	return (uint64_t)(uintptr_t)connection | (uint64_t)op;
+}
+
+static int SetupRing(unsigned entries, struct io_uring_params* params) {
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int EnterRing(int ring_fd,
+										 unsigned to_submit,
+										 unsigned min_complete,
+										 unsigned flags,
+										 const void* arg,
+										 size_t arg_size) {
+	return (int)syscall(__NR_io_uring_enter,
+											ring_fd,
+											to_submit,
+											min_complete,
+											flags,
+											arg,
+											arg_size);
+}
+
+static int RegisterRing(int ring_fd,
+												unsigned opcode,
+												const void* arg,
+												unsigned nr_args) {
+	return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+static int SubmitAndWait(Ring* ring, unsigned wait_nr) {
+	__atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+	struct __kernel_timespec timeout = {.tv_sec = 1, .tv_nsec = 0};
+	struct io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	arg.sigmask_sz = _NSIG / 8;
+	arg.ts = (uint64_t)(uintptr_t)&timeout;
+
+	unsigned flags = IORING_ENTER_EXT_ARG;
+	if (wait_nr > 0) {
+		flags |= IORING_ENTER_GETEVENTS;
+	}
+
+	int submitted = EnterRing(ring->ring_fd,
+														ring->sq_local_tail - ring->sq_submitted,
+														wait_nr,
+														flags,
+														&arg,
+														sizeof(arg));
+	if (submitted < 0) {
+		if (errno == EINTR || errno == ETIME || errno == EBUSY ||
+				errno == EAGAIN) {
+			return 0;
+		}
+		perror("Error: In SubmitAndWait(): io_uring_enter() failed");
+		return -1;
+	}
+
+	ring->sq_submitted += (unsigned)submitted;
+	return 0;
+}
+
+// Makes sure that count entries can be taken from the submission queue, so
+// that linked entries are never left half-queued.
+static int ReserveSQEs(Ring* ring, unsigned count) {
+	unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+	if (ring->sq_local_tail - head + count > ring->sq_entries) {
+		if (SubmitAndWait(ring, 0) < 0) {
+			return -1;
+		}
+
+		head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+		if (ring->sq_local_tail - head + count > ring->sq_entries) {
+			(void)fprintf(stderr,
+										"Error: In ReserveSQEs(): Submission queue is full\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static struct io_uring_sqe* GetSQE(Ring* ring) {
+	if (ReserveSQEs(ring, 1) < 0) {
+		return NULL;
+	}
+
+	unsigned index = ring->sq_local_tail & ring->sq_mask;
+	struct io_uring_sqe* sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[index] = index;
+	ring->sq_local_tail++;
+
+	return sqe;
+}
+
+static void RecycleBuffer(Ring* ring, unsigned short buffer_id) {
+	unsigned short tail = ring->buf_ring->tail;
+	struct io_uring_buf* buffer =
+			&ring->buf_ring->bufs[tail & (RING_BUFFER_COUNT - 1)];
+
+	buffer->addr = (uint64_t)(uintptr_t)(ring->buffers +
+																			 (size_t)buffer_id * BUFFER_SIZE);
+	buffer->len = (uint32_t)BUFFER_SIZE;
+	buffer->bid = buffer_id;
+
+	__atomic_store_n(&ring->buf_ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void PrepareAccept(Ring* ring) {
+	struct io_uring_sqe* sqe = GetSQE(ring);
+	if (sqe == NULL) {
+		return;
+	}
+
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = ring->server_socket;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	sqe->user_data = EncodeUserData(NULL, RING_OP_ACCEPT);
+}
+
+static void PrepareEventRead(Ring* ring) {
+	struct io_uring_sqe* sqe = GetSQE(ring);
+	if (sqe == NULL) {
+		return;
+	}
+
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = ring->event_fd;
+	sqe->addr = (uint64_t)(uintptr_t)&ring->event_value;
+	sqe->len = sizeof(ring->event_value);
+	sqe->user_data = EncodeUserData(NULL, RING_OP_EVENT);
+}
+
+static int PrepareRecv(Ring* ring, Connection* connection) {
+	if (ReserveSQEs(ring, 2) < 0) {
+		return -1;
+	}
+
+	struct io_uring_sqe* sqe = GetSQE(ring);
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = connection->fd;
+	sqe->flags = IOSQE_BUFFER_SELECT | IOSQE_IO_LINK;
+	sqe->buf_group = RING_BUFFER_GROUP;
+	sqe->user_data = EncodeUserData(connection, RING_OP_RECV);
+
+	sqe = GetSQE(ring);
+	sqe->opcode = IORING_OP_LINK_TIMEOUT;
+	sqe->fd = -1;
+	sqe->addr = (uint64_t)(uintptr_t)&idle_timeout;
+	sqe->len = 1;
+	sqe->user_data = EncodeUserData(NULL, RING_OP_TIMEOUT);
+
+	return 0;
+}
+
+static void PrepareClose(Ring* ring, Connection* connection) {
+	// Once the close is queued the descriptor may be reused by another accept
+	// at any time, so the connection is tracked only through user_data.
+	UnregisterConnection(connection->fd);
+
+	struct io_uring_sqe* sqe = GetSQE(ring);
+	if (sqe == NULL) {
+		close(connection->fd);
+		FreeConnection(connection);
+		return;
+	}
+
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->fd = connection->fd;
+	sqe->user_data = EncodeUserData(connection, RING_OP_CLOSE);
+}
+
+static void PrepareSend(Ring* ring, Connection* connection) {
+	int count = BuildOutputVector(connection);
+	if (count <= 0 || ReserveSQEs(ring, 2) < 0) {
+		PrepareClose(ring, connection);
+		return;
+	}
+
+	// The message stays in the connection, as the kernel may read it only
+	// once the SQE is processed.
+	memset(&connection->message, 0, sizeof(connection->message));
+	connection->message.msg_iov = connection->iov;
+	connection->message.msg_iovlen = (size_t)count;
+
+	struct io_uring_sqe* sqe = GetSQE(ring);
+
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = connection->fd;
+	sqe->addr = (uint64_t)(uintptr_t)&connection->message;
+	sqe->len = 1;
+	sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+	sqe->user_data = EncodeUserData(connection, RING_OP_SEND);
+
+	// The close of a non-persistent connection is linked to its send, so both
+	// go out together; a failed send cancels the close.
+	if (!connection->keep_alive) {
+		sqe->flags = IOSQE_IO_LINK;
+		PrepareClose(ring, connection);
+	}
+}
+
+static void HandleAccept(Ring* ring, const struct io_uring_cqe* cqe) {
+	if (!(cqe->flags & IORING_CQE_F_MORE)) {
+		PrepareAccept(ring);
+	}
+
+	if (cqe->res < 0) {
+		(void)fprintf(stderr, "Error: In HandleAccept(): accept failed\n");
+		return;
+	}
+
+	int client_socket = cqe->res;
+
+	Connection* connection = CreateConnection(client_socket);
+	if (connection == NULL) {
+		close(client_socket);
+		return;
+	}
+
+	connection->ring = ring;
+
+	if (RegisterConnection(connection) < 0) {
+		FreeConnection(connection);
+		close(client_socket);
+		return;
+	}
+
+	if (PrepareRecv(ring, connection) < 0) {
+		CloseConnection(client_socket);
+	}
+}
+
+static void HandleRecv(Ring* ring,
+											 Connection* connection,
+											 const struct io_uring_cqe* cqe) {
+	if (cqe->res == -ENOBUFS) {
+		if (PrepareRecv(ring, connection) < 0) {
+			CloseConnection(connection->fd);
+		}
+		return;
+	}
+
+	if (cqe->res < 0) {
+		CloseConnection(connection->fd);
+		return;
+	}
+
+	if (cqe->res > 0) {
+		unsigned short buffer_id =
+				(unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+
+		AppendConnection(connection,
+										 ring->buffers + (size_t)buffer_id * BUFFER_SIZE,
+										 (size_t)cqe->res);
+		RecycleBuffer(ring, buffer_id);
+	}
+
+	if (!IsRequestComplete(connection)) {
+		if (cqe->res == 0 || PrepareRecv(ring, connection) < 0) {
+			CloseConnection(connection->fd);
+		}
+		return;
+	}
+
+	if (SubmitConnection(ring->pool, connection) != 0) {
+		CloseConnection(connection->fd);
+	}
+}
+
+static void HandleSend(Ring* ring,
+											 Connection* connection,
+											 const struct io_uring_cqe* cqe) {
+	// Failed sends of non-persistent connections cancel the linked close,
+	// whose completion frees the connection.
+	if (!connection->keep_alive) {
+		return;
+	}
+
+	if (cqe->res < 0 || (size_t)cqe->res < connection->pending_length) {
+		PrepareClose(ring, connection);
+		return;
+	}
+
+	ResetConnection(connection);
+
+	if (IsRequestComplete(connection)) {
+		if (SubmitConnection(ring->pool, connection) != 0) {
+			PrepareClose(ring, connection);
+		}
+		return;
+	}
+
+	if (PrepareRecv(ring, connection) < 0) {
+		PrepareClose(ring, connection);
+	}
+}
+
+static void HandleEvent(Ring* ring) {
+	PrepareEventRead(ring);
+
+	if (pthread_mutex_lock(&ring->lock) != 0) {
+		perror("Error: In HandleEvent(): pthread_mutex_lock() failed");
+		return;
+	}
+
+	for (size_t i = 0; i < ring->num_ready; i++) {
+		Connection* connection = GetConnection(ring->ready[i]);
+		if (connection != NULL) {
+			PrepareSend(ring, connection);
+		}
+	}
+	ring->num_ready = 0;
+
+	if (pthread_mutex_unlock(&ring->lock) != 0) {
+		perror("Error: In HandleEvent(): pthread_mutex_unlock() failed");
+	}
+}
+
+static void HandleCompletion(Ring* ring, const struct io_uring_cqe* cqe) {
+	RingOp op = (RingOp)(cqe->user_data & RING_OP_MASK);
+	Connection* connection =
+			(Connection*)(uintptr_t)(cqe->user_data & ~RING_OP_MASK);
+
+	switch (op) {
+		case RING_OP_ACCEPT:
+			HandleAccept(ring, cqe);
+			break;
+		case RING_OP_EVENT:
+			HandleEvent(ring);
+			break;
+		case RING_OP_RECV:
+			HandleRecv(ring, connection, cqe);
+			break;
+		case RING_OP_SEND:
+			HandleSend(ring, connection, cqe);
+			break;
+		case RING_OP_TIMEOUT:
+			// An expired timeout cancels its receive, which closes the connection.
+			break;
+		case RING_OP_CLOSE:
+			if (cqe->res == -ECANCELED) {
+				close(connection->fd);
+			}
+			FreeConnection(connection);
+			break;
+	}
+}
+
+static int MapRing(Ring* ring, const struct io_uring_params* params) {
+	size_t sq_size = params->sq_off.array + params->sq_entries * sizeof(unsigned);
+	size_t cq_size =
+			params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+
+	ring->rings_size = (sq_size > cq_size) ? sq_size : cq_size;
+	ring->rings = mmap(NULL,
+										 ring->rings_size,
+										 PROT_READ | PROT_WRITE,
+										 MAP_SHARED | MAP_POPULATE,
+										 ring->ring_fd,
+										 IORING_OFF_SQ_RING);
+	if (ring->rings == MAP_FAILED) {
+		perror("Error: In MapRing(): mmap() failed");
+		ring->rings = NULL;
+		return -1;
+	}
+
+	ring->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = (struct io_uring_sqe*)mmap(NULL,
+																					ring->sqes_size,
+																					PROT_READ | PROT_WRITE,
+																					MAP_SHARED | MAP_POPULATE,
+																					ring->ring_fd,
+																					IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		perror("Error: In MapRing(): mmap() failed");
+		ring->sqes = NULL;
+		return -1;
+	}
+
+	char* base = (char*)ring->rings;
+	ring->sq_head = (unsigned*)(base + params->sq_off.head);
+	ring->sq_tail = (unsigned*)(base + params->sq_off.tail);
+	ring->sq_mask = *(unsigned*)(base + params->sq_off.ring_mask);
+	ring->sq_entries = *(unsigned*)(base + params->sq_off.ring_entries);
+	ring->sq_array = (unsigned*)(base + params->sq_off.array);
+	ring->sq_local_tail = *ring->sq_tail;
+	ring->sq_submitted = ring->sq_local_tail;
+	ring->cq_head = (unsigned*)(base + params->cq_off.head);
+	ring->cq_tail = (unsigned*)(base + params->cq_off.tail);
+	ring->cq_mask = *(unsigned*)(base + params->cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*)(base + params->cq_off.cqes);
+
+	return 0;
+}
+
+static int ProvideBuffers(Ring* ring) {
+	size_t ring_size = RING_BUFFER_COUNT * sizeof(struct io_uring_buf);
+	void* buf_ring = mmap(NULL,
+												ring_size,
+												PROT_READ | PROT_WRITE,
+												MAP_PRIVATE | MAP_ANONYMOUS,
+												-1,
+												0);
+	if (buf_ring == MAP_FAILED) {
+		perror("Error: In ProvideBuffers(): mmap() failed");
+		return -1;
+	}
+	ring->buf_ring = (struct io_uring_buf_ring*)buf_ring;
+
+	ring->buffers = (char*)malloc(RING_BUFFER_COUNT * BUFFER_SIZE);
+	if (ring->buffers == NULL) {
+		perror("Error: In ProvideBuffers(): malloc() failed");
+		return -1;
+	}
+
+	struct io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64_t)(uintptr_t)buf_ring;
+	reg.ring_entries = RING_BUFFER_COUNT;
+	reg.bgid = RING_BUFFER_GROUP;
+
+	if (RegisterRing(ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		perror("Error: In ProvideBuffers(): io_uring_register() failed");
+		return -1;
+	}
+
+	ring->buf_ring->tail = 0;
+	for (unsigned i = 0; i < RING_BUFFER_COUNT; i++) {
+		RecycleBuffer(ring, (unsigned short)i);
+	}
+
+	return 0;
+}
+
+int InitRing(Ring* ring, int server_socket, struct ThreadPool* pool) {
+	if (ring == NULL || pool == NULL) {
+		(void)fprintf(stderr, "Error: In InitRing(): Invalid arguments\n");
+		return -1;
+	}
+
+	memset(ring, 0, sizeof(Ring));
+	ring->server_socket = server_socket;
+	ring->pool = pool;
+	ring->event_fd = -1;
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	ring->ring_fd = SetupRing(RING_ENTRIES, &params);
+	if (ring->ring_fd < 0) {
+		perror("Error: In InitRing(): io_uring_setup() failed");
+		return -1;
+	}
+
+	if (!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+			!(params.features & IORING_FEAT_EXT_ARG)) {
+		(void)fprintf(stderr,
+									"Error: In InitRing(): Kernel lacks required features\n");
+		CleanupRing(ring);
+		return -1;
+	}
+
+	if (MapRing(ring, &params) < 0 || ProvideBuffers(ring) < 0) {
+		CleanupRing(ring);
+		return -1;
+	}
+
+	ring->event_fd = eventfd(0, EFD_CLOEXEC);
+	if (ring->event_fd < 0) {
+		perror("Error: In InitRing(): eventfd() failed");
+		CleanupRing(ring);
+		return -1;
+	}
+
+	ring->ready = (int*)malloc(MAX_CONNECTIONS * sizeof(int));
+	if (ring->ready == NULL) {
+		perror("Error: In InitRing(): malloc() failed");
+		CleanupRing(ring);
+		return -1;
+	}
+
+	if (pthread_mutex_init(&ring->lock, NULL) != 0) {
+		perror("Error: In InitRing(): pthread_mutex_init() failed");
+		free(ring->ready);
+		ring->ready = NULL;
+		CleanupRing(ring);
+		return -1;
+	}
+
+	if (InitConnectionTable() < 0) {
+		CleanupRing(ring);
+		return -1;
+	}
+
+	idle_timeout.tv_sec = (long long)KEEP_ALIVE_TIMEOUT;
+	idle_timeout.tv_nsec = 0;
+
+	PrepareAccept(ring);
+	PrepareEventRead(ring);
+
+	return 0;
+}
+
+void RunRing(Ring* ring) {
+	while (is_server_running) {
+		if (SubmitAndWait(ring, 1) < 0) {
+			break;
+		}
+
+		unsigned head = *ring->cq_head;
+		unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+		while (head != tail && is_server_running) {
+			HandleCompletion(ring, &ring->cqes[head & ring->cq_mask]);
+			head++;
+		}
+
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	}
+}
+
+void SubmitRingResponse(Connection* connection) {
+	Ring* ring = connection->ring;
+
+	if (pthread_mutex_lock(&ring->lock) != 0) {
+		perror("Error: In SubmitRingResponse(): pthread_mutex_lock() failed");
+		CloseConnection(connection->fd);
+		return;
+	}
+
+	// Only the first response of a batch needs to wake the ring, which drains
+	// the whole list at once.
+	int was_empty = (ring->num_ready == 0);
+	ring->ready[ring->num_ready++] = connection->fd;
+
+	if (pthread_mutex_unlock(&ring->lock) != 0) {
+		perror("Error: In SubmitRingResponse(): pthread_mutex_unlock() failed");
+	}
+
+	if (was_empty) {
+		uint64_t value = 1;
+		if (write(ring->event_fd, &value, sizeof(value)) < 0) {
+			perror("Error: In SubmitRingResponse(): write() failed");
+		}
+	}
+}
+
+void CleanupRing(Ring* ring) {
+	if (ring == NULL) {
+		return;
+	}
+
+	if (ring->ready != NULL) {
+		if (pthread_mutex_destroy(&ring->lock) != 0) {
+			perror("Error: In CleanupRing(): pthread_mutex_destroy() failed");
+		}
+		free(ring->ready);
+		ring->ready = NULL;
+	}
+
+	if (ring->event_fd >= 0) {
+		close(ring->event_fd);
+		ring->event_fd = -1;
+	}
+
+	if (ring->sqes != NULL) {
+		munmap(ring->sqes, ring->sqes_size);
+		ring->sqes = NULL;
+	}
+
+	if (ring->rings != NULL) {
+		munmap(ring->rings, ring->rings_size);
+		ring->rings = NULL;
+	}
+
+	if (ring->ring_fd >= 0) {
+		close(ring->ring_fd);
+		ring->ring_fd = -1;
+	}
+
+	if (ring->buf_ring != NULL) {
+		munmap(ring->buf_ring, RING_BUFFER_COUNT * sizeof(struct io_uring_buf));
+		ring->buf_ring = NULL;
+	}
+
+	free(ring->buffers);
+	ring->buffers = NULL;
+}
+
+// src/uring.c